@@ -0,0 +1,94 @@
+#include "AnimationLod.hpp"
+#include "BoneAnimation.hpp"
+
+//*** AnimationLod::Level
+
+AnimationLod::Level::Level() : minScreenSize(0), updatePeriod(1), boneLevelsCount(-1) {}
+
+AnimationLod::Level::Level(float minScreenSize, int updatePeriod, int boneLevelsCount)
+: minScreenSize(minScreenSize), updatePeriod(updatePeriod), boneLevelsCount(boneLevelsCount) {}
+
+//*** AnimationLod
+
+AnimationLod::AnimationLod() : projectionScale(0), frameTime(0)
+{
+	// по умолчанию: крупные - каждый кадр, дальше - реже,
+	// самые мелкие - ещё и без кончиков иерархии
+	levels.push_back(Level(0.1f, 1, -1));
+	levels.push_back(Level(0.04f, 2, -1));
+	levels.push_back(Level(0.015f, 4, -1));
+	levels.push_back(Level(0, 8, 4));
+
+	for(int i = 0; i < maxLevelsCount; ++i)
+		levelInstancesCounts[i] = 0;
+}
+
+void AnimationLod::SetLevelsCount(int levelsCount)
+{
+	if(levelsCount < 1 || levelsCount > maxLevelsCount)
+		THROW("Invalid animation LOD levels count");
+	levels.resize(levelsCount);
+}
+
+int AnimationLod::GetLevelsCount() const
+{
+	return (int)levels.size();
+}
+
+void AnimationLod::SetLevel(int number, float minScreenSize, int updatePeriod, int boneLevelsCount)
+{
+	if(number < 0 || number >= (int)levels.size())
+		THROW("Invalid animation LOD level number");
+	if(updatePeriod < 1)
+		THROW("Invalid animation LOD update period");
+	levels[number] = Level(minScreenSize, updatePeriod, boneLevelsCount);
+}
+
+void AnimationLod::BeginFrame(const mat4x4& viewProj, float frameTime)
+{
+	this->viewProj = viewProj;
+	this->frameTime = frameTime;
+	// вторая строка вид-проекции - строка поворота вида, умноженная на масштаб проекции
+	projectionScale = sqrt(viewProj(1, 0) * viewProj(1, 0) + viewProj(1, 1) * viewProj(1, 1) + viewProj(1, 2) * viewProj(1, 2));
+
+	for(int i = 0; i < maxLevelsCount; ++i)
+		levelInstancesCounts[i] = 0;
+}
+
+int AnimationLod::SelectLevel(const vec3& center, float radius) const
+{
+	// w в пространстве отсечения - расстояние вдоль направления взгляда
+	float w = viewProj(3, 0) * center.x + viewProj(3, 1) * center.y + viewProj(3, 2) * center.z + viewProj(3, 3);
+	// экземпляр, в котором находится камера, считается самым крупным
+	if(w <= radius)
+		return 0;
+	float screenSize = radius * projectionScale / w;
+
+	int levelsCount = (int)levels.size();
+	for(int i = 0; i < levelsCount - 1; ++i)
+		if(screenSize >= levels[i].minScreenSize)
+			return i;
+	return levelsCount - 1;
+}
+
+void AnimationLod::SelectSetupParameters(const vec3& center, float radius, float& updateInterval, int& boneLevelsCount)
+{
+	int levelNumber = SelectLevel(center, radius);
+	++levelInstancesCounts[levelNumber];
+	const Level& level = levels[levelNumber];
+	updateInterval = level.updatePeriod > 1 ? level.updatePeriod * frameTime : 0;
+	boneLevelsCount = level.boneLevelsCount;
+}
+
+void AnimationLod::Setup(BoneAnimationFrame* animationFrame, const vec3& originOffset, const quat& originOrientation, float time, bool looped, const vec3& center, float radius)
+{
+	float updateInterval;
+	int boneLevelsCount;
+	SelectSetupParameters(center, radius, updateInterval, boneLevelsCount);
+	animationFrame->SetupLod(originOffset, originOrientation, time, looped, updateInterval, boneLevelsCount);
+}
+
+int AnimationLod::GetLevelInstancesCount(int level) const
+{
+	return level >= 0 && level < maxLevelsCount ? levelInstancesCounts[level] : 0;
+}
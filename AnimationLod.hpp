@@ -0,0 +1,71 @@
+#ifndef ___BANSHEE_ANIMATION_LOD_HPP___
+#define ___BANSHEE_ANIMATION_LOD_HPP___
+
+#include "general.hpp"
+
+class BoneAnimationFrame;
+
+/// Уровни детализации анимации по размеру на экране.
+/** Размер экземпляра - радиус его ограничивающей сферы в проекции, в долях высоты
+экрана. Для каждого уровня задаётся минимальный размер, период обновления позы
+в кадрах и количество вычисляемых уровней иерархии костей. Экземпляр получает
+первый уровень, размер которого не больше его размера; меньшие экземпляры -
+последний уровень. Так стоимость анимации следует за заметностью на экране,
+а не за количеством персонажей. */
+class AnimationLod : public Object
+{
+public:
+	/// Максимальное количество уровней детализации.
+	static const int maxLevelsCount = 8;
+
+	struct Level
+	{
+		/// Минимальный размер на экране.
+		float minScreenSize;
+		/// Период обновления позы, в кадрах (1 - каждый кадр).
+		int updatePeriod;
+		/// Количество вычисляемых уровней иерархии костей (отрицательное - все).
+		int boneLevelsCount;
+
+		Level();
+		Level(float minScreenSize, int updatePeriod, int boneLevelsCount);
+	};
+
+private:
+	/// Уровни по убыванию минимального размера.
+	std::vector<Level> levels;
+	/// Матрица вид-проекция текущего кадра.
+	mat4x4 viewProj;
+	/// Масштаб проекции по вертикали.
+	float projectionScale;
+	/// Время кадра.
+	float frameTime;
+	/// Количество экземпляров по уровням в текущем кадре.
+	int levelInstancesCounts[maxLevelsCount];
+
+public:
+	AnimationLod();
+
+	/// Задать количество уровней (новые уровни - полная детализация).
+	void SetLevelsCount(int levelsCount);
+	int GetLevelsCount() const;
+	/// Задать уровень.
+	/** Уровни должны идти по убыванию минимального размера. */
+	void SetLevel(int number, float minScreenSize, int updatePeriod, int boneLevelsCount);
+
+	/// Начать кадр.
+	void BeginFrame(const mat4x4& viewProj, float frameTime);
+	/// Выбрать уровень для экземпляра с ограничивающей сферой.
+	int SelectLevel(const vec3& center, float radius) const;
+	/// Выбрать уровень и учесть экземпляр в статистике.
+	/** Возвращает параметры для BoneAnimationFrame::SetupLod. */
+	void SelectSetupParameters(const vec3& center, float radius, float& updateInterval, int& boneLevelsCount);
+	/// Рассчитать кадр анимации экземпляра с детализацией по его размеру на экране.
+	/** Ограничивающая сфера задаётся в мировых координатах. */
+	void Setup(BoneAnimationFrame* animationFrame, const vec3& originOffset, const quat& originOrientation, float time, bool looped, const vec3& center, float radius);
+
+	/// Получить количество экземпляров уровня в текущем кадре.
+	int GetLevelInstancesCount(int level) const;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "BoneAnimation.hpp"
 #include "Skeleton.hpp"
+#include "PoseCache.hpp"
 #include <iostream>
 
 /*
@@ -17,12 +18,285 @@
 }
 */
 
+//*** BoneAnimation::PackedQuat
+
+/// Диапазон трёх наименьших компонент единичного кватерниона: [-1/sqrt(2), 1/sqrt(2)].
+static const float packedQuatRange = 0.70710678118654752f;
+/// Максимальное квантованное значение компоненты (15 бит).
+static const int packedQuatMax = 0x7FFF;
+
+BoneAnimation::PackedQuat BoneAnimation::PackedQuat::Pack(const quat& q)
+{
+	float c[4] = { q.x, q.y, q.z, q.w };
+	float norm = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2] + c[3] * c[3]);
+
+	// найти наибольшую по модулю компоненту
+	int largest = 0;
+	for(int i = 1; i < 4; ++i)
+		if(fabs(c[i]) > fabs(c[largest]))
+			largest = i;
+
+	// q и -q задают один поворот, поэтому наибольшую компоненту можно сделать положительной
+	float scale = (c[largest] < 0 ? -1 : 1) / norm;
+	int values[3];
+	for(int i = 0, j = 0; i < 4; ++i)
+		if(i != largest)
+		{
+			int value = (int)floor((c[i] * scale / packedQuatRange + 1) * 0.5f * packedQuatMax + 0.5f);
+			values[j++] = std::min(std::max(value, 0), packedQuatMax);
+		}
+
+	PackedQuat packed;
+	packed.data[0] = (uint16_t)(values[0] | ((largest >> 1) << 15));
+	packed.data[1] = (uint16_t)(values[1] | ((largest & 1) << 15));
+	packed.data[2] = (uint16_t)values[2];
+	return packed;
+}
+
+quat BoneAnimation::PackedQuat::Unpack() const
+{
+	int largest = ((data[0] >> 15) << 1) | (data[1] >> 15);
+	float c[4];
+	float sum = 0;
+	for(int i = 0, j = 0; i < 4; ++i)
+		if(i != largest)
+		{
+			float value = ((float)(data[j++] & packedQuatMax) * (2.0f / packedQuatMax) - 1) * packedQuatRange;
+			c[i] = value;
+			sum += value * value;
+		}
+	c[largest] = sqrt(std::max(1 - sum, 0.0f));
+	return quat(c[0], c[1], c[2], c[3]);
+}
+
 //*** BoneAnimation
 
-BoneAnimation::BoneAnimation(ptr<Skeleton> skeleton, const std::vector<std::vector<Key> >& keys, const std::vector<vec3>& rootBoneOffsets)
-: skeleton(skeleton), keys(keys), rootBoneOffsets(rootBoneOffsets) {}
+/// Максимальное количество ключей, на которое курсор сдвигается линейно.
+static const int maxKeyCursorSteps = 4;
+
+/// Найти первый ключ со временем, большим заданного, начиная с курсора.
+/** Время - в единицах квантования. Результат совпадает с std::upper_bound по всем ключам. */
+static int AdvanceKeyCursor(const uint16_t* boneKeyTimes, int keysCount, int cursor, float time)
+{
+	// время ушло назад - искать до курсора
+	if(cursor > 0 && boneKeyTimes[cursor - 1] > time)
+		return (int)(std::upper_bound(boneKeyTimes, boneKeyTimes + cursor, time) - boneKeyTimes);
+
+	// время ушло вперёд - сначала пройти несколько ключей линейно
+	for(int step = 0; cursor < keysCount && boneKeyTimes[cursor] <= time; ++step, ++cursor)
+		if(step >= maxKeyCursorSteps)
+			return (int)(std::upper_bound(boneKeyTimes + cursor, boneKeyTimes + keysCount, time) - boneKeyTimes);
+
+	return cursor;
+}
+
+/// Максимальное количество ключей подряд, удаляемых при сжатии.
+/** Ограничивает время сжатия длинных неподвижных участков. */
+static const int maxRemovedKeysInRow = 64;
 
-ptr<BoneAnimation> BoneAnimation::Deserialize(ptr<InputStream> inputStream, ptr<Skeleton> skeleton)
+BoneAnimation::BoneAnimation(ptr<Skeleton> skeleton, const std::vector<std::vector<Key> >& keys, const std::vector<vec3>& rootBoneOffsets, float maxAngularError)
+: skeleton(skeleton), rootBoneOffsets(rootBoneOffsets), duration(0), resampledFrameRate(0), resampledFramesCount(0)
+{
+	int bonesCount = (int)keys.size();
+	for(int i = 0; i < bonesCount; ++i)
+		if(!keys[i].empty())
+			duration = std::max(duration, keys[i].back().time);
+	timeStep = duration > 0 ? duration / 0xFFFF : 1;
+
+	// ключ можно восстановить, если модуль скалярного произведения
+	// восстановленного и исходного кватернионов не меньше этого значения
+	float minDot = cos(maxAngularError * 0.5f);
+
+	std::vector<uint16_t> boneKeyTimes;
+	std::vector<PackedQuat> boneKeyOrientations;
+	std::vector<int> keptKeys;
+	keyStarts.resize(bonesCount + 1);
+	for(int i = 0; i < bonesCount; ++i)
+	{
+		keyStarts[i] = (int)keyTimes.size();
+
+		// квантовать ключи
+		const std::vector<Key>& boneKeys = keys[i];
+		int keysCount = (int)boneKeys.size();
+		boneKeyTimes.resize(keysCount);
+		boneKeyOrientations.resize(keysCount);
+		for(int k = 0; k < keysCount; ++k)
+		{
+			boneKeyTimes[k] = (uint16_t)std::min(std::max((int)floor(boneKeys[k].time / timeStep + 0.5f), 0), 0xFFFF);
+			boneKeyOrientations[k] = PackedQuat::Pack(boneKeys[k].orientation);
+		}
+
+		// отобрать ключи: от каждого оставленного ключа продлевать отрезок,
+		// пока все ключи внутри восстанавливаются интерполяцией его концов
+		// (сравниваются с исходными, а не со сжатыми, ключами)
+		keptKeys.clear();
+		if(i == 0 || maxAngularError <= 0)
+			for(int k = 0; k < keysCount; ++k)
+				keptKeys.push_back(k);
+		else if(keysCount)
+		{
+			keptKeys.push_back(0);
+			for(int k = 0; k + 1 < keysCount; )
+			{
+				int next = k + 1;
+				while(next + 1 < keysCount && next - k <= maxRemovedKeysInRow)
+				{
+					int end = next + 1;
+					quat begin = boneKeyOrientations[k].Unpack();
+					quat endOrientation = boneKeyOrientations[end].Unpack();
+					float timeLength = (float)(boneKeyTimes[end] - boneKeyTimes[k]);
+					bool ok = true;
+					for(int m = k + 1; m < end && ok; ++m)
+					{
+						float t = timeLength > 0 ? (float)(boneKeyTimes[m] - boneKeyTimes[k]) / timeLength : 0;
+						quat restored = fromEigen(toEigenQuat(begin).slerp(t, toEigenQuat(endOrientation)));
+						const quat& original = boneKeys[m].orientation;
+						float dot = restored.x * original.x + restored.y * original.y + restored.z * original.z + restored.w * original.w;
+						float originalNorm = sqrt(original.x * original.x + original.y * original.y + original.z * original.z + original.w * original.w);
+						ok = fabs(dot) >= minDot * originalNorm;
+					}
+					if(!ok)
+						break;
+					next = end;
+				}
+				keptKeys.push_back(next);
+				k = next;
+			}
+		}
+
+		for(size_t k = 0; k < keptKeys.size(); ++k)
+		{
+			keyTimes.push_back(boneKeyTimes[keptKeys[k]]);
+			keyOrientations.push_back(boneKeyOrientations[keptKeys[k]]);
+		}
+	}
+	keyStarts[bonesCount] = (int)keyTimes.size();
+}
+
+float BoneAnimation::GetDuration() const
+{
+	return duration;
+}
+
+float BoneAnimation::WrapTime(float time) const
+{
+	if(duration <= 0)
+		return 0;
+	time = fmod(time, duration);
+	if(time < 0)
+		time += duration;
+	return time;
+}
+
+int BoneAnimation::GetKeysCount() const
+{
+	return (int)keyTimes.size();
+}
+
+void BoneAnimation::SampleKeys(float time, int bonesCount, std::vector<int>& keyCursors, QuatArrays& previousKeyOrientations, QuatArrays& nextKeyOrientations, std::vector<float>& interframeTimes, vec3& rootBoneOffset) const
+{
+	// время в единицах квантования
+	float keyTime = time / timeStep;
+
+	// для каждой кости найти и распаковать пару ключей для интерполяции
+	// а для корневой кости получить ещё и позицию
+	for(int i = 0; i < bonesCount; ++i)
+	{
+		int keysBegin = keyStarts[i];
+		int keysCount = keyStarts[i + 1] - keysBegin;
+		const uint16_t* boneKeyTimes = &keyTimes[keysBegin];
+		const PackedQuat* boneKeyOrientations = &keyOrientations[keysBegin];
+
+		// найти следующий за временем ключ, сдвинув курсор
+		int frame = keyCursors[i] = AdvanceKeyCursor(boneKeyTimes, keysCount, keyCursors[i], keyTime);
+		float interframeTime = 0;
+		if(frame <= 0)
+		{
+			quat orientation = boneKeyOrientations[0].Unpack();
+			previousKeyOrientations.Set(i, orientation);
+			nextKeyOrientations.Set(i, orientation);
+		}
+		else if(frame >= keysCount)
+		{
+			quat orientation = boneKeyOrientations[keysCount - 1].Unpack();
+			previousKeyOrientations.Set(i, orientation);
+			nextKeyOrientations.Set(i, orientation);
+		}
+		else
+		{
+			interframeTime = (keyTime - boneKeyTimes[frame - 1]) / (float)(boneKeyTimes[frame] - boneKeyTimes[frame - 1]);
+			previousKeyOrientations.Set(i, boneKeyOrientations[frame - 1].Unpack());
+			nextKeyOrientations.Set(i, boneKeyOrientations[frame].Unpack());
+		}
+		interframeTimes[i] = interframeTime;
+
+		// для корневой кости
+		if(i == 0)
+		{
+			if(frame <= 0)
+				rootBoneOffset = rootBoneOffsets.front();
+			else if(frame >= keysCount)
+				rootBoneOffset = rootBoneOffsets.back();
+			else
+				rootBoneOffset = lerp(rootBoneOffsets[frame - 1], rootBoneOffsets[frame], interframeTime);
+		}
+	}
+}
+
+void BoneAnimation::SampleFrames(float time, QuatArrays& orientations, vec3& rootBoneOffset) const
+{
+	int bonesCount = (int)keyStarts.size() - 1;
+	int frameSize = PadPoseCount(bonesCount) * 4;
+
+	float frame = std::min(std::max(time * resampledFrameRate, 0.0f), (float)(resampledFramesCount - 1));
+	int frame1 = (int)frame;
+	int frame2 = std::min(frame1 + 1, resampledFramesCount - 1);
+	float interframeTime = frame - frame1;
+
+	PoseSlerpBlocks(&resampledOrientations[frame1 * frameSize], &resampledOrientations[frame2 * frameSize],
+		frameSize / 4, interframeTime, orientations, bonesCount);
+	rootBoneOffset = lerp(resampledRootBoneOffsets[frame1], resampledRootBoneOffsets[frame2], interframeTime);
+}
+
+void BoneAnimation::Resample(float frameRate)
+{
+	int bonesCount = (int)keyStarts.size() - 1;
+	int stride = PadPoseCount(bonesCount);
+	int intervalsCount = std::max((int)floor(duration * frameRate + 0.5f), 1);
+	int framesCount = intervalsCount + 1;
+
+	// выбирать позы из ключей так же, как это делает кадр анимации
+	std::vector<int> keyCursors(bonesCount, 0);
+	QuatArrays previousKeyOrientations, nextKeyOrientations, orientations;
+	previousKeyOrientations.Resize(bonesCount);
+	nextKeyOrientations.Resize(bonesCount);
+	orientations.Resize(bonesCount);
+	std::vector<float> interframeTimes(stride);
+
+	resampledOrientations.resize(framesCount * stride * 4);
+	resampledRootBoneOffsets.resize(framesCount);
+	for(int i = 0; i < framesCount; ++i)
+	{
+		SampleKeys(duration * i / intervalsCount, bonesCount, keyCursors, previousKeyOrientations, nextKeyOrientations, interframeTimes, resampledRootBoneOffsets[i]);
+		PoseSlerp(previousKeyOrientations, nextKeyOrientations, &interframeTimes[0], orientations, bonesCount);
+
+		float* frameData = &resampledOrientations[i * stride * 4];
+		std::copy(orientations.x.begin(), orientations.x.end(), frameData);
+		std::copy(orientations.y.begin(), orientations.y.end(), frameData + stride);
+		std::copy(orientations.z.begin(), orientations.z.end(), frameData + stride * 2);
+		std::copy(orientations.w.begin(), orientations.w.end(), frameData + stride * 3);
+	}
+
+	resampledFramesCount = framesCount;
+	resampledFrameRate = duration > 0 ? intervalsCount / duration : 0;
+}
+
+bool BoneAnimation::IsResampled() const
+{
+	return resampledFramesCount > 0;
+}
+
+ptr<BoneAnimation> BoneAnimation::Deserialize(ptr<InputStream> inputStream, ptr<Skeleton> skeleton, float maxAngularError)
 {
 	try
 	{
@@ -48,18 +322,23 @@ ptr<BoneAnimation> BoneAnimation::Deserialize(ptr<InputStream> inputStream, ptr<
 		};
 		std::vector<RootKey> rootKeys;
 
+		// номера костей в файле - исходные, ключи раскладываются в порядке скелета
+		const std::vector<int>& boneRemap = skeleton->GetBoneRemap();
+
 		// считать ключи и распихать их по костям
 		for(size_t i = 0; i < allKeysCount; ++i)
 		{
 			float keyTime = reader.Read<float>();
 			size_t keyBone = reader.ReadShortly();
+			if(keyBone >= bonesCount)
+				THROW("Invalid key bone number");
 			quat keyOrientation = reader.Read<quat>();
 
 			Key key;
 			key.time = keyTime;
 			key.orientation = keyOrientation;
 			if(keyBone)
-				keys[keyBone].push_back(key);
+				keys[boneRemap[keyBone]].push_back(key);
 			else
 				rootKeys.push_back(RootKey(key, reader.Read<vec3>()));
 		}
@@ -93,7 +372,7 @@ ptr<BoneAnimation> BoneAnimation::Deserialize(ptr<InputStream> inputStream, ptr<
 			rootBoneOffsets.push_back(rootKeys[i].offset);
 		}
 
-		return NEW(BoneAnimation(skeleton, keys, rootBoneOffsets));
+		return NEW(BoneAnimation(skeleton, keys, rootBoneOffsets, maxAngularError));
 	}
 	catch(Exception* exception)
 	{
@@ -103,108 +382,217 @@ ptr<BoneAnimation> BoneAnimation::Deserialize(ptr<InputStream> inputStream, ptr<
 
 //*** BoneAnimationFrame
 
+int BoneAnimationFrame::nextLodPhaseNumber = 0;
+
 BoneAnimationFrame::BoneAnimationFrame(ptr<BoneAnimation> animation)
 : animation(animation),
-	animationRelativeOrientations(animation->keys.size()),
-	animationWorldOrientations(animationRelativeOrientations.size()),
-	animationWorldPositions(animationRelativeOrientations.size()),
-	orientations(animationRelativeOrientations.size()),
-	offsets(animationRelativeOrientations.size())
-{}
+	interframeTimes(PadPoseCount((int)animation->keyStarts.size() - 1)),
+	lodInterpolationTimes(PadPoseCount((int)animation->keyStarts.size() - 1)),
+	lodPreviousTime(1), lodNextTime(0), lodLevelsCount(-1),
+	// доли равномерно заполняют (0, 1] последовательностью с золотым сечением
+	lodPhase(1 - fmod(nextLodPhaseNumber++ * 0.618034f, 1.0f)),
+	orientations(animation->keyStarts.size() - 1),
+	offsets(animation->keyStarts.size() - 1)
+{
+	int bonesCount = (int)orientations.size();
+	previousKeyOrientations.Resize(bonesCount);
+	nextKeyOrientations.Resize(bonesCount);
+	animationRelativeOrientations.Resize(bonesCount);
+	animationWorldOrientations.Resize(bonesCount);
+	animationWorldPositions.Resize(bonesCount);
+	localOrientations.Resize(bonesCount);
+	localOffsets.Resize(bonesCount);
+	originOrientations.Resize(bonesCount);
+	originOffsets.Resize(bonesCount);
+	resultOrientations.Resize(bonesCount);
+	resultOffsets.Resize(bonesCount);
+	lodPreviousOrientations.Resize(bonesCount);
+	lodNextOrientations.Resize(bonesCount);
+	lodPreviousOffsets.Resize(bonesCount);
+	lodNextOffsets.Resize(bonesCount);
+	keyCursors.assign(bonesCount, 0);
+}
 
-void BoneAnimationFrame::Setup(const vec3& originOffset, const quat& originOrientation, float time)
+void BoneAnimationFrame::SetupLocal(float time, int levelsCount)
 {
-	// получить ключи и смещения
-	const std::vector<std::vector<BoneAnimation::Key> >& keys = animation->keys;
-	const std::vector<vec3>& rootBoneOffsets = animation->rootBoneOffsets;
+	int bonesCount = (int)orientations.size();
+
+	const Skeleton* skeleton = animation->skeleton;
+	const std::vector<int>& levelStarts = skeleton->GetLevelStarts();
+	int allLevelsCount = (int)levelStarts.size() - 1;
+	if(levelsCount < 0 || levelsCount > allLevelsCount)
+		levelsCount = allLevelsCount;
+	else if(levelsCount < 1)
+		levelsCount = 1;
+	// кости вычисляемых уровней идут в начале скелета
+	int levelsBonesCount = levelStarts[levelsCount];
 
-	struct Sorter
+	// получить анимационные относительные ориентации сразу для всех костей
+	// а для корневой кости получить ещё и позицию
+	vec3 rootBoneOffset;
+	if(animation->resampledFramesCount)
+		animation->SampleFrames(time, animationRelativeOrientations, rootBoneOffset);
+	else
 	{
-		bool operator()(const BoneAnimation::Key& a, const BoneAnimation::Key& b) const
-		{
-			return a.time < b.time;
-		}
-	} sorter;
+		// ключи ищутся только для вычисляемых костей
+		animation->SampleKeys(time, levelsBonesCount, keyCursors, previousKeyOrientations, nextKeyOrientations, interframeTimes, rootBoneOffset);
+		PoseSlerp(previousKeyOrientations, nextKeyOrientations, &interframeTimes[0], animationRelativeOrientations, levelsBonesCount);
+	}
 
-	int bonesCount = (int)animationRelativeOrientations.size();
+	// вычислить анимационные ориентации и позиции в системе модели
+	// одним проходом вперёд: родитель вычислен раньше ребёнка,
+	// а номера родителей не убывают, так что все массивы читаются подряд
+	const int* parents = &skeleton->GetParents()[0];
+	const Vec3Arrays& relativePositions = skeleton->GetOriginalRelativePositions();
+	const float* rpx = &relativePositions.x[0];
+	const float* rpy = &relativePositions.y[0];
+	const float* rpz = &relativePositions.z[0];
+	const float* rqx = &animationRelativeOrientations.x[0];
+	const float* rqy = &animationRelativeOrientations.y[0];
+	const float* rqz = &animationRelativeOrientations.z[0];
+	const float* rqw = &animationRelativeOrientations.w[0];
+	float* wqx = &animationWorldOrientations.x[0];
+	float* wqy = &animationWorldOrientations.y[0];
+	float* wqz = &animationWorldOrientations.z[0];
+	float* wqw = &animationWorldOrientations.w[0];
+	float* wpx = &animationWorldPositions.x[0];
+	float* wpy = &animationWorldPositions.y[0];
+	float* wpz = &animationWorldPositions.z[0];
 
-	//std::cout << "Time: " << time << '\n';
+	wqx[0] = rqx[0];
+	wqy[0] = rqy[0];
+	wqz[0] = rqz[0];
+	wqw[0] = rqw[0];
+	wpx[0] = rootBoneOffset.x;
+	wpy[0] = rootBoneOffset.y;
+	wpz[0] = rootBoneOffset.z;
+	for(int i = 1; i < levelsBonesCount; ++i)
+	{
+		int parent = parents[i];
+		float ax = wqx[parent], ay = wqy[parent], az = wqz[parent], aw = wqw[parent];
+		float bx = rqx[i], by = rqy[i], bz = rqz[i], bw = rqw[i];
 
-	// для каждой кости получить анимационную относительную ориентацию
-	// а для корневой кости получить ещё и позицию
-	vec3 rootBoneOffset;
-	for(int i = 0; i < bonesCount; ++i)
+		// ориентация = ориентация родителя * относительная ориентация
+		wqx[i] = (aw * bx + ax * bw) + (ay * bz - az * by);
+		wqy[i] = (aw * by + ay * bw) + (az * bx - ax * bz);
+		wqz[i] = (aw * bz + az * bw) + (ax * by - ay * bx);
+		wqw[i] = (aw * bw - ax * bx) - (ay * by + az * bz);
+
+		// позиция = позиция родителя + ориентация родителя * относительная позиция
+		float vx = rpx[i], vy = rpy[i], vz = rpz[i];
+		float tx = 2 * (ay * vz - az * vy);
+		float ty = 2 * (az * vx - ax * vz);
+		float tz = 2 * (ax * vy - ay * vx);
+		wpx[i] = wpx[parent] + ((vx + aw * tx) + (ay * tz - az * ty));
+		wpy[i] = wpy[parent] + ((vy + aw * ty) + (az * tx - ax * tz));
+		wpz[i] = wpz[parent] + ((vz + aw * tz) + (ax * ty - ay * tx));
+	}
+
+	// вычислить преобразования, вычтя оригинальную позу:
+	// ориентация = AWO * conj(OWO), смещение = AWP - ориентация * OWP
+	PoseMul(animationWorldOrientations, skeleton->GetInverseOriginalWorldOrientations(), localOrientations, levelsBonesCount);
+	PoseTransform(localOrientations, skeleton->GetNegativeOriginalWorldPositions(), animationWorldPositions, localOffsets, levelsBonesCount);
+
+	// невычисленные кости повторяют преобразование родителя
+	for(int i = levelsBonesCount; i < bonesCount; ++i)
 	{
-		const std::vector<BoneAnimation::Key>& boneKeys = keys[i];
-		quat& animationRelativeOrientation = animationRelativeOrientations[i];
-
-		// найти бинарным поиском следующий за временем ключ
-		BoneAnimation::Key timeKey;
-		timeKey.time = time;
-		ptrdiff_t frame = std::upper_bound(boneKeys.begin(), boneKeys.end(), timeKey, sorter) - boneKeys.begin();
-		float interframeTime = 0; // initialize to suppress warning only
-		if(frame <= 0)
-			animationRelativeOrientation = boneKeys.front().orientation;
-		else if(frame >= (int)boneKeys.size())
-			animationRelativeOrientation = boneKeys.back().orientation;
-		else
-		{
-			interframeTime = (time - boneKeys[frame - 1].time) / (boneKeys[frame].time - boneKeys[frame - 1].time);
-			animationRelativeOrientation = fromEigen(toEigenQuat(boneKeys[frame - 1].orientation).slerp(interframeTime, toEigenQuat(boneKeys[frame].orientation)));
-		}
+		int parent = parents[i];
+		localOrientations.Set(i, localOrientations.Get(parent));
+		localOffsets.Set(i, localOffsets.Get(parent));
+	}
+}
 
-		//std::cout << "ARO " << i << ": " << animationRelativeOrientation << '\n';
+void BoneAnimationFrame::ApplyOrigin(const vec3& originOffset, const quat& originOrientation, const BoneAnimationFrame* localPose)
+{
+	int bonesCount = (int)orientations.size();
 
-		// для корневой кости
-		if(i == 0)
-		{
-			if(frame <= 0)
-				rootBoneOffset = rootBoneOffsets.front();
-			else if(frame >= (int)boneKeys.size())
-				rootBoneOffset = rootBoneOffsets.back();
-			else
-				rootBoneOffset = lerp(rootBoneOffsets[frame - 1], rootBoneOffsets[frame], interframeTime);
-		}
+	// начало координат входит в преобразования линейно:
+	// ориентация = O * L, смещение = P + O * l
+	for(int i = 0; i < bonesCount; ++i)
+	{
+		originOrientations.Set(i, originOrientation);
+		originOffsets.Set(i, originOffset);
 	}
+	PoseMul(originOrientations, localPose->localOrientations, resultOrientations, bonesCount);
+	PoseTransform(originOrientations, localPose->localOffsets, originOffsets, resultOffsets, bonesCount);
 
-	// вычислить анимационные мировые ориентации и позиции
-	const std::vector<Skeleton::Bone>& bones = animation->skeleton->GetBones();
-	const std::vector<int>& sortedBones = animation->skeleton->GetSortedBones();
-#ifdef _DEBUG
-	static std::vector<bool> f(bonesCount);
-	f.assign(bonesCount, false);
-#endif
 	for(int i = 0; i < bonesCount; ++i)
 	{
-		int boneNumber = sortedBones[i];
-		const Skeleton::Bone& bone = bones[boneNumber];
-		if(boneNumber)
-		{
-			int parent = bone.parent;
-#ifdef _DEBUG
-			if(!f[parent])
-				THROW("Parent is not calculated");
-#endif
-			animationWorldOrientations[boneNumber] = fromEigen(toEigenQuat(animationWorldOrientations[parent]) * toEigenQuat(animationRelativeOrientations[boneNumber]));
-			animationWorldPositions[boneNumber] = fromEigen((toEigen(animationWorldPositions[parent]) + toEigenQuat(animationWorldOrientations[parent]) * toEigen(bone.originalRelativePosition)).eval());
+		orientations[i] = resultOrientations.Get(i);
+		offsets[i] = resultOffsets.Get(i);
+	}
+}
+
+void BoneAnimationFrame::Setup(const vec3& originOffset, const quat& originOrientation, float time, PoseCache* poseCache)
+{
+	const BoneAnimationFrame* localPose;
+	if(poseCache)
+		localPose = poseCache->GetPose(animation, time);
+	else
+	{
+		SetupLocal(time);
+		localPose = this;
+	}
+	ApplyOrigin(originOffset, originOrientation, localPose);
+}
+
+void BoneAnimationFrame::SetupLooped(const vec3& originOffset, const quat& originOrientation, float time, PoseCache* poseCache)
+{
+	Setup(originOffset, originOrientation, animation->WrapTime(time), poseCache);
+}
+
+void BoneAnimationFrame::SetupLod(const vec3& originOffset, const quat& originOrientation, float time, bool looped, float updateInterval, int levelsCount)
+{
+	float duration = animation->GetDuration();
+
+	// полная детализация - обычный расчёт, интервал сбрасывается
+	if(updateInterval <= 0)
+	{
+		lodPreviousTime = 1;
+		lodNextTime = 0;
+		SetupLocal(looped ? animation->WrapTime(time) : time, levelsCount);
+		ApplyOrigin(originOffset, originOrientation, this);
+		return;
+	}
+
+	// время вышло за интервал - начать новый
+	if(!(time >= lodPreviousTime && time <= lodNextTime) || levelsCount != lodLevelsCount)
+	{
+		if(lodPreviousTime <= lodNextTime && time > lodNextTime && time <= lodNextTime + updateInterval && levelsCount == lodLevelsCount)
+		{
+			// продолжение: конец прошлого интервала становится началом нового
+			std::swap(lodPreviousOrientations, lodNextOrientations);
+			std::swap(lodPreviousOffsets, lodNextOffsets);
+			lodPreviousTime = lodNextTime;
+			lodNextTime = lodPreviousTime + updateInterval;
 		}
 		else
 		{
-			animationWorldOrientations[boneNumber] = fromEigen(toEigenQuat(originOrientation) * toEigenQuat(animationRelativeOrientations[boneNumber]));
-			animationWorldPositions[boneNumber] = fromEigen((toEigen(originOffset) + toEigenQuat(originOrientation) * toEigen(rootBoneOffset)).eval());
+			// разрыв (первый расчёт, перемотка, смена детализации):
+			// начало интервала вычисляется заново, первый интервал укорочен
+			SetupLocal(looped ? animation->WrapTime(time) : time, levelsCount);
+			lodPreviousOrientations = localOrientations;
+			lodPreviousOffsets = localOffsets;
+			lodPreviousTime = time;
+			lodNextTime = time + updateInterval * lodPhase;
+			lodLevelsCount = levelsCount;
 		}
-#ifdef _DEBUG
-		f[boneNumber] = true;
-#endif
-		//std::cout << "Bone " << boneNumber << ", AWO=" << animationWorldOrientations[boneNumber] << ", AWP=" << animationWorldPositions[boneNumber] << '\n';
+		float nextTime = looped ? animation->WrapTime(lodNextTime) : std::min(lodNextTime, duration);
+		SetupLocal(nextTime, levelsCount);
+		lodNextOrientations = localOrientations;
+		lodNextOffsets = localOffsets;
 	}
 
-	// вычислить результирующие ориентации для костей
-	for(int i = 0; i < bonesCount; ++i)
+	// интерполировать позу между границами интервала
+	int bonesCount = (int)orientations.size();
+	float t = (time - lodPreviousTime) / (lodNextTime - lodPreviousTime);
+	std::fill(lodInterpolationTimes.begin(), lodInterpolationTimes.end(), t);
+	PoseSlerp(lodPreviousOrientations, lodNextOrientations, &lodInterpolationTimes[0], localOrientations, bonesCount);
+	for(size_t i = 0; i < localOffsets.x.size(); ++i)
 	{
-		orientations[i] = fromEigen(toEigenQuat(animationWorldOrientations[i]) * toEigenQuat(bones[i].originalWorldOrientation).conjugate());
-		offsets[i] = fromEigen((toEigen(animationWorldPositions[i]) - toEigenQuat(orientations[i]) * toEigen(bones[i].originalWorldPosition)).eval());
-		//std::cout << "Result " << i << " O=" << orientations[i] << ", P=" << offsets[i] << '\n';
+		localOffsets.x[i] = lodPreviousOffsets.x[i] + (lodNextOffsets.x[i] - lodPreviousOffsets.x[i]) * t;
+		localOffsets.y[i] = lodPreviousOffsets.y[i] + (lodNextOffsets.y[i] - lodPreviousOffsets.y[i]) * t;
+		localOffsets.z[i] = lodPreviousOffsets.z[i] + (lodNextOffsets.z[i] - lodPreviousOffsets.z[i]) * t;
 	}
-	//std::cout << '\n';
+	ApplyOrigin(originOffset, originOrientation, this);
 }
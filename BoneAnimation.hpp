@@ -2,11 +2,18 @@
 #define ___BANSHEE_BONE_ANIMATION_HPP___
 
 #include "general.hpp"
+#include "PoseMath.hpp"
 
 class Skeleton;
 class BoneAnimationFrame;
+class PoseCache;
 
 /// Класс анимации костей.
+/** Хранит ключи в сжатом виде: времена квантованы в 16 бит в пределах
+длительности анимации, ориентации упакованы методом "трёх наименьших"
+в 48 бит. Ключи всех костей лежат в общих плоских массивах.
+При создании удаляются ключи, которые восстанавливаются интерполяцией
+соседних с угловой ошибкой не больше заданной. */
 class BoneAnimation : public Object
 {
 	friend class BoneAnimationFrame;
@@ -20,36 +27,137 @@ public:
 		quat orientation;
 	};
 
+	/// Упакованный кватернион.
+	/** Три наименьшие по модулю компоненты по 15 бит и номер наибольшей
+	компоненты (2 бита); наибольшая восстанавливается из нормировки. */
+	struct PackedQuat
+	{
+		uint16_t data[3];
+
+		static PackedQuat Pack(const quat& q);
+		quat Unpack() const;
+	};
+
 private:
 	ptr<Skeleton> skeleton;
 
-	/// Ключи анимации по костям, отсортированные по времени.
-	std::vector<std::vector<Key> > keys;
+	/// Начала ключей костей в общих массивах, последний элемент - общее количество ключей.
+	std::vector<int> keyStarts;
+	/// Квантованные времена ключей, в единицах timeStep.
+	std::vector<uint16_t> keyTimes;
+	/// Упакованные ориентации ключей.
+	std::vector<PackedQuat> keyOrientations;
 
-	/// Смещения корневой кости (по времени соответствуют ключам анимации).
+	/// Смещения корневой кости (соответствуют ключам корневой кости).
 	std::vector<vec3> rootBoneOffsets;
 
+	/// Длительность анимации (время последнего ключа).
+	float duration;
+	/// Шаг квантования времени.
+	float timeStep;
+
+	/// Частота кадров пересэмплированной анимации.
+	float resampledFrameRate;
+	/// Количество кадров пересэмплированной анимации (0 - анимация не пересэмплирована).
+	int resampledFramesCount;
+	/// Относительные ориентации костей по кадрам.
+	/** Кадр - блок из массивов компонент x, y, z, w по PadPoseCount(количество костей)
+	элементов; кадры идут подряд. */
+	std::vector<float> resampledOrientations;
+	/// Смещения корневой кости по кадрам.
+	std::vector<vec3> resampledRootBoneOffsets;
+
+	/// Найти и распаковать пары ключей для интерполяции в заданное время.
+	/** Выбираются первые bonesCount костей скелета. */
+	void SampleKeys(float time, int bonesCount, std::vector<int>& keyCursors, QuatArrays& previousKeyOrientations, QuatArrays& nextKeyOrientations, std::vector<float>& interframeTimes, vec3& rootBoneOffset) const;
+	/// Получить относительные ориентации интерполяцией соседних пересэмплированных кадров.
+	void SampleFrames(float time, QuatArrays& orientations, vec3& rootBoneOffset) const;
+
 public:
-	BoneAnimation(ptr<Skeleton> skeleton, const std::vector<std::vector<Key> >& keys, const std::vector<vec3>& rootBoneOffsets);
+	/// Создать анимацию, сжав ключи.
+	/** Ключи каждой кости должны быть отсортированы по времени, кости
+	нумеруются в порядке скелета (см. Skeleton::GetBoneRemap).
+	maxAngularError - допустимая угловая ошибка при удалении ключей, в радианах;
+	0 - ключи не удаляются. Ключи корневой кости не удаляются никогда,
+	так как к ним привязаны смещения. */
+	BoneAnimation(ptr<Skeleton> skeleton, const std::vector<std::vector<Key> >& keys, const std::vector<vec3>& rootBoneOffsets, float maxAngularError);
+
+	float GetDuration() const;
+	/// Взять время по модулю длительности (для зацикленного воспроизведения).
+	float WrapTime(float time) const;
+	/// Получить общее количество ключей после сжатия.
+	int GetKeysCount() const;
+
+	/// Пересэмплировать анимацию с постоянной частотой кадров.
+	/** Выборка позы после этого не ищет ключи, а интерполирует два соседних
+	кадра сразу для всех костей. Частота уточняется так, чтобы в длительность
+	укладывалось целое число кадров. Ключи остаются источником данных. */
+	void Resample(float frameRate);
+	bool IsResampled() const;
 
-	static ptr<BoneAnimation> Deserialize(ptr<InputStream> inputStream, ptr<Skeleton> skeleton);
+	static ptr<BoneAnimation> Deserialize(ptr<InputStream> inputStream, ptr<Skeleton> skeleton, float maxAngularError = 0);
 
 	META_DECLARE_CLASS(BoneAnimation);
 };
 
 /// Класс кадра анимации костей.
-/** Позволяет выставлять нужный кадр анимации и получать трансформации. */
+/** Позволяет выставлять нужный кадр анимации и получать трансформации.
+Поза сначала вычисляется в системе модели (без учёта начала координат),
+затем к ней применяется начало координат экземпляра. Позу в системе модели
+можно взять из кэша поз, общего для экземпляров с одной анимацией. */
 class BoneAnimationFrame : public Object
 {
+	friend class PoseCache;
+	friend class PoseBatch;
 public:
 	ptr<BoneAnimation> animation;
 
+	/// Ключи, между которыми интерполируется ориентация каждой кости.
+	QuatArrays previousKeyOrientations, nextKeyOrientations;
+	/// Параметры интерполяции между ключами.
+	std::vector<float> interframeTimes;
 	/// Анимационные относительные ориентации.
-	std::vector<quat> animationRelativeOrientations;
+	QuatArrays animationRelativeOrientations;
 	/// Анимационные мировые ориентации.
-	std::vector<quat> animationWorldOrientations;
+	QuatArrays animationWorldOrientations;
 	/// Анимационные мировые позиции.
-	std::vector<vec3> animationWorldPositions;
+	Vec3Arrays animationWorldPositions;
+	/// Преобразования в системе модели.
+	QuatArrays localOrientations;
+	Vec3Arrays localOffsets;
+	/// Начало координат, размноженное по костям.
+	QuatArrays originOrientations;
+	Vec3Arrays originOffsets;
+	/// Результирующие преобразования в виде SoA.
+	QuatArrays resultOrientations;
+	Vec3Arrays resultOffsets;
+
+	/// Курсоры ключей по костям: номер первого ключа со временем, большим текущего.
+	/** При воспроизведении вперёд курсоры сдвигаются линейно, на несколько ключей
+	за кадр; при переходе назад или далеко вперёд ключ ищется бинарным поиском. */
+	std::vector<int> keyCursors;
+
+	/// Позы в системе модели на границах интервала обновления (для пониженной детализации).
+	QuatArrays lodPreviousOrientations, lodNextOrientations;
+	Vec3Arrays lodPreviousOffsets, lodNextOffsets;
+	/// Параметры интерполяции между границами интервала (одинаковые для всех костей).
+	std::vector<float> lodInterpolationTimes;
+	/// Границы интервала обновления; интервала нет, если начало больше конца.
+	float lodPreviousTime, lodNextTime;
+	/// Количество уровней иерархии, с которым вычислены позы интервала.
+	int lodLevelsCount;
+	/// Доля первого интервала после разрыва, разная у разных кадров,
+	/// чтобы обновления экземпляров не приходились на один кадр.
+	float lodPhase;
+	/// Счётчик для выдачи долей первого интервала.
+	static int nextLodPhaseNumber;
+
+	/// Рассчитать позу в системе модели.
+	/** levelsCount - количество вычисляемых уровней иерархии костей (отрицательное - все);
+	кости глубже следуют за родителями жёстко, в исходной позе относительно них. */
+	void SetupLocal(float time, int levelsCount = -1);
+	/// Получить результирующие преобразования, применив начало координат к позе в системе модели.
+	void ApplyOrigin(const vec3& originOffset, const quat& originOrientation, const BoneAnimationFrame* localPose);
 
 public:
 	/// Результирующие преобразования для точек.
@@ -61,7 +169,21 @@ public:
 	BoneAnimationFrame(ptr<BoneAnimation> animation);
 
 	/// Установить параметры и рассчитать положение.
-	void Setup(const vec3& originOffset, const quat& originOrientation, float time);
+	/** Время ограничивается первым и последним ключом. Время может меняться
+	произвольно (перемотка), но быстрее всего - монотонно небольшими шагами.
+	Если задан кэш поз, поза в системе модели берётся из него (время при этом
+	квантуется с шагом кэша). */
+	void Setup(const vec3& originOffset, const quat& originOrientation, float time, PoseCache* poseCache = nullptr);
+	/// Рассчитать положение для зацикленной анимации.
+	/** Время берётся по модулю длительности анимации. */
+	void SetupLooped(const vec3& originOffset, const quat& originOrientation, float time, PoseCache* poseCache = nullptr);
+	/// Рассчитать положение с пониженной детализацией.
+	/** Поза в системе модели вычисляется раз в updateInterval секунд, на конец
+	интервала вперёд, а в промежутке интерполируется между границами интервала.
+	levelsCount - количество вычисляемых уровней иерархии костей (отрицательное - все).
+	updateInterval = 0 и levelsCount < 0 дают обычный расчёт каждый вызов.
+	looped - время берётся по модулю длительности анимации. */
+	void SetupLod(const vec3& originOffset, const quat& originOrientation, float time, bool looped, float updateInterval, int levelsCount);
 };
 
 #endif
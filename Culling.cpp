@@ -0,0 +1,277 @@
+#include "Culling.hpp"
+#include <algorithm>
+#include <cmath>
+
+vec3 TransformPoint(const mat4x4& transform, const vec3& point)
+{
+	return vec3(
+		transform(0, 0) * point.x + transform(0, 1) * point.y + transform(0, 2) * point.z + transform(0, 3),
+		transform(1, 0) * point.x + transform(1, 1) * point.y + transform(1, 2) * point.z + transform(1, 3),
+		transform(2, 0) * point.x + transform(2, 1) * point.y + transform(2, 2) * point.z + transform(2, 3));
+}
+
+//*** BoundingBox
+
+BoundingBox::BoundingBox()
+: minimum(1e30f, 1e30f, 1e30f), maximum(-1e30f, -1e30f, -1e30f) {}
+
+BoundingBox::BoundingBox(const vec3& minimum, const vec3& maximum)
+: minimum(minimum), maximum(maximum) {}
+
+bool BoundingBox::IsEmpty() const
+{
+	return minimum.x > maximum.x || minimum.y > maximum.y || minimum.z > maximum.z;
+}
+
+void BoundingBox::Add(const vec3& point)
+{
+	minimum.x = std::min(minimum.x, point.x);
+	minimum.y = std::min(minimum.y, point.y);
+	minimum.z = std::min(minimum.z, point.z);
+	maximum.x = std::max(maximum.x, point.x);
+	maximum.y = std::max(maximum.y, point.y);
+	maximum.z = std::max(maximum.z, point.z);
+}
+
+void BoundingBox::Add(const BoundingBox& box)
+{
+	minimum.x = std::min(minimum.x, box.minimum.x);
+	minimum.y = std::min(minimum.y, box.minimum.y);
+	minimum.z = std::min(minimum.z, box.minimum.z);
+	maximum.x = std::max(maximum.x, box.maximum.x);
+	maximum.y = std::max(maximum.y, box.maximum.y);
+	maximum.z = std::max(maximum.z, box.maximum.z);
+}
+
+vec3 BoundingBox::GetCenter() const
+{
+	return (minimum + maximum) * 0.5f;
+}
+
+vec3 BoundingBox::GetHalfSize() const
+{
+	return (maximum - minimum) * 0.5f;
+}
+
+BoundingBox BoundingBox::Transform(const mat4x4& transform) const
+{
+	// преобразуем центр, а полуразмеры - модулем матрицы (метод Арво)
+	vec3 center = GetCenter();
+	vec3 halfSize = GetHalfSize();
+	vec3 newCenter = TransformPoint(transform, center);
+	vec3 newHalfSize(
+		std::abs(transform(0, 0)) * halfSize.x + std::abs(transform(0, 1)) * halfSize.y + std::abs(transform(0, 2)) * halfSize.z,
+		std::abs(transform(1, 0)) * halfSize.x + std::abs(transform(1, 1)) * halfSize.y + std::abs(transform(1, 2)) * halfSize.z,
+		std::abs(transform(2, 0)) * halfSize.x + std::abs(transform(2, 1)) * halfSize.y + std::abs(transform(2, 2)) * halfSize.z);
+	return BoundingBox(newCenter - newHalfSize, newCenter + newHalfSize);
+}
+
+//*** BoundingSphere
+
+BoundingSphere::BoundingSphere()
+: center(0, 0, 0), radius(0) {}
+
+BoundingSphere::BoundingSphere(const vec3& center, float radius)
+: center(center), radius(radius) {}
+
+BoundingSphere BoundingSphere::Transform(const mat4x4& transform) const
+{
+	// радиус масштабируется максимальной длиной столбца
+	float maxScale = 0;
+	for(int i = 0; i < 3; ++i)
+		maxScale = std::max(maxScale, transform(0, i) * transform(0, i) + transform(1, i) * transform(1, i) + transform(2, i) * transform(2, i));
+	return BoundingSphere(TransformPoint(transform, center), radius * std::sqrt(maxScale));
+}
+
+//*** Frustum
+
+Frustum::Frustum(const mat4x4& viewProj)
+{
+	// плоскости по строкам матрицы (Gribb, Hartmann)
+	// ближняя плоскость берётся для z >= -w, это верно и для z >= 0
+	static const int rows[6] = { 0, 0, 1, 1, 2, 2 };
+	static const float signs[6] = { 1, -1, 1, -1, 1, -1 };
+	for(int i = 0; i < 6; ++i)
+	{
+		vec4 plane(
+			viewProj(3, 0) + viewProj(rows[i], 0) * signs[i],
+			viewProj(3, 1) + viewProj(rows[i], 1) * signs[i],
+			viewProj(3, 2) + viewProj(rows[i], 2) * signs[i],
+			viewProj(3, 3) + viewProj(rows[i], 3) * signs[i]);
+		float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		planes[i] = plane * (1.0f / length);
+	}
+}
+
+Frustum::Intersection Frustum::Test(const BoundingBox& box) const
+{
+	vec3 center = box.GetCenter();
+	vec3 halfSize = box.GetHalfSize();
+	Intersection result = intersectionInside;
+	for(int i = 0; i < 6; ++i)
+	{
+		const vec4& plane = planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::abs(plane.x) * halfSize.x + std::abs(plane.y) * halfSize.y + std::abs(plane.z) * halfSize.z;
+		if(distance < -radius)
+			return intersectionOutside;
+		if(distance < radius)
+			result = intersectionPartial;
+	}
+	return result;
+}
+
+bool Frustum::IsVisible(const BoundingBox& box) const
+{
+	return Test(box) != intersectionOutside;
+}
+
+bool Frustum::IsVisible(const BoundingSphere& sphere) const
+{
+	for(int i = 0; i < 6; ++i)
+	{
+		const vec4& plane = planes[i];
+		if(plane.x * sphere.center.x + plane.y * sphere.center.y + plane.z * sphere.center.z + plane.w < -sphere.radius)
+			return false;
+	}
+	return true;
+}
+
+//*** BoundingVolumeHierarchy
+
+void BoundingVolumeHierarchy::Build(const BoundingBox* boxes, int count)
+{
+	nodes.clear();
+	items.resize(count);
+	for(int i = 0; i < count; ++i)
+		items[i] = i;
+	if(!count)
+		return;
+
+	std::vector<vec3> centers(count);
+	for(int i = 0; i < count; ++i)
+		centers[i] = boxes[i].GetCenter();
+
+	Node root;
+	root.firstItem = 0;
+	root.itemsCount = count;
+	root.firstChild = -1;
+	nodes.push_back(root);
+	BuildNode(0, boxes, &centers[0]);
+}
+
+void BoundingVolumeHierarchy::BuildNode(int nodeNumber, const BoundingBox* boxes, const vec3* centers)
+{
+	int firstItem = nodes[nodeNumber].firstItem;
+	int itemsCount = nodes[nodeNumber].itemsCount;
+
+	// объём узла и разброс центров
+	BoundingBox box, centersBox;
+	for(int i = 0; i < itemsCount; ++i)
+	{
+		box.Add(boxes[items[firstItem + i]]);
+		centersBox.Add(centers[items[firstItem + i]]);
+	}
+	nodes[nodeNumber].box = box;
+
+	if(itemsCount <= maxLeafItemsCount)
+		return;
+
+	// делим по медиане вдоль самой длинной оси центров
+	vec3 extent = centersBox.maximum - centersBox.minimum;
+	int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+	struct AxisSorter
+	{
+		const vec3* centers;
+		int axis;
+		float Get(int item) const
+		{
+			return axis == 0 ? centers[item].x : axis == 1 ? centers[item].y : centers[item].z;
+		}
+		bool operator()(int a, int b) const
+		{
+			return Get(a) < Get(b);
+		}
+	} sorter = { centers, axis };
+	int half = itemsCount / 2;
+	std::nth_element(items.begin() + firstItem, items.begin() + firstItem + half, items.begin() + firstItem + itemsCount, sorter);
+
+	int firstChild = (int)nodes.size();
+	nodes[nodeNumber].firstChild = firstChild;
+	Node child;
+	child.firstChild = -1;
+	child.firstItem = firstItem;
+	child.itemsCount = half;
+	nodes.push_back(child);
+	child.firstItem = firstItem + half;
+	child.itemsCount = itemsCount - half;
+	nodes.push_back(child);
+
+	BuildNode(firstChild, boxes, centers);
+	BuildNode(firstChild + 1, boxes, centers);
+}
+
+void BoundingVolumeHierarchy::Refit(const BoundingBox* boxes)
+{
+	// потомки всегда после родителей, поэтому идём с конца
+	for(int i = (int)nodes.size() - 1; i >= 0; --i)
+	{
+		Node& node = nodes[i];
+		if(node.firstChild < 0)
+		{
+			node.box = BoundingBox();
+			for(int j = 0; j < node.itemsCount; ++j)
+				node.box.Add(boxes[items[node.firstItem + j]]);
+		}
+		else
+		{
+			node.box = nodes[node.firstChild].box;
+			node.box.Add(nodes[node.firstChild + 1].box);
+		}
+	}
+}
+
+int BoundingVolumeHierarchy::GetItemsCount() const
+{
+	return (int)items.size();
+}
+
+void BoundingVolumeHierarchy::Cull(const Frustum& frustum, const BoundingBox* boxes, std::vector<int>& result) const
+{
+	if(nodes.empty())
+		return;
+
+	// обход без рекурсии
+	int stack[64];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while(stackSize)
+	{
+		const Node& node = nodes[stack[--stackSize]];
+		Frustum::Intersection intersection = frustum.Test(node.box);
+		if(intersection == Frustum::intersectionOutside)
+			continue;
+
+		// узел целиком внутри - все элементы поддерева видимы
+		if(intersection == Frustum::intersectionInside)
+		{
+			result.insert(result.end(), items.begin() + node.firstItem, items.begin() + node.firstItem + node.itemsCount);
+			continue;
+		}
+
+		if(node.firstChild < 0)
+		{
+			for(int i = 0; i < node.itemsCount; ++i)
+			{
+				int item = items[node.firstItem + i];
+				if(frustum.IsVisible(boxes[item]))
+					result.push_back(item);
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.firstChild + 1;
+			stack[stackSize++] = node.firstChild;
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef ___BANSHEE_CULLING_HPP___
+#define ___BANSHEE_CULLING_HPP___
+
+#include "general.hpp"
+
+/// Преобразовать точку матрицей.
+vec3 TransformPoint(const mat4x4& transform, const vec3& point);
+
+/// Ограничивающий параллелепипед, выровненный по осям.
+struct BoundingBox
+{
+	vec3 minimum;
+	vec3 maximum;
+
+	/// Создать пустой параллелепипед.
+	BoundingBox();
+	BoundingBox(const vec3& minimum, const vec3& maximum);
+
+	/// Пустой ли параллелепипед.
+	bool IsEmpty() const;
+	/// Расширить, чтобы включал точку.
+	void Add(const vec3& point);
+	/// Расширить, чтобы включал другой параллелепипед.
+	void Add(const BoundingBox& box);
+
+	vec3 GetCenter() const;
+	vec3 GetHalfSize() const;
+
+	/// Получить параллелепипед, ограничивающий преобразованный параллелепипед.
+	BoundingBox Transform(const mat4x4& transform) const;
+};
+
+/// Ограничивающая сфера.
+struct BoundingSphere
+{
+	vec3 center;
+	float radius;
+
+	BoundingSphere();
+	BoundingSphere(const vec3& center, float radius);
+
+	/// Получить сферу, ограничивающую преобразованную сферу.
+	BoundingSphere Transform(const mat4x4& transform) const;
+};
+
+/// Пирамида видимости.
+/** Задаётся шестью плоскостями, полученными из матрицы вид-проекция. */
+class Frustum
+{
+public:
+	/// Результат проверки объёма.
+	enum Intersection
+	{
+		intersectionOutside,
+		intersectionPartial,
+		intersectionInside
+	};
+
+private:
+	/// Плоскости (нормаль направлена внутрь).
+	vec4 planes[6];
+
+public:
+	Frustum(const mat4x4& viewProj);
+
+	Intersection Test(const BoundingBox& box) const;
+	bool IsVisible(const BoundingBox& box) const;
+	bool IsVisible(const BoundingSphere& sphere) const;
+};
+
+/// Иерархия ограничивающих объёмов.
+/** Строится по параллелепипедам элементов. Если элементы двигаются,
+но их количество и порядок не меняются, иерархию достаточно
+пересчитать методом Refit, не перестраивая топологию. */
+class BoundingVolumeHierarchy
+{
+private:
+	/// Узел иерархии.
+	struct Node
+	{
+		BoundingBox box;
+		/// Диапазон элементов поддерева в items.
+		int firstItem;
+		int itemsCount;
+		/// Номер левого потомка (правый идёт следующим), или -1 для листа.
+		int firstChild;
+	};
+	/// Узлы; потомки всегда идут после родителя.
+	std::vector<Node> nodes;
+	/// Номера элементов в порядке обхода листьев.
+	std::vector<int> items;
+
+	/// Максимальное количество элементов в листе.
+	static const int maxLeafItemsCount = 4;
+
+	void BuildNode(int nodeNumber, const BoundingBox* boxes, const vec3* centers);
+
+public:
+	/// Построить иерархию заново.
+	void Build(const BoundingBox* boxes, int count);
+	/// Обновить объёмы узлов, сохранив топологию.
+	/** Количество элементов должно совпадать с тем, что было при построении. */
+	void Refit(const BoundingBox* boxes);
+	/// Количество элементов в иерархии.
+	int GetItemsCount() const;
+
+	/// Добавить в result номера элементов, видимых в пирамиде.
+	void Cull(const Frustum& frustum, const BoundingBox* boxes, std::vector<int>& result) const;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "DrawKeys.hpp"
+#include <cstring>
+
+uint64_t QuantizeDepth(float depth)
+{
+	if(!(depth > 0))
+		return 0;
+	// для положительных float порядок битового представления совпадает с порядком чисел
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits >> 16;
+}
+
+uint64_t QuantizeDepthCoarse(float depth)
+{
+	// показатель степени: 2^-4 .. 2^11, остальное - в крайние ступени
+	int exponent = (int)(QuantizeDepth(depth) >> 7) - 127 + 4;
+	return exponent < 0 ? 0 : exponent > 15 ? 15 : exponent;
+}
+
+uint64_t MakeFrontToBackDrawKey(DrawPass pass, int shaderPermutation, uint32_t materialId, uint32_t geometryId, float depth)
+{
+	return
+		((uint64_t)pass << 60) |
+		((uint64_t)(shaderPermutation & 0xF) << 56) |
+		((uint64_t)(materialId & 0xFFFFF) << 36) |
+		(QuantizeDepthCoarse(depth) << 32) |
+		((uint64_t)(geometryId & 0xFFFF) << 16) |
+		QuantizeDepth(depth);
+}
+
+uint64_t MakeBackToFrontDrawKey(DrawPass pass, int shaderPermutation, uint32_t materialId, uint32_t geometryId, float depth)
+{
+	return
+		((uint64_t)pass << 60) |
+		((0xFFFF - QuantizeDepth(depth)) << 44) |
+		((uint64_t)(shaderPermutation & 0xF) << 40) |
+		((uint64_t)(materialId & 0xFFFFF) << 20) |
+		(uint64_t)(geometryId & 0xFFFFF);
+}
+
+uint64_t MakeDrawKey(DrawPass pass, int shaderPermutation, uint32_t materialId, uint32_t geometryId, float depth)
+{
+	return
+		((uint64_t)pass << 60) |
+		((uint64_t)(shaderPermutation & 0xF) << 56) |
+		((uint64_t)(materialId & 0xFFFFF) << 36) |
+		((uint64_t)(geometryId & 0xFFFFF) << 16) |
+		QuantizeDepth(depth);
+}
+
+void RadixSort(DrawItem* items, DrawItem* temp, int count)
+{
+	const int digitsCount = 8;
+
+	// посчитать гистограммы всех разрядов за один проход
+	int histograms[digitsCount][256];
+	memset(histograms, 0, sizeof(histograms));
+	for(int i = 0; i < count; ++i)
+	{
+		uint64_t key = items[i].key;
+		for(int d = 0; d < digitsCount; ++d)
+			histograms[d][(key >> (d * 8)) & 0xFF]++;
+	}
+
+	DrawItem* source = items;
+	DrawItem* target = temp;
+	for(int d = 0; d < digitsCount; ++d)
+	{
+		int* histogram = histograms[d];
+		int shift = d * 8;
+
+		// если разряд у всех одинаковый, проход не нужен
+		if(!count || histogram[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		// смещения корзин
+		int offset = 0;
+		for(int i = 0; i < 256; ++i)
+		{
+			int c = histogram[i];
+			histogram[i] = offset;
+			offset += c;
+		}
+
+		// разложить по корзинам
+		for(int i = 0; i < count; ++i)
+			target[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+
+		std::swap(source, target);
+	}
+
+	if(source != items)
+		memcpy(items, source, count * sizeof(DrawItem));
+}
@@ -0,0 +1,83 @@
+#ifndef ___BANSHEE_DRAW_KEYS_HPP___
+#define ___BANSHEE_DRAW_KEYS_HPP___
+
+#include "general.hpp"
+
+/*
+Ключ рисования - 64-битное число, по которому сортируются элементы очереди.
+Поля, от старших битов к младшим:
+	проход (2 бита)
+	вариант шейдера (4 бита)
+	номер материала (20 бит)
+	номер геометрии (20 бит)
+	квантованная глубина (16 бит)
+Номера материалов и геометрий выдаются последовательно при создании, поэтому
+порядок не зависит от адресов в куче и одинаков от запуска к запуску.
+Номера, не влезающие в поле, смешали бы ключи разных объектов, поэтому реестры
+Painter не выдают номеров больше drawKeyMaterialsCount и
+drawKeyGeometriesCount (по более узкому полю ключа спереди назад).
+В поле геометрии Painter кладёт номер вместе с уровнем детализации (номер
+умножается на Geometry::maxLodsCount), так что экземпляры одного уровня одной
+геометрии идут подряд; геометрий поэтому может быть не больше
+drawKeyGeometriesCount / Geometry::maxLodsCount (16384).
+
+Ключ с порядком спереди назад (для непрозрачных моделей) вставляет перед
+геометрией грубую глубину:
+	проход (2 бита)
+	вариант шейдера (4 бита)
+	номер материала (20 бит)
+	грубая глубина (4 бита)
+	номер геометрии (16 бит)
+	квантованная глубина (16 бит)
+
+Ключ с порядком сзади вперёд (для полупрозрачных моделей, которые должны
+смешиваться от дальних к ближним) ставит обратную глубину сразу после прохода:
+	проход (4 бита)
+	обратная квантованная глубина (16 бит)
+	вариант шейдера (4 бита)
+	номер материала (20 бит)
+	номер геометрии (20 бит)
+Материалы и геометрии при этом группируются только у моделей одной глубины.
+*/
+
+/// Количество номеров материалов, различимых в ключе.
+const uint32_t drawKeyMaterialsCount = 1 << 20;
+/// Количество номеров геометрий, различимых в любом ключе.
+const uint32_t drawKeyGeometriesCount = 1 << 16;
+
+/// Проход, для которого строится ключ.
+enum DrawPass
+{
+	drawPassShadow,
+	drawPassOpaque,
+	drawPassTransparent
+};
+
+/// Элемент очереди: ключ и номер объекта.
+struct DrawItem
+{
+	uint64_t key;
+	int number;
+};
+
+/// Квантовать глубину в 16 бит.
+/** Берутся старшие биты представления float, что даёт логарифмическую шкалу. */
+uint64_t QuantizeDepth(float depth);
+
+/// Грубо квантовать глубину в 4 бита.
+/** По показателю степени float: одна ступень на каждое удвоение глубины. */
+uint64_t QuantizeDepthCoarse(float depth);
+
+/// Собрать ключ рисования.
+uint64_t MakeDrawKey(DrawPass pass, int shaderPermutation, uint32_t materialId, uint32_t geometryId, float depth);
+/// Собрать ключ рисования с порядком спереди назад внутри материала.
+uint64_t MakeFrontToBackDrawKey(DrawPass pass, int shaderPermutation, uint32_t materialId, uint32_t geometryId, float depth);
+/// Собрать ключ рисования с порядком сзади вперёд.
+uint64_t MakeBackToFrontDrawKey(DrawPass pass, int shaderPermutation, uint32_t materialId, uint32_t geometryId, float depth);
+
+/// Отсортировать элементы по ключу.
+/** Поразрядная сортировка (LSD) по 8 бит, устойчивая. temp должен вмещать count элементов.
+Разряды, одинаковые у всех ключей, пропускаются. */
+void RadixSort(DrawItem* items, DrawItem* temp, int count);
+
+#endif
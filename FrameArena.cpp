@@ -0,0 +1,61 @@
+#include "FrameArena.hpp"
+#include <cstdlib>
+
+FrameArena::FrameArena(size_t initialSize) :
+	block(0), blockSize(0), allocatedSize(0), requestedSize(0)
+{
+	if(initialSize)
+	{
+		block = (char*)malloc(initialSize);
+		if(!block)
+			THROW("Can't allocate frame arena");
+		blockSize = initialSize;
+	}
+}
+
+FrameArena::~FrameArena()
+{
+	for(size_t i = 0; i < overflowBlocks.size(); ++i)
+		free(overflowBlocks[i]);
+	free(block);
+}
+
+void* FrameArena::Allocate(size_t size)
+{
+	size = (size + alignment - 1) & ~(alignment - 1);
+	requestedSize += size;
+
+	if(allocatedSize + size <= blockSize)
+	{
+		void* data = block + allocatedSize;
+		allocatedSize += size;
+		return data;
+	}
+
+	// основной блок кончился, берём из кучи до конца кадра
+	char* data = (char*)malloc(size);
+	if(!data)
+		THROW("Can't allocate memory in frame arena");
+	overflowBlocks.push_back(data);
+	return data;
+}
+
+void FrameArena::Reset()
+{
+	for(size_t i = 0; i < overflowBlocks.size(); ++i)
+		free(overflowBlocks[i]);
+	overflowBlocks.clear();
+
+	// увеличить основной блок, чтобы следующий кадр в него поместился
+	if(requestedSize > blockSize)
+	{
+		free(block);
+		blockSize = requestedSize + requestedSize / 2;
+		block = (char*)malloc(blockSize);
+		if(!block)
+			THROW("Can't allocate frame arena");
+	}
+
+	allocatedSize = 0;
+	requestedSize = 0;
+}
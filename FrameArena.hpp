@@ -0,0 +1,88 @@
+#ifndef ___BANSHEE_FRAME_ARENA_HPP___
+#define ___BANSHEE_FRAME_ARENA_HPP___
+
+#include "general.hpp"
+#include <cstring>
+
+/// Линейный аллокатор памяти кадра.
+/** Память выделяется сдвигом указателя и освобождается вся сразу в Reset.
+Если за кадр основного блока не хватило, недостающее берётся из кучи,
+а при сбросе основной блок увеличивается до объёма прошедшего кадра,
+так что в установившемся режиме обращений к куче нет. Деструкторы
+выделенных объектов не вызываются. */
+class FrameArena
+{
+private:
+	char* block;
+	size_t blockSize;
+	size_t allocatedSize;
+	/// Всего запрошено за кадр (вместе с дополнительными блоками).
+	size_t requestedSize;
+	/// Дополнительные блоки, выделенные при переполнении.
+	std::vector<char*> overflowBlocks;
+
+	/// Выравнивание всех выделений.
+	static const size_t alignment = 16;
+
+public:
+	FrameArena(size_t initialSize = 0);
+	~FrameArena();
+
+	/// Выделить память.
+	void* Allocate(size_t size);
+	/// Освободить всю память кадра.
+	void Reset();
+};
+
+/// Массив, растущий в памяти кадра.
+/** Только для POD-элементов. При росте старая память не освобождается до
+сброса арены. Массив нужно очистить (Clear) при сбросе арены. */
+template <typename T>
+class FrameArray
+{
+private:
+	FrameArena* arena;
+	T* items;
+	int count;
+	int capacity;
+
+public:
+	FrameArray(FrameArena* arena) : arena(arena), items(0), count(0), capacity(0) {}
+
+	void Add(const T& item)
+	{
+		if(count >= capacity)
+		{
+			int newCapacity = capacity ? capacity * 2 : 64;
+			T* newItems = (T*)arena->Allocate(newCapacity * sizeof(T));
+			if(count)
+				memcpy(newItems, items, count * sizeof(T));
+			items = newItems;
+			capacity = newCapacity;
+		}
+		items[count++] = item;
+	}
+
+	void Clear()
+	{
+		items = 0;
+		count = 0;
+		capacity = 0;
+	}
+
+	int GetCount() const
+	{
+		return count;
+	}
+
+	T& operator[](int i)
+	{
+		return items[i];
+	}
+	const T& operator[](int i) const
+	{
+		return items[i];
+	}
+};
+
+#endif
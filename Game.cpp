@@ -7,6 +7,12 @@
 #include "Skeleton.hpp"
 #include "BoneAnimation.hpp"
 #include "Banshee.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "PoseCache.hpp"
+#include "AnimationLod.hpp"
+#include "PoseBatch.hpp"
+#include "MeshOptimization.hpp"
 #include "../inanity/script/lua/State.hpp"
 #ifndef ___INANITY_PLATFORM_EMSCRIPTEN
 #include "../inanity/inanity-sqlitefs.hpp"
@@ -14,6 +20,8 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <fstream>
+#include <algorithm>
 
 Game* Game::singleGame = 0;
 
@@ -21,7 +29,13 @@ const float pi = 3.1415926535897932f;
 const float gravity = -9.8f;
 
 Game::Game() :
-	bloomLimit(10.0f), toneLuminanceKey(0.12f), toneMaxLuminance(3.1f)
+	animationTime(0),
+	bloomLimit(10.0f), toneLuminanceKey(0.12f), toneMaxLuminance(3.1f),
+	statsOverlay(false),
+	animationMaxError(0.001f), animationResampleRate(0),
+	geometryOptimization(false), geometryOverdrawThreshold(0),
+	optimizedTrianglesCount(0), optimizedMissesBefore(0), optimizedMissesAfter(0),
+	benchmarkCameraCenter(0, 0, 0), benchmarkCameraRadius(30.0f), benchmarkCameraHeight(10.0f), benchmarkCameraSpeed(0.2f)
 {
 	singleGame = this;
 }
@@ -86,7 +100,13 @@ void Game::Run()
 
 		geometryFormats = NEW(GeometryFormats());
 
-		painter = NEW(Painter(device, context, presenter, shaderCache, geometryFormats));
+		jobSystem = NEW(JobSystem());
+		profiler = NEW(Profiler());
+		poseCache = NEW(PoseCache());
+		animationLod = NEW(AnimationLod());
+		poseBatch = NEW(PoseBatch());
+
+		painter = NEW(Painter(device, context, presenter, shaderCache, geometryFormats, jobSystem, profiler));
 
 		{
 			SamplerSettings samplerSettings;
@@ -109,19 +129,13 @@ void Game::Run()
 		physicsWorld = NEW(Physics::BtWorld());
 
 		// запустить стартовый скрипт
-		ptr<Script::Lua::State> luaState = NEW(Script::Lua::State());
-		luaState->Register<Game>();
-		luaState->Register<Material>();
-		scriptState = luaState;
-
-		ptr<Script::Function> mainScript = scriptState->LoadScript(fileSystem->LoadFile(
+		RunStartScript(
 #ifdef PRODUCTION
 			"/main.luab"
 #else
 			"/main.lua"
 #endif
-		));
-		mainScript->Run();
+		);
 
 		window->SetMouseLock(true);
 		window->SetCursorVisible(false);
@@ -144,10 +158,23 @@ void Game::Run()
 	}
 }
 
+void Game::RunStartScript(const String& fileName)
+{
+	ptr<Script::Lua::State> luaState = NEW(Script::Lua::State());
+	luaState->Register<Game>();
+	luaState->Register<Material>();
+	scriptState = luaState;
+
+	scriptState->LoadScript(fileSystem->LoadFile(fileName))->Run();
+}
+
 void Game::Tick()
 {
 	float frameTime = ticker.Tick();
 
+	profiler->BeginFrame();
+	poseCache->BeginFrame();
+
 	static bool cameraMode = false;
 
 	Banshee::BansheeStepParams hero_step_params;
@@ -192,6 +219,9 @@ void Game::Tick()
 				case Input::Keys::C:
 					cameraMode = !cameraMode;
 					break;
+				case Input::Keys::P:
+					statsOverlay = !statsOverlay;
+					break;
 
 				case Input::Keys::_1:
 					bloomLimit -= 0.1f;
@@ -308,7 +338,10 @@ void Game::Tick()
 		cameraMove += cameraMoveDirectionUp * cameraStep;
 
 
-	physicsWorld->Simulate(frameTime);
+	{
+		Profiler::Scope profileScope(profiler, "physics");
+		physicsWorld->Simulate(frameTime);
+	}
 
 
 	// if(controlMaxForce)
@@ -321,7 +354,10 @@ void Game::Tick()
 	// for(Banshees::iterator i = banshees.begin(); i != banshees.end(); ++i)
 	// 	(*i)->Step(frameTime);
 
-	hero->Step(hero_step_params);
+	{
+		Profiler::Scope profileScope(profiler, "banshee");
+		hero->Step(hero_step_params);
+	}
 
 
 	mat4x4 viewMatrix;
@@ -364,42 +400,18 @@ void Game::Tick()
 	mat4x4 projMatrix = CreateProjectionPerspectiveFovMatrix(pi / 4, float(screenWidth) / float(screenHeight), 0.1f, 10000.0f);
 
 	// зарегистрировать все объекты
-	painter->BeginFrame(frameTime);
-	painter->SetCamera(projMatrix * viewMatrix, cameraPosition);
-	painter->SetAmbientColor(ambientColor);
-
-	for(size_t i = 0; i < staticModels.size(); ++i)
-	{
-		const StaticModel& model = staticModels[i];
-		painter->AddModel(model.material, model.geometry, model.transform);
-	}
-
-	for(size_t i = 0; i < rigidModels.size(); ++i)
-	{
-		const RigidModel& model = rigidModels[i];
-		painter->AddModel(model.material, model.geometry, model.rigidBody->GetTransform());
-	}
+	RegisterObjects(frameTime, projMatrix * viewMatrix);
 
-	for(size_t i = 0; i < staticLights.size(); ++i)
 	{
-		ptr<StaticLight> light = staticLights[i];
-		if(light->shadow)
-			painter->AddShadowLight(light->position, light->color, light->transform);
-		else
-			painter->AddBasicLight(light->position, light->color);
+		Profiler::Scope profileScope(profiler, "draw");
+		painter->Draw();
 	}
 
-	for(Banshees::const_iterator i = banshees.begin(); i != banshees.end(); ++i)
-		(*i)->Paint(painter);
-
-	painter->SetupPostprocess(bloomLimit, toneLuminanceKey, toneMaxLuminance);
-
-	painter->Draw();
-
 	canvas->SetContext(context);
 
 	// fps
 	{
+		Profiler::Scope profileScope(profiler, "overlay");
 		Context::LetFrameBuffer lfb(context, presenter->GetFrameBuffer());
 		Context::LetViewport lv(context, screenWidth, screenHeight);
 
@@ -420,6 +432,32 @@ void Game::Tick()
 		font->DrawString(canvas, fpsString, (uint32_t)'Zyyy', vec2(20.0f, (float)screenHeight - 20.0f), vec4(1, 0, 0, 1));
 		font->DrawString(canvas, Banshee::bansheeDebug, (uint32_t)'Zyyy', vec2(20.0f, (float)screenHeight - 40.0f), vec4(0, 1, 0, 1));
 
+		// статистика отсечения
+		char cullingString[64];
+		sprintf(cullingString, "drawn: %d, culled: %d", painter->GetDrawnObjectsCount(), painter->GetCulledObjectsCount());
+		font->DrawString(canvas, cullingString, (uint32_t)'Zyyy', vec2(20.0f, (float)screenHeight - 60.0f), vec4(1, 1, 0, 1));
+
+		// статистика рисования по проходам
+		if(statsOverlay)
+		{
+			const RenderStats& stats = painter->GetStats();
+			float y = (float)screenHeight - 80.0f;
+			for(int i = 0; i <= RenderStats::passesCount; ++i)
+			{
+				PassStats passStats = i < RenderStats::passesCount ? stats[i] : stats.GetTotal();
+				// пустые проходы не показываются
+				if(!passStats.drawCalls)
+					continue;
+				char statsString[160];
+				sprintf(statsString, "%s: draws %d, instances %d, triangles %d, uploads %d, samplers %d, ps %d",
+					i < RenderStats::passesCount ? RenderStats::GetPassName(i) : "total",
+					passStats.drawCalls, passStats.instances, passStats.triangles,
+					passStats.uniformUploads, passStats.samplerBinds, passStats.pixelShaderSwitches);
+				font->DrawString(canvas, statsString, (uint32_t)'Zyyy', vec2(20.0f, y), vec4(0, 1, 1, 1));
+				y -= 20.0f;
+			}
+		}
+
 		#if 0
 		// normal control
 
@@ -445,7 +483,184 @@ void Game::Tick()
 		canvas->Flush();
 	}
 
-	presenter->Present();
+	{
+		Profiler::Scope profileScope(profiler, "present");
+		presenter->Present();
+	}
+
+	profiler->EndFrame();
+}
+
+void Game::RegisterObjects(float frameTime, const mat4x4& viewProjMatrix)
+{
+	Profiler::Scope profileScope(profiler, "register");
+
+	painter->BeginFrame(frameTime);
+	painter->SetCamera(viewProjMatrix, cameraPosition);
+	animationLod->BeginFrame(viewProjMatrix, frameTime);
+
+	// рассчитать анимации кадра, пока рисователь не забрал позы
+	animationTime += frameTime;
+	{
+		Profiler::Scope profileScope(profiler, "animation");
+		for(size_t i = 0; i < skinnedModels.size(); ++i)
+		{
+			const SkinnedModel& model = skinnedModels[i];
+			// сфера геометрии переносится в мир так же, как начало координат модели
+			const BoundingSphere& boundingSphere = model.geometry->GetBoundingSphere();
+			vec3 center = fromEigen((toEigenQuat(model.orientation) * toEigen(boundingSphere.center)).eval()) + model.position;
+			poseBatch->Add(model.animationFrame, model.position, model.orientation, animationTime + model.timeOffset, true,
+				center, boundingSphere.radius);
+		}
+		poseBatch->Run(jobSystem, poseCache, animationLod);
+	}
+	for(size_t i = 0; i < skinnedModels.size(); ++i)
+	{
+		const SkinnedModel& model = skinnedModels[i];
+		painter->AddSkinnedModel(model.material, model.geometry, model.animationFrame);
+	}
+	painter->SetAmbientColor(ambientColor);
+
+	// собрать матрицы физических моделей параллельно
+	rigidTransforms.resize(rigidModels.size());
+	jobSystem->ParallelFor((int)rigidModels.size(), 64, [this](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+			rigidTransforms[i] = rigidModels[i].rigidBody->GetTransform();
+	});
+	for(size_t i = 0; i < rigidModels.size(); ++i)
+	{
+		const RigidModel& model = rigidModels[i];
+		painter->AddModel(model.material, model.geometry, rigidTransforms[i]);
+	}
+
+	for(size_t i = 0; i < staticLights.size(); ++i)
+	{
+		ptr<StaticLight> light = staticLights[i];
+		if(light->shadow)
+			painter->AddShadowLight(light->position, light->color, light->transform);
+		else
+			painter->AddBasicLight(light->position, light->color);
+	}
+
+	for(Banshees::const_iterator i = banshees.begin(); i != banshees.end(); ++i)
+		(*i)->Paint(painter);
+
+	painter->SetupPostprocess(bloomLimit, toneLuminanceKey, toneMaxLuminance);
+}
+
+/// Записать статистику этапа бенчмарка в JSON, в миллисекундах.
+static void WriteBenchmarkStage(std::ostream& output, const char* name, std::vector<float>& samples)
+{
+	std::sort(samples.begin(), samples.end());
+	int count = (int)samples.size();
+	double sum = 0;
+	for(int i = 0; i < count; ++i)
+		sum += samples[i];
+	// перцентиль по ближайшему рангу
+	auto percentile = [&](float p) -> float
+	{
+		int i = (int)ceil(p * count) - 1;
+		return count ? samples[std::min(std::max(i, 0), count - 1)] : 0.0f;
+	};
+	output << '"' << name << "\":{"
+		<< "\"mean\":" << (count ? sum / count : 0) * 1e3
+		<< ",\"p50\":" << percentile(0.5f) * 1e3
+		<< ",\"p90\":" << percentile(0.9f) * 1e3
+		<< ",\"p99\":" << percentile(0.99f) * 1e3
+		<< ",\"max\":" << (count ? samples.back() : 0.0f) * 1e3
+		<< '}';
+}
+
+void Game::RunBenchmark(const String& sceneFileName, int ticksCount, float frameTime, std::ostream& output)
+{
+	try
+	{
+		// ни окна, ни ввода, ни графического устройства
+		fileSystem = NEW(Data::BufferedFileSystem(NEW(Platform::FileSystem("assets"))));
+		geometryFormats = NEW(GeometryFormats());
+		jobSystem = NEW(JobSystem());
+		profiler = NEW(Profiler());
+		poseCache = NEW(PoseCache());
+		animationLod = NEW(AnimationLod());
+		poseBatch = NEW(PoseBatch());
+		painter = NEW(Painter(nullptr, nullptr, nullptr, nullptr, geometryFormats, jobSystem, profiler));
+		physicsWorld = NEW(Physics::BtWorld());
+
+		RunStartScript(sceneFileName);
+
+		const int screenWidth = 800;
+		const int screenHeight = 600;
+		painter->Resize(screenWidth, screenHeight);
+		mat4x4 projMatrix = CreateProjectionPerspectiveFovMatrix(pi / 4, float(screenWidth) / float(screenHeight), 0.1f, 10000.0f);
+
+		// замеряемые этапы; последний ряд замеров - кадр целиком
+		static const char* const stageNames[] = { "physics", "banshee", "register", "prepare", "draw" };
+		const int stagesCount = sizeof(stageNames) / sizeof(stageNames[0]);
+		std::vector<float> samples[stagesCount + 1];
+		for(int i = 0; i <= stagesCount; ++i)
+			samples[i].reserve(ticksCount);
+		// сумма нарисованных объектов - для проверки детерминированности
+		long long drawnObjectsCount = 0;
+
+		for(int tick = 0; tick < ticksCount; ++tick)
+		{
+			profiler->BeginFrame();
+			poseCache->BeginFrame();
+
+			{
+				Profiler::Scope profileScope(profiler, "physics");
+				physicsWorld->Simulate(frameTime);
+			}
+
+			if(hero)
+			{
+				Profiler::Scope profileScope(profiler, "banshee");
+				Banshee::BansheeStepParams stepParams;
+				stepParams.frame_time = frameTime;
+				stepParams.desired_force = bansheeParams.normalRotorForce;
+				hero->Step(stepParams);
+			}
+
+			// камера облетает центр по окружности
+			float angle = benchmarkCameraSpeed * frameTime * tick;
+			cameraPosition = benchmarkCameraCenter + vec3(cos(angle) * benchmarkCameraRadius, sin(angle) * benchmarkCameraRadius, benchmarkCameraHeight);
+			mat4x4 viewMatrix = CreateLookAtMatrix(cameraPosition, benchmarkCameraCenter, vec3(0, 0, 1));
+
+			RegisterObjects(frameTime, projMatrix * viewMatrix);
+
+			{
+				Profiler::Scope profileScope(profiler, "draw");
+				painter->Draw();
+			}
+
+			profiler->EndFrame();
+
+			for(int i = 0; i < stagesCount; ++i)
+				samples[i].push_back(profiler->GetScopeTime(stageNames[i], 0));
+			samples[stagesCount].push_back(profiler->GetFrameTime(0));
+			drawnObjectsCount += painter->GetDrawnObjectsCount();
+		}
+
+		output
+			<< "{\"scene\":\"" << sceneFileName << '"'
+			<< ",\"ticks\":" << ticksCount
+			<< ",\"frameTime\":" << frameTime
+			<< ",\"threads\":" << jobSystem->GetThreadsCount()
+			<< ",\"drawnObjects\":" << drawnObjectsCount
+			<< ",\"stages\":{";
+		for(int i = 0; i <= stagesCount; ++i)
+		{
+			if(i)
+				output << ',';
+			WriteBenchmarkStage(output, i < stagesCount ? stageNames[i] : "frame", samples[i]);
+		}
+		output << "}}\n";
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't run benchmark", exception);
+	}
 }
 
 ptr<Game> Game::Get()
@@ -455,23 +670,82 @@ ptr<Game> Game::Get()
 
 ptr<Texture> Game::LoadTexture(const String& fileName)
 {
+	// без графического устройства текстуры не загружаются
+	if(!textureManager)
+		return nullptr;
 	return textureManager->Get(fileName);
 }
 
 ptr<Geometry> Game::LoadGeometry(const String& fileName)
 {
-	return NEW(Geometry(
-		device->CreateStaticVertexBuffer(fileSystem->LoadFile(fileName + ".vertices"), geometryFormats->vl),
-		device->CreateStaticIndexBuffer(fileSystem->LoadFile(fileName + ".indices"), sizeof(short))
+	ptr<File> verticesFile = fileSystem->LoadFile(fileName + ".vertices");
+	BoundingBox boundingBox;
+	BoundingSphere boundingSphere;
+	Geometry::CalculateBounds(verticesFile, GeometryFormats::vertexStride, boundingBox, boundingSphere);
+	// без графического устройства нужны только ограничивающие объёмы
+	if(!device)
+		return NEW(Geometry(nullptr, nullptr, boundingBox, boundingSphere));
+	int verticesCount = (int)(verticesFile->GetSize() / GeometryFormats::vertexStride);
+	ptr<File> indicesFile = fileSystem->LoadFile(fileName + ".indices");
+	std::vector<uint32_t> vertexRemap;
+	if(geometryOptimization)
+		CountGeometryOptimization(OptimizeGeometry(verticesFile, indicesFile, GeometryFormats::vertexStride, geometryOverdrawThreshold, vertexRemap));
+	ptr<Geometry> geometry = NEW(Geometry(
+		device->CreateStaticVertexBuffer(verticesFile, geometryFormats->vl),
+		device->CreateStaticIndexBuffer(indicesFile, Geometry::GetIndexSize(verticesCount)),
+		boundingBox, boundingSphere
 	));
+	geometry->SetVertexRemap(vertexRemap);
+	return geometry;
 }
 
-ptr<Geometry> Game::LoadSkinnedGeometry(const String& fileName)
+ptr<Geometry> Game::LoadSkinnedGeometry(const String& fileName, ptr<Skeleton> skeleton)
 {
-	return NEW(Geometry(
-		device->CreateStaticVertexBuffer(fileSystem->LoadFile(fileName + ".vertices"), geometryFormats->vlSkinned),
-		device->CreateStaticIndexBuffer(fileSystem->LoadFile(fileName + ".indices"), sizeof(short))
+	ptr<File> verticesFile = fileSystem->LoadFile(fileName + ".vertices");
+	if(skeleton)
+		verticesFile = skeleton->RemapSkinnedVertices(verticesFile);
+	BoundingBox boundingBox;
+	BoundingSphere boundingSphere;
+	Geometry::CalculateBounds(verticesFile, GeometryFormats::skinnedVertexStride, boundingBox, boundingSphere);
+	// вершины остаются в памяти для CPU-скиннинга;
+	// без графического устройства больше ничего не нужно
+	if(!device)
+		return NEW(Geometry(nullptr, nullptr, boundingBox, boundingSphere, verticesFile));
+	int verticesCount = (int)(verticesFile->GetSize() / GeometryFormats::skinnedVertexStride);
+	ptr<File> indicesFile = fileSystem->LoadFile(fileName + ".indices");
+	std::vector<uint32_t> vertexRemap;
+	if(geometryOptimization)
+		CountGeometryOptimization(OptimizeGeometry(verticesFile, indicesFile, GeometryFormats::skinnedVertexStride, geometryOverdrawThreshold, vertexRemap));
+	ptr<Geometry> geometry = NEW(Geometry(
+		device->CreateStaticVertexBuffer(verticesFile, geometryFormats->vlSkinned),
+		device->CreateStaticIndexBuffer(indicesFile, Geometry::GetIndexSize(verticesCount)),
+		boundingBox, boundingSphere, verticesFile
 	));
+	geometry->SetVertexRemap(vertexRemap);
+	return geometry;
+}
+
+void Game::CountGeometryOptimization(const MeshOptimizationStats& stats)
+{
+	optimizedTrianglesCount += stats.trianglesCount;
+	optimizedMissesBefore += stats.acmrBefore * stats.trianglesCount;
+	optimizedMissesAfter += stats.acmrAfter * stats.trianglesCount;
+}
+
+void Game::AddGeometryLod(ptr<Geometry> geometry, const String& fileName, float maxScreenSize)
+{
+	// индексы уровня ссылаются на те же вершины, поэтому того же размера
+	ptr<IndexBuffer> indexBuffer;
+	if(device)
+	{
+		ptr<File> indicesFile = fileSystem->LoadFile(fileName + ".indices");
+		// вершины геометрии могли быть переставлены при загрузке
+		const std::vector<uint32_t>& vertexRemap = geometry->GetVertexRemap();
+		if(!vertexRemap.empty())
+			CountGeometryOptimization(OptimizeLodIndices(indicesFile, vertexRemap));
+		indexBuffer = device->CreateStaticIndexBuffer(indicesFile, geometry->GetIndexBuffer()->GetIndexSize());
+	}
+	geometry->AddLod(indexBuffer, maxScreenSize);
 }
 
 ptr<Skeleton> Game::LoadSkeleton(const String& fileName)
@@ -489,7 +763,10 @@ ptr<BoneAnimation> Game::LoadBoneAnimation(const String& fileName, ptr<Skeleton>
 		bones[0].parent = 0;
 		skeleton = NEW(Skeleton(bones));
 	}
-	return BoneAnimation::Deserialize(fileSystem->LoadStream(fileName), skeleton);
+	ptr<BoneAnimation> animation = BoneAnimation::Deserialize(fileSystem->LoadStream(fileName), skeleton, animationMaxError);
+	if(animationResampleRate > 0)
+		animation->Resample(animationResampleRate);
+	return animation;
 }
 
 ptr<Physics::Shape> Game::CreatePhysicsBoxShape(const vec3& halfSize)
@@ -533,14 +810,11 @@ void Game::AddStaticModel(ptr<Geometry> geometry, ptr<Material> material, const
 
 void Game::AddStaticModelWithScale(ptr<Geometry> geometry, ptr<Material> material, const vec3& position, const vec3& scale)
 {
-	StaticModel model;
-	model.geometry = geometry;
-	model.material = material;
 	Eigen::Affine3f transform = Eigen::Affine3f::Identity();
 	transform.translate(toEigen(position));
 	transform.scale(toEigen(scale));
-	model.transform = fromEigen(transform.matrix());
-	staticModels.push_back(model);
+	// статические модели регистрируются в painter'е один раз
+	painter->AddStaticModel(material, geometry, fromEigen(transform.matrix()));
 }
 
 void Game::AddRigidModel(ptr<Geometry> geometry, ptr<Material> material, ptr<Physics::RigidBody> physicsRigidBody)
@@ -552,6 +826,18 @@ void Game::AddRigidModel(ptr<Geometry> geometry, ptr<Material> material, ptr<Phy
 	rigidModels.push_back(model);
 }
 
+void Game::AddSkinnedModel(ptr<Geometry> geometry, ptr<Material> material, ptr<BoneAnimation> animation, const vec3& position, float angle, float timeOffset)
+{
+	SkinnedModel model;
+	model.geometry = geometry;
+	model.material = material;
+	model.animationFrame = NEW(BoneAnimationFrame(animation));
+	model.position = position;
+	model.orientation = quat(0, 0, sin(angle * 0.5f), cos(angle * 0.5f));
+	model.timeOffset = timeOffset;
+	skinnedModels.push_back(model);
+}
+
 void Game::AddStaticRigidBody(ptr<Physics::RigidBody> rigidBody)
 {
 	staticRigidBodies.push_back(rigidBody);
@@ -574,6 +860,124 @@ void Game::SetBackgroundTexture(ptr<Texture> texture)
 	painter->SetBackgroundTexture(texture);
 }
 
+void Game::SetDepthPrePass(bool depthPrePass)
+{
+	painter->SetDepthPrePass(depthPrePass);
+}
+
+void Game::SetPreSkinning(bool preSkinning)
+{
+	painter->SetPreSkinning(preSkinning);
+}
+
+void Game::SetShadowLodBias(int shadowLodBias)
+{
+	painter->SetShadowLodBias(shadowLodBias);
+}
+
+void Game::SetAnimationMaxError(float animationMaxError)
+{
+	this->animationMaxError = animationMaxError;
+}
+
+void Game::SetAnimationResampleRate(float animationResampleRate)
+{
+	this->animationResampleRate = animationResampleRate;
+}
+
+void Game::SetGeometryOptimization(bool geometryOptimization, float geometryOverdrawThreshold)
+{
+	this->geometryOptimization = geometryOptimization;
+	this->geometryOverdrawThreshold = geometryOverdrawThreshold;
+}
+
+float Game::GetGeometryAcmr(bool optimized)
+{
+	if(!optimizedTrianglesCount)
+		return 0;
+	return (optimized ? optimizedMissesAfter : optimizedMissesBefore) / optimizedTrianglesCount;
+}
+
+void Game::SetPoseCacheTimeStep(float timeStep)
+{
+	poseCache->SetTimeStep(timeStep);
+}
+
+void Game::SetAnimationLodLevelsCount(int levelsCount)
+{
+	animationLod->SetLevelsCount(levelsCount);
+}
+
+void Game::SetAnimationLodLevel(int number, float minScreenSize, int updatePeriod, int boneLevelsCount)
+{
+	animationLod->SetLevel(number, minScreenSize, updatePeriod, boneLevelsCount);
+}
+
+int Game::GetAnimationLodInstancesCount(int level)
+{
+	return animationLod->GetLevelInstancesCount(level);
+}
+
+void Game::SetBenchmarkCamera(const vec3& center, float radius, float height, float speed)
+{
+	benchmarkCameraCenter = center;
+	benchmarkCameraRadius = radius;
+	benchmarkCameraHeight = height;
+	benchmarkCameraSpeed = speed;
+}
+
+void Game::SetStatsOverlay(bool statsOverlay)
+{
+	this->statsOverlay = statsOverlay;
+}
+
+int Game::GetRenderPassesCount()
+{
+	return RenderStats::passesCount;
+}
+
+String Game::GetRenderPassName(int pass)
+{
+	if(pass < 0 || pass >= RenderStats::passesCount)
+		THROW("Invalid render pass");
+	return RenderStats::GetPassName(pass);
+}
+
+int Game::GetRenderStat(int pass, const String& counterName)
+{
+	if(pass < 0 || pass >= RenderStats::passesCount)
+		THROW("Invalid render pass");
+	return painter->GetStats()[pass].Get(counterName);
+}
+
+int Game::GetProfileFramesCount()
+{
+	return profiler->GetRecordedFramesCount();
+}
+
+float Game::GetProfileFrameTime(int frameAgo)
+{
+	return profiler->GetFrameTime(frameAgo);
+}
+
+float Game::GetProfileScopeTime(const String& name, int frameAgo)
+{
+	return profiler->GetScopeTime(name.c_str(), frameAgo);
+}
+
+float Game::GetProfileAverageScopeTime(const String& name)
+{
+	return profiler->GetAverageScopeTime(name.c_str());
+}
+
+void Game::ExportProfile(const String& fileName)
+{
+	std::ofstream stream(fileName.c_str());
+	if(!stream)
+		THROW("Can't open profile file " + fileName);
+	profiler->ExportChromeTrace(stream);
+}
+
 void Game::SetBansheeParams(
 	ptr<Geometry> mainGeometry,
 	ptr<Geometry> leftWingGeometry,
@@ -3,6 +3,7 @@
 
 #include "general.hpp"
 #include <unordered_set>
+#include <ostream>
 
 class Geometry;
 class GeometryFormats;
@@ -12,6 +13,12 @@ class BoneAnimation;
 class BoneAnimationFrame;
 class Painter;
 class Camera;
+class JobSystem;
+class Profiler;
+class PoseCache;
+class AnimationLod;
+class PoseBatch;
+struct MeshOptimizationStats;
 
 struct StaticLight : public Object
 {
@@ -50,6 +57,18 @@ private:
 
 	ptr<Painter> painter;
 
+	/// Планировщик задач.
+	ptr<JobSystem> jobSystem;
+	/// Профайлер кадра.
+	ptr<Profiler> profiler;
+	/// Кэш поз скелетов на кадр, общий для анимированных моделей.
+	ptr<PoseCache> poseCache;
+	/// Уровни детализации анимации по размеру на экране.
+	ptr<AnimationLod> animationLod;
+	/// Пакет запросов на расчёт кадров анимации.
+	/** Рассчитывается параллельно при регистрации объектов, до рисования. */
+	ptr<PoseBatch> poseBatch;
+
 	ptr<FileSystem> fileSystem;
 
 	ptr<Input::Manager> inputManager;
@@ -66,21 +85,30 @@ private:
 	ptr<Material> decalMaterial;
 	ptr<Material> debugMaterial;
 
-	struct StaticModel
+	struct RigidModel
 	{
 		ptr<Geometry> geometry;
 		ptr<Material> material;
-		mat4x4 transform;
+		ptr<Physics::RigidBody> rigidBody;
 	};
-	std::vector<StaticModel> staticModels;
+	std::vector<RigidModel> rigidModels;
+	/// Матрицы мира физических моделей в текущем кадре.
+	std::vector<mat4x4> rigidTransforms;
 
-	struct RigidModel
+	/// Анимированная skinned-модель.
+	struct SkinnedModel
 	{
 		ptr<Geometry> geometry;
 		ptr<Material> material;
-		ptr<Physics::RigidBody> rigidBody;
+		ptr<BoneAnimationFrame> animationFrame;
+		vec3 position;
+		quat orientation;
+		/// Сдвиг времени анимации, чтобы одинаковые модели не двигались синхронно.
+		float timeOffset;
 	};
-	std::vector<RigidModel> rigidModels;
+	std::vector<SkinnedModel> skinnedModels;
+	/// Время анимаций skinned-моделей.
+	float animationTime;
 
 	std::vector<ptr<Physics::RigidBody> > staticRigidBodies;
 
@@ -138,6 +166,36 @@ private:
 
 	float bloomLimit, toneLuminanceKey, toneMaxLuminance;
 
+	/// Показывать ли статистику рисования по проходам.
+	bool statsOverlay;
+
+	/// Допустимая угловая ошибка при сжатии загружаемых анимаций, в радианах.
+	float animationMaxError;
+	/// Частота пересэмплирования загружаемых анимаций (0 - не пересэмплировать).
+	float animationResampleRate;
+
+	/// Оптимизировать ли порядок треугольников и вершин загружаемой геометрии.
+	bool geometryOptimization;
+	/// Допустимое ухудшение ACMR при оптимизации перерисовки (0 - без неё).
+	float geometryOverdrawThreshold;
+	/// Статистика оптимизации загруженной геометрии: треугольники и промахи кэша до и после.
+	int optimizedTrianglesCount;
+	float optimizedMissesBefore, optimizedMissesAfter;
+	/// Учесть оптимизацию геометрии в статистике.
+	void CountGeometryOptimization(const MeshOptimizationStats& stats);
+
+	/// Траектория камеры в бенчмарке: окружность вокруг центра.
+	vec3 benchmarkCameraCenter;
+	float benchmarkCameraRadius;
+	float benchmarkCameraHeight;
+	/// Угловая скорость камеры в бенчмарке, радиан в секунду.
+	float benchmarkCameraSpeed;
+
+	/// Создать состояние скрипта и выполнить стартовый скрипт.
+	void RunStartScript(const String& fileName);
+	/// Зарегистрировать объекты кадра в Painter.
+	void RegisterObjects(float frameTime, const mat4x4& viewProjMatrix);
+
 	ptr<Geometry> cubeGeometry;
 
 	/// Скрипт.
@@ -152,13 +210,27 @@ public:
 	void Run();
 	void Tick();
 
+	/// Выполнить бенчмарк без окна и графического устройства.
+	/** Загружает сцену скриптом, выполняет ticksCount кадров с фиксированным
+	временем кадра, облетая сцену камерой, и пишет в output JSON со временами
+	этапов (среднее и перцентили, в миллисекундах). */
+	void RunBenchmark(const String& sceneFileName, int ticksCount, float frameTime, std::ostream& output);
+
 	//******* Методы, доступные из скрипта.
 
 	static ptr<Game> Get();
 
 	ptr<Texture> LoadTexture(const String& fileName);
 	ptr<Geometry> LoadGeometry(const String& fileName);
-	ptr<Geometry> LoadSkinnedGeometry(const String& fileName);
+	/// Загрузить skinned-модель.
+	/** Номера костей в вершинах переводятся в порядок костей скелета
+	(skeleton может быть nullptr, если кости в файле уже в этом порядке). */
+	ptr<Geometry> LoadSkinnedGeometry(const String& fileName, ptr<Skeleton> skeleton);
+	/// Добавить к геометрии более грубый уровень детализации.
+	/** Индексы уровня берутся из fileName.indices, вершины - общие с геометрией.
+	Уровень используется для экземпляров с размером на экране меньше maxScreenSize
+	(в долях высоты экрана); уровни добавляются по убыванию размера. */
+	void AddGeometryLod(ptr<Geometry> geometry, const String& fileName, float maxScreenSize);
 	ptr<Skeleton> LoadSkeleton(const String& fileName);
 	ptr<BoneAnimation> LoadBoneAnimation(const String& fileName, ptr<Skeleton> skeleton);
 	ptr<Physics::Shape> CreatePhysicsBoxShape(const vec3& halfSize);
@@ -168,11 +240,77 @@ public:
 	void AddStaticModel(ptr<Geometry> geometry, ptr<Material> material, const vec3& position);
 	void AddStaticModelWithScale(ptr<Geometry> geometry, ptr<Material> material, const vec3& position, const vec3& scale);
 	void AddRigidModel(ptr<Geometry> geometry, ptr<Material> material, ptr<Physics::RigidBody> physicsRigidBody);
+	/// Добавить skinned-модель с зацикленной анимацией.
+	/** Модель повёрнута на angle радиан вокруг вертикальной оси. Кадры анимации
+	всех моделей рассчитываются одним пакетом, с кэшем поз и уровнями детализации
+	анимации по размеру модели на экране. */
+	void AddSkinnedModel(ptr<Geometry> geometry, ptr<Material> material, ptr<BoneAnimation> animation, const vec3& position, float angle, float timeOffset);
 	void AddStaticRigidBody(ptr<Physics::RigidBody> rigidBody);
 	ptr<StaticLight> AddStaticLight();
 
 	void SetAmbient(const vec3& color);
 	void SetBackgroundTexture(ptr<Texture> texture);
+	void SetDepthPrePass(bool depthPrePass);
+	/// Включить CPU-скиннинг (один раз за кадр для всех проходов).
+	void SetPreSkinning(bool preSkinning);
+	/// Задать, на сколько уровней детализации геометрии грубее рисуются тени.
+	void SetShadowLodBias(int shadowLodBias);
+
+	/// Показывать статистику рисования поверх кадра.
+	void SetStatsOverlay(bool statsOverlay);
+	/// Получить количество проходов в статистике рисования.
+	int GetRenderPassesCount();
+	/// Получить имя прохода.
+	String GetRenderPassName(int pass);
+	/// Получить счётчик прохода за последний кадр.
+	/** Счётчики: drawCalls, instances, triangles, uniformUploads,
+	samplerBinds, pixelShaderSwitches. */
+	int GetRenderStat(int pass, const String& counterName);
+
+	/// Получить количество кадров, сохранённых профайлером.
+	int GetProfileFramesCount();
+	/// Получить длительность кадра в секундах (0 - последний кадр).
+	float GetProfileFrameTime(int frameAgo);
+	/// Получить время участка в кадре, в секундах.
+	float GetProfileScopeTime(const String& name, int frameAgo);
+	/// Получить среднее по сохранённым кадрам время участка.
+	float GetProfileAverageScopeTime(const String& name);
+	/// Записать сохранённые кадры в файл в формате Chrome trace.
+	void ExportProfile(const String& fileName);
+
+	/// Задать допустимую угловую ошибку сжатия для загружаемых далее анимаций.
+	/** В радианах; 0 - ключи не удаляются (только квантуются). */
+	void SetAnimationMaxError(float animationMaxError);
+	/// Задать частоту кадров, с которой пересэмплируются загружаемые далее анимации.
+	/** 0 - анимации выбираются по ключам. */
+	void SetAnimationResampleRate(float animationResampleRate);
+
+	/// Задать оптимизацию загружаемой далее геометрии.
+	/** Треугольники упорядочиваются для кэша вершин, вершины - по первому
+	использованию; при geometryOverdrawThreshold > 0 кластеры треугольников ещё и
+	переставляются против перерисовки с допустимым ухудшением ACMR в столько раз.
+	То же заранее делает с файлами утилита geoopt. */
+	void SetGeometryOptimization(bool geometryOptimization, float geometryOverdrawThreshold);
+	/// Получить средний ACMR геометрии, оптимизированной при загрузке.
+	/** optimized - после оптимизации или до неё (0, если ничего не оптимизировалось). */
+	float GetGeometryAcmr(bool optimized);
+
+	/// Задать шаг квантования времени в кэше поз, в секундах.
+	/** Модели с одной анимацией, время которых отличается меньше чем на шаг,
+	используют одну позу. */
+	void SetPoseCacheTimeStep(float timeStep);
+	/// Задать количество уровней детализации анимации.
+	void SetAnimationLodLevelsCount(int levelsCount);
+	/// Задать уровень детализации анимации.
+	/** Экземпляр с радиусом на экране (в долях высоты экрана) не меньше minScreenSize
+	обновляет позу раз в updatePeriod кадров, вычисляя boneLevelsCount уровней
+	иерархии костей (-1 - все). Уровни идут по убыванию размера. */
+	void SetAnimationLodLevel(int number, float minScreenSize, int updatePeriod, int boneLevelsCount);
+	/// Получить количество экземпляров уровня детализации анимации за последний кадр.
+	int GetAnimationLodInstancesCount(int level);
+
+	/// Задать траекторию камеры для бенчмарка.
+	void SetBenchmarkCamera(const vec3& center, float radius, float height, float speed);
 
 	void SetBansheeParams(
 		ptr<Geometry> mainGeometry,
@@ -1,7 +1,33 @@
 #include "Geometry.hpp"
+#include "GeometryFormats.hpp"
 
-Geometry::Geometry(ptr<VertexBuffer> vertexBuffer, ptr<IndexBuffer> indexBuffer)
-: vertexBuffer(vertexBuffer), indexBuffer(indexBuffer) {}
+Geometry::Lod::Lod(ptr<IndexBuffer> indexBuffer) : indexBuffer(indexBuffer), minScreenSize(0) {}
+
+IdPool Geometry::ids;
+
+Geometry::Geometry(ptr<VertexBuffer> vertexBuffer, ptr<IndexBuffer> indexBuffer, const BoundingBox& boundingBox, const BoundingSphere& boundingSphere, ptr<File> skinnedVertices)
+: vertexBuffer(vertexBuffer), boundingBox(boundingBox), boundingSphere(boundingSphere), skinnedVertices(skinnedVertices), skinnedBonesCount(0), id(ids.Allocate())
+{
+	lods.push_back(Lod(indexBuffer));
+
+	// наибольший номер кости, чтобы проверять соответствие кадру анимации
+	if(skinnedVertices)
+	{
+		const unsigned char* data = (const unsigned char*)skinnedVertices->GetData();
+		int verticesCount = (int)(skinnedVertices->GetSize() / GeometryFormats::skinnedVertexStride);
+		for(int i = 0; i < verticesCount; ++i)
+		{
+			const unsigned char* boneNumbers = data + i * GeometryFormats::skinnedVertexStride + GeometryFormats::skinnedBoneNumbersOffset;
+			for(int k = 0; k < 4; ++k)
+				skinnedBonesCount = std::max(skinnedBonesCount, boneNumbers[k] + 1);
+		}
+	}
+}
+
+Geometry::~Geometry()
+{
+	ids.Free(id);
+}
 
 ptr<VertexBuffer> Geometry::GetVertexBuffer() const
 {
@@ -10,5 +36,91 @@ ptr<VertexBuffer> Geometry::GetVertexBuffer() const
 
 ptr<IndexBuffer> Geometry::GetIndexBuffer() const
 {
-	return indexBuffer;
+	return lods[0].indexBuffer;
+}
+
+void Geometry::AddLod(ptr<IndexBuffer> indexBuffer, float maxScreenSize)
+{
+	if((int)lods.size() >= maxLodsCount)
+		THROW("Too many geometry LODs");
+	if(!(maxScreenSize > 0) || (lods.size() > 1 && maxScreenSize >= lods[lods.size() - 2].minScreenSize))
+		THROW("Geometry LODs should be added by decreasing screen size");
+	// порог принадлежит предыдущему уровню: он используется, пока экземпляр не меньше порога
+	lods.back().minScreenSize = maxScreenSize;
+	lods.push_back(Lod(indexBuffer));
+}
+
+int Geometry::GetLodsCount() const
+{
+	return (int)lods.size();
+}
+
+IndexBuffer* Geometry::GetLodIndexBuffer(int lod) const
+{
+	return lods[lod].indexBuffer;
+}
+
+int Geometry::SelectLod(float screenSize) const
+{
+	int lodsCount = (int)lods.size();
+	for(int i = 0; i < lodsCount - 1; ++i)
+		if(screenSize >= lods[i].minScreenSize)
+			return i;
+	return lodsCount - 1;
+}
+
+const BoundingBox& Geometry::GetBoundingBox() const
+{
+	return boundingBox;
+}
+
+const BoundingSphere& Geometry::GetBoundingSphere() const
+{
+	return boundingSphere;
+}
+
+ptr<File> Geometry::GetSkinnedVertices() const
+{
+	return skinnedVertices;
+}
+
+int Geometry::GetSkinnedBonesCount() const
+{
+	return skinnedBonesCount;
+}
+
+void Geometry::SetVertexRemap(const std::vector<uint32_t>& vertexRemap)
+{
+	this->vertexRemap = vertexRemap;
+}
+
+const std::vector<uint32_t>& Geometry::GetVertexRemap() const
+{
+	return vertexRemap;
+}
+
+int Geometry::GetIndexSize(int verticesCount)
+{
+	return verticesCount > 0x10000 ? sizeof(uint32_t) : sizeof(uint16_t);
+}
+
+void Geometry::CalculateBounds(ptr<File> verticesFile, int vertexStride, BoundingBox& boundingBox, BoundingSphere& boundingSphere)
+{
+	const char* data = (const char*)verticesFile->GetData();
+	int verticesCount = (int)(verticesFile->GetSize() / vertexStride);
+
+	// параллелепипед
+	boundingBox = BoundingBox();
+	for(int i = 0; i < verticesCount; ++i)
+		boundingBox.Add(*(const vec3*)(data + i * vertexStride));
+
+	// сфера с центром в центре параллелепипеда
+	vec3 center = boundingBox.GetCenter();
+	float radiusSquared = 0;
+	for(int i = 0; i < verticesCount; ++i)
+	{
+		vec3 d = *(const vec3*)(data + i * vertexStride) - center;
+		radiusSquared = std::max(radiusSquared, dot(d, d));
+	}
+	boundingSphere = BoundingSphere(center, sqrt(radiusSquared));
 }
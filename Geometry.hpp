@@ -2,19 +2,83 @@
 #define ___BANSHEE_GEOMETRY_HPP___
 
 #include "general.hpp"
+#include "Culling.hpp"
+#include "Registry.hpp"
 
+/// Геометрия модели.
+/** Вершинный буфер общий для всех уровней детализации, у каждого уровня
+свой индексный буфер. Уровень 0 - полный, следующие - всё грубее. */
 class Geometry : public Object
 {
+public:
+	/// Максимальное количество уровней детализации.
+	static const int maxLodsCount = 4;
+
 private:
 	ptr<VertexBuffer> vertexBuffer;
-	ptr<IndexBuffer> indexBuffer;
+	/// Уровень детализации.
+	struct Lod
+	{
+		ptr<IndexBuffer> indexBuffer;
+		/// Минимальный размер на экране (у последнего уровня - 0).
+		float minScreenSize;
+
+		Lod(ptr<IndexBuffer> indexBuffer);
+	};
+	std::vector<Lod> lods;
+	/// Ограничивающие объёмы в пространстве модели.
+	BoundingBox boundingBox;
+	BoundingSphere boundingSphere;
+	/// Вершины skinned-геометрии в памяти, для CPU-скиннинга.
+	ptr<File> skinnedVertices;
+	/// Количество костей, на которые ссылаются skinned-вершины (наибольший номер + 1).
+	int skinnedBonesCount;
+	/// Перестановка вершин, сделанная при оптимизации на загрузке (пустая, если не было).
+	std::vector<uint32_t> vertexRemap;
 
 public:
-	Geometry(ptr<VertexBuffer> vertexBuffer, ptr<IndexBuffer> indexBuffer);
+	/// Номер геометрии (для реестра и детерминированной сортировки).
+	const uint32_t id;
+	/// Номера геометрий.
+	static IdPool ids;
+
+	Geometry(ptr<VertexBuffer> vertexBuffer, ptr<IndexBuffer> indexBuffer, const BoundingBox& boundingBox, const BoundingSphere& boundingSphere, ptr<File> skinnedVertices = nullptr);
+	~Geometry();
 
 	ptr<VertexBuffer> GetVertexBuffer() const;
+	/// Получить индексный буфер полного уровня детализации.
 	ptr<IndexBuffer> GetIndexBuffer() const;
 
+	/// Добавить более грубый уровень детализации.
+	/** Уровень используется для экземпляров с размером на экране (радиус
+	ограничивающей сферы в проекции, в долях высоты экрана) меньше maxScreenSize.
+	Уровни добавляются по убыванию maxScreenSize. */
+	void AddLod(ptr<IndexBuffer> indexBuffer, float maxScreenSize);
+	int GetLodsCount() const;
+	IndexBuffer* GetLodIndexBuffer(int lod) const;
+	/// Выбрать уровень детализации по размеру на экране.
+	int SelectLod(float screenSize) const;
+
+	const BoundingBox& GetBoundingBox() const;
+	const BoundingSphere& GetBoundingSphere() const;
+	/// Получить вершины skinned-геометрии в памяти (или nullptr).
+	ptr<File> GetSkinnedVertices() const;
+	/// Получить количество костей, нужное skinned-вершинам.
+	/** Кадр анимации модели должен содержать не меньше костей. */
+	int GetSkinnedBonesCount() const;
+	/// Запомнить перестановку вершин, чтобы переводить индексы уровней детализации.
+	void SetVertexRemap(const std::vector<uint32_t>& vertexRemap);
+	/// Получить перестановку вершин: новый номер каждой вершины из файла (или пустую).
+	const std::vector<uint32_t>& GetVertexRemap() const;
+
+	/// Получить размер индекса для геометрии с данным количеством вершин.
+	/** Индексы 16-битные, если вершин не больше 65536, иначе 32-битные. */
+	static int GetIndexSize(int verticesCount);
+
+	/// Вычислить ограничивающие объёмы по вершинам.
+	/** Позиция вершины должна быть vec3 в начале вершины. */
+	static void CalculateBounds(ptr<File> verticesFile, int vertexStride, BoundingBox& boundingBox, BoundingSphere& boundingSphere);
+
 	META_DECLARE_CLASS(Geometry);
 };
 
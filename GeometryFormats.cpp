@@ -2,19 +2,36 @@
 
 GeometryFormats::GeometryFormats() :
 
-	vl(NEW(VertexLayout(32))),
+	vl(NEW(VertexLayout(vertexStride))),
+	vlePosition(vl->AddElement(DataTypes::_vec3, 0)),
+	vleNormal(vl->AddElement(DataTypes::_vec3, 12)),
+	vleTexcoord(vl->AddElement(DataTypes::_vec2, 24)),
 	al(NEW(AttributeLayout())),
 	als(al->AddSlot()),
-	alePosition(al->AddElement(als, vl->AddElement(DataTypes::_vec3, 0))),
-	aleNormal(al->AddElement(als, vl->AddElement(DataTypes::_vec3, 12))),
-	aleTexcoord(al->AddElement(als, vl->AddElement(DataTypes::_vec2, 24))),
+	alePosition(al->AddElement(als, vlePosition)),
+	aleNormal(al->AddElement(als, vleNormal)),
+	aleTexcoord(al->AddElement(als, vleTexcoord)),
 
-	vlSkinned(NEW(VertexLayout(52))),
+	alInstanced(NEW(AttributeLayout())),
+	alsInstancedVertex(alInstanced->AddSlot()),
+	aleInstancedPosition(alInstanced->AddElement(alsInstancedVertex, vlePosition)),
+	aleInstancedNormal(alInstanced->AddElement(alsInstancedVertex, vleNormal)),
+	aleInstancedTexcoord(alInstanced->AddElement(alsInstancedVertex, vleTexcoord)),
+	vlInstance(NEW(VertexLayout(instanceStride))),
+	alsInstance(alInstanced->AddSlot(1)),
+	aleInstanceWorld0(alInstanced->AddElement(alsInstance, vlInstance->AddElement(DataTypes::_vec4, 0))),
+	aleInstanceWorld1(alInstanced->AddElement(alsInstance, vlInstance->AddElement(DataTypes::_vec4, 16))),
+	aleInstanceWorld2(alInstanced->AddElement(alsInstance, vlInstance->AddElement(DataTypes::_vec4, 32))),
+
+	vlSkinned(NEW(VertexLayout(skinnedVertexStride))),
 	alSkinned(NEW(AttributeLayout())),
 	alsSkinned(alSkinned->AddSlot()),
 	aleSkinnedPosition(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_vec3, 0))),
 	aleSkinnedNormal(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_vec3, 12))),
 	aleSkinnedTexcoord(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_vec2, 24))),
-	aleSkinnedBoneNumbers(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_uvec4, LayoutDataTypes::Uint8, 32))),
-	aleSkinnedBoneWeights(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_vec4, 36)))
+	aleSkinnedBoneNumbers(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_uvec4, LayoutDataTypes::Uint8, skinnedBoneNumbersOffset))),
+	aleSkinnedBoneWeights(alSkinned->AddElement(alsSkinned, vlSkinned->AddElement(DataTypes::_vec4, skinnedBoneWeightsOffset))),
+	vlSkinnedInstance(NEW(VertexLayout(skinnedInstanceStride))),
+	alsSkinnedInstance(alSkinned->AddSlot(1)),
+	aleSkinnedPaletteOffset(alSkinned->AddElement(alsSkinnedInstance, vlSkinnedInstance->AddElement(DataTypes::_vec4, 0)))
 {}
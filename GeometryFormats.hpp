@@ -6,14 +6,44 @@
 class GeometryFormats : public Object
 {
 public:
+	/// Размер вершины обычной модели.
+	static const int vertexStride = 32;
+	/// Размер вершины skinned-модели.
+	static const int skinnedVertexStride = 52;
+	/// Смещение номеров костей (4 байта) в вершине skinned-модели.
+	static const int skinnedBoneNumbersOffset = 32;
+	/// Смещение весов костей (vec4) в вершине skinned-модели.
+	static const int skinnedBoneWeightsOffset = 36;
+	/// Размер данных экземпляра: три строки матрицы мира.
+	static const int instanceStride = 48;
+	/// Размер данных экземпляра skinned-модели: смещение в палитре костей.
+	static const int skinnedInstanceStride = 16;
+
 	//*** Обычные модели.
 	ptr<VertexLayout> vl;
+	/// Элементы вершины, общие для обычного и instanced-формата.
+	VertexLayout::Element vlePosition;
+	VertexLayout::Element vleNormal;
+	VertexLayout::Element vleTexcoord;
 	ptr<AttributeLayout> al;
 	ptr<AttributeLayoutSlot> als;
 	ptr<AttributeLayoutElement> alePosition;
 	ptr<AttributeLayoutElement> aleNormal;
 	ptr<AttributeLayoutElement> aleTexcoord;
+	//*** Instanced-модели.
+	/// Слот 0 - вершины в обычном формате, слот 1 - данные экземпляров.
+	ptr<AttributeLayout> alInstanced;
+	ptr<AttributeLayoutSlot> alsInstancedVertex;
+	ptr<AttributeLayoutElement> aleInstancedPosition;
+	ptr<AttributeLayoutElement> aleInstancedNormal;
+	ptr<AttributeLayoutElement> aleInstancedTexcoord;
+	ptr<VertexLayout> vlInstance;
+	ptr<AttributeLayoutSlot> alsInstance;
+	ptr<AttributeLayoutElement> aleInstanceWorld0;
+	ptr<AttributeLayoutElement> aleInstanceWorld1;
+	ptr<AttributeLayoutElement> aleInstanceWorld2;
 	//*** Skinned-модели.
+	/// Слот 0 - вершины skinned-формата, слот 1 - данные экземпляров.
 	ptr<VertexLayout> vlSkinned;
 	ptr<AttributeLayout> alSkinned;
 	ptr<AttributeLayoutSlot> alsSkinned;
@@ -22,6 +52,10 @@ public:
 	ptr<AttributeLayoutElement> aleSkinnedTexcoord;
 	ptr<AttributeLayoutElement> aleSkinnedBoneNumbers;
 	ptr<AttributeLayoutElement> aleSkinnedBoneWeights;
+	ptr<VertexLayout> vlSkinnedInstance;
+	ptr<AttributeLayoutSlot> alsSkinnedInstance;
+	/// Смещение кадра в палитре костей (в x).
+	ptr<AttributeLayoutElement> aleSkinnedPaletteOffset;
 
 	GeometryFormats();
 };
@@ -0,0 +1,256 @@
+#include "JobSystem.hpp"
+#include <algorithm>
+
+/// Номер текущего потока в планировщике.
+static thread_local int currentThreadNumber = 0;
+
+//*** JobSystem::Batch
+
+JobSystem::Batch::Batch(int count) : counter(count), exception(0) {}
+
+void JobSystem::Batch::SetException(Exception* exception)
+{
+	std::lock_guard<std::mutex> lock(exceptionMutex);
+	if(this->exception)
+		MakePointer(exception);
+	else
+		this->exception = exception;
+}
+
+void JobSystem::Batch::RethrowException()
+{
+	if(exception)
+	{
+		Exception* e = exception;
+		exception = 0;
+		THROW_SECONDARY("Job failed", e);
+	}
+}
+
+//*** JobSystem::TaskGraph
+
+int JobSystem::TaskGraph::Add(const Function& function)
+{
+	Node node;
+	node.function = function;
+	node.predecessorsCount = 0;
+	nodes.push_back(node);
+	return (int)nodes.size() - 1;
+}
+
+void JobSystem::TaskGraph::Depend(int task, int dependency)
+{
+	nodes[dependency].successors.push_back(task);
+	nodes[task].predecessorsCount++;
+}
+
+void JobSystem::TaskGraph::RunNode(JobSystem* jobSystem, Batch* batch, int nodeNumber)
+{
+	const Node& node = nodes[nodeNumber];
+	if(!skipped[nodeNumber])
+		try
+		{
+			node.function();
+		}
+		catch(Exception* exception)
+		{
+			batch->SetException(exception);
+			skipped[nodeNumber] = true;
+		}
+
+	// запустить задачи, у которых не осталось зависимостей; зависящие от
+	// пропущенной задачи тоже пропускаются, но запускаются, чтобы обнулить счётчик
+	bool skipSuccessors = skipped[nodeNumber];
+	for(size_t i = 0; i < node.successors.size(); ++i)
+	{
+		int successor = node.successors[i];
+		if(skipSuccessors)
+			skipped[successor] = true;
+		if(--remaining[successor] == 0)
+			jobSystem->Push(std::bind(&TaskGraph::RunNode, this, jobSystem, batch, successor), batch);
+	}
+}
+
+void JobSystem::TaskGraph::Run(JobSystem* jobSystem)
+{
+	int nodesCount = (int)nodes.size();
+	if(!nodesCount)
+		return;
+
+	remaining.reset(new std::atomic<int>[nodesCount]);
+	skipped.reset(new std::atomic<bool>[nodesCount]);
+	for(int i = 0; i < nodesCount; ++i)
+	{
+		remaining[i] = nodes[i].predecessorsCount;
+		skipped[i] = false;
+	}
+
+	Batch batch(nodesCount);
+	for(int i = 0; i < nodesCount; ++i)
+		if(!nodes[i].predecessorsCount)
+			jobSystem->Push(std::bind(&TaskGraph::RunNode, this, jobSystem, &batch, i), &batch);
+
+	jobSystem->Wait(batch);
+	batch.RethrowException();
+}
+
+void JobSystem::TaskGraph::Clear()
+{
+	nodes.clear();
+}
+
+//*** JobSystem
+
+JobSystem::JobSystem(int threadsCount) :
+	queuedJobsCount(0), stopping(false)
+{
+	if(threadsCount <= 0)
+		threadsCount = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	for(int i = 0; i < threadsCount; ++i)
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	currentThreadNumber = 0;
+	for(int i = 1; i < threadsCount; ++i)
+		threads.push_back(std::thread(&JobSystem::WorkerThread, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepCondition.notify_all();
+	for(size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+int JobSystem::GetThreadsCount() const
+{
+	return (int)queues.size();
+}
+
+void JobSystem::Push(const Function& function, Batch* batch)
+{
+	Job job;
+	job.function = function;
+	job.batch = batch;
+	{
+		Queue& queue = *queues[currentThreadNumber];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+	++queuedJobsCount;
+
+	// разбудить спящий поток
+	if(!threads.empty())
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepCondition.notify_one();
+	}
+}
+
+bool JobSystem::TryPop(int threadNumber, Job& job)
+{
+	// сначала своя очередь, с конца
+	{
+		Queue& queue = *queues[threadNumber];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.jobs.empty())
+		{
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+			--queuedJobsCount;
+			return true;
+		}
+	}
+
+	// затем чужие, с начала
+	int queuesCount = (int)queues.size();
+	for(int i = 1; i < queuesCount; ++i)
+	{
+		Queue& queue = *queues[(threadNumber + i) % queuesCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if(!queue.jobs.empty())
+		{
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+			--queuedJobsCount;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	try
+	{
+		job.function();
+	}
+	catch(Exception* exception)
+	{
+		job.batch->SetException(exception);
+	}
+	--job.batch->counter;
+}
+
+bool JobSystem::TryRunOne()
+{
+	Job job;
+	if(!TryPop(currentThreadNumber, job))
+		return false;
+	Execute(job);
+	return true;
+}
+
+void JobSystem::Wait(Batch& batch)
+{
+	while(batch.counter > 0)
+		if(!TryRunOne())
+			std::this_thread::yield();
+}
+
+void JobSystem::WorkerThread(int threadNumber)
+{
+	currentThreadNumber = threadNumber;
+
+	for(;;)
+	{
+		if(TryRunOne())
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this]() { return stopping || queuedJobsCount > 0; });
+		if(stopping)
+			return;
+	}
+}
+
+int JobSystem::GetChunksCount(int count, int grainSize)
+{
+	return (count + grainSize - 1) / grainSize;
+}
+
+void JobSystem::ParallelFor(int count, int grainSize, const RangeFunction& function)
+{
+	int chunksCount = GetChunksCount(count, grainSize);
+	if(chunksCount <= 0)
+		return;
+
+	// один кусок нет смысла отдавать в очередь
+	if(chunksCount == 1 || queues.size() == 1)
+	{
+		for(int i = 0; i < count; i += grainSize)
+			function(i, std::min(i + grainSize, count));
+		return;
+	}
+
+	Batch batch(chunksCount);
+	for(int i = 0; i < count; i += grainSize)
+		Push(std::bind(function, i, std::min(i + grainSize, count)), &batch);
+
+	Wait(batch);
+	batch.RethrowException();
+}
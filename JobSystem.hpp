@@ -0,0 +1,127 @@
+#ifndef ___BANSHEE_JOB_SYSTEM_HPP___
+#define ___BANSHEE_JOB_SYSTEM_HPP___
+
+#include "general.hpp"
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <memory>
+
+/// Планировщик задач с перехватом работы (work stealing).
+/** У каждого потока своя очередь: владелец берёт задачи с конца,
+остальные потоки воруют с начала. Поток, ожидающий завершения задач,
+сам выполняет задачи, поэтому ожидание можно вызывать и изнутри задачи.
+Поток, создавший планировщик, считается потоком номер 0.
+Задачи не должны копировать ptr<>: счётчики ссылок не атомарные. */
+class JobSystem : public Object
+{
+public:
+	typedef std::function<void()> Function;
+	/// Функция обработки диапазона [begin, end).
+	typedef std::function<void(int, int)> RangeFunction;
+
+private:
+	/// Группа задач, которую ожидают вместе.
+	/** У каждой группы своё исключение, так что ожидание группы не
+	перевыбрасывает исключения задач из чужих групп. */
+	struct Batch
+	{
+		/// Количество невыполненных задач.
+		std::atomic<int> counter;
+		/// Первое исключение, выброшенное задачей группы.
+		Exception* exception;
+		std::mutex exceptionMutex;
+
+		Batch(int count);
+		/// Запомнить исключение (если уже есть, новое освобождается).
+		void SetException(Exception* exception);
+		/// Перевыбросить исключение, если было.
+		void RethrowException();
+	};
+
+public:
+	/// Граф задач с зависимостями.
+	/** Строится однопоточно, затем выполняется целиком методом Run.
+	Если задача выбросила исключение, зависящие от неё задачи пропускаются,
+	остальные выполняются, а исключение перевыбрасывается из Run. */
+	class TaskGraph
+	{
+	private:
+		struct Node
+		{
+			Function function;
+			/// Задачи, ожидающие этой.
+			std::vector<int> successors;
+			int predecessorsCount;
+		};
+		std::vector<Node> nodes;
+		/// Количество невыполненных зависимостей на время выполнения.
+		std::unique_ptr<std::atomic<int>[]> remaining;
+		/// Пропускаются ли задачи (из-за исключения в задаче, от которой они зависят).
+		std::unique_ptr<std::atomic<bool>[]> skipped;
+
+		void RunNode(JobSystem* jobSystem, Batch* batch, int nodeNumber);
+
+	public:
+		/// Добавить задачу, получить её номер.
+		int Add(const Function& function);
+		/// Указать, что задача task выполняется после задачи dependency.
+		void Depend(int task, int dependency);
+		/// Выполнить все задачи и дождаться завершения.
+		void Run(JobSystem* jobSystem);
+		/// Очистить граф.
+		void Clear();
+	};
+
+private:
+	struct Job
+	{
+		Function function;
+		/// Группа, счётчик которой уменьшается после выполнения.
+		Batch* batch;
+	};
+	/// Очередь потока.
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+	std::vector<std::unique_ptr<Queue> > queues;
+	std::vector<std::thread> threads;
+
+	/// Количество задач во всех очередях.
+	std::atomic<int> queuedJobsCount;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stopping;
+
+	void Push(const Function& function, Batch* batch);
+	bool TryPop(int threadNumber, Job& job);
+	void Execute(Job& job);
+	/// Выполнить одну задачу, если есть.
+	bool TryRunOne();
+	/// Выполнять задачи, пока не выполнится вся группа.
+	void Wait(Batch& batch);
+	void WorkerThread(int threadNumber);
+
+public:
+	/// Создать планировщик.
+	/** \param threadsCount Общее количество потоков, включая текущий;
+	0 - по количеству ядер. При 1 все задачи выполняются в ожидающем потоке. */
+	JobSystem(int threadsCount = 0);
+	~JobSystem();
+
+	int GetThreadsCount() const;
+
+	/// Выполнить функцию над диапазоном [0, count) кусками по grainSize.
+	/** Разбиение на куски не зависит от количества потоков, поэтому
+	результаты, сложенные по номерам кусков, детерминированы. */
+	void ParallelFor(int count, int grainSize, const RangeFunction& function);
+	/// Количество кусков, на которые ParallelFor разобьёт диапазон.
+	static int GetChunksCount(int count, int grainSize);
+};
+
+#endif
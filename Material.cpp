@@ -17,8 +17,15 @@ bool operator==(const MaterialKey& a, const MaterialKey& b)
 
 //*** Material
 
+IdPool Material::ids;
+
 Material::Material()
-: diffuse(1, 1, 1, 1), specular(1, 1, 1, 1), normalCoordTransform(1, 1, 0, 0) {}
+: id(ids.Allocate()), diffuse(1, 1, 1, 1), specular(1, 1, 1, 1), normalCoordTransform(1, 1, 0, 0), environmentCoef(0), castsShadow(true), dirty(true) {}
+
+Material::~Material()
+{
+	ids.Free(id);
+}
 
 MaterialKey Material::GetKey() const
 {
@@ -43,19 +50,27 @@ void Material::SetNormalTexture(ptr<Texture> normalTexture)
 void Material::SetDiffuse(const vec4& diffuse)
 {
 	this->diffuse = diffuse;
+	dirty = true;
 }
 
 void Material::SetSpecular(const vec4& specular)
 {
 	this->specular = specular;
+	dirty = true;
 }
 
 void Material::SetNormalCoordTransform(const vec4& normalCoordTransform)
 {
 	this->normalCoordTransform = normalCoordTransform;
+	dirty = true;
 }
 
 void Material::SetEnvironmentCoef(float environmentCoef)
 {
 	this->environmentCoef = environmentCoef;
 }
+
+void Material::SetCastsShadow(bool castsShadow)
+{
+	this->castsShadow = castsShadow;
+}
@@ -2,6 +2,7 @@
 #define ___BANSHEE_MATERIAL_HPP___
 
 #include "general.hpp"
+#include "Registry.hpp"
 
 /// Структура ключа материала.
 struct MaterialKey
@@ -19,6 +20,8 @@ struct MaterialKey
 /// Структура материала.
 struct Material : public Object
 {
+	/// Номер материала (для реестра и детерминированной сортировки).
+	const uint32_t id;
 	ptr<Texture> diffuseTexture;
 	ptr<Texture> specularTexture;
 	ptr<Texture> normalTexture;
@@ -27,8 +30,20 @@ struct Material : public Object
 	vec4 normalCoordTransform;
 	/// Коэффициент примешивания окружения к цвету.
 	float environmentCoef;
+	/// Отбрасывают ли модели с этим материалом тень.
+	bool castsShadow;
+
+	/// Собственный uniform-буфер материала.
+	/** Создаётся и заливается Painter'ом при первом использовании. */
+	ptr<UniformBuffer> uniformBuffer;
+	/// Изменились ли параметры с момента последней заливки буфера.
+	bool dirty;
 
 	Material();
+	~Material();
+
+	/// Номера материалов.
+	static IdPool ids;
 
 	MaterialKey GetKey() const;
 
@@ -40,6 +55,7 @@ struct Material : public Object
 	void SetSpecular(const vec4& specular);
 	void SetNormalCoordTransform(const vec4& normalCoordTransform);
 	void SetEnvironmentCoef(float environmentCoef);
+	void SetCastsShadow(bool castsShadow);
 
 	META_DECLARE_CLASS(Material);
 };
@@ -0,0 +1,441 @@
+#include "MeshOptimization.hpp"
+#include "Geometry.hpp"
+
+//*** ACMR
+
+/// Модель FIFO-кэша вершин.
+/** Вершина в кэше, если с момента её попадания в кэш было меньше cacheSize промахов. */
+class FifoCache
+{
+private:
+	std::vector<int> timestamps;
+	int cacheSize;
+	int time;
+
+public:
+	FifoCache(int verticesCount, int cacheSize)
+	: timestamps(verticesCount, 0), cacheSize(cacheSize), time(cacheSize + 1) {}
+
+	/// Обратиться к вершине; возвращает true при промахе.
+	bool Access(uint32_t vertex)
+	{
+		if(time - timestamps[vertex] <= cacheSize)
+			return false;
+		timestamps[vertex] = time++;
+		return true;
+	}
+
+	/// Очистить кэш.
+	void Reset()
+	{
+		time += cacheSize + 1;
+	}
+};
+
+float CalculateAcmr(const uint32_t* indices, int indicesCount, int verticesCount, int cacheSize)
+{
+	if(indicesCount < 3)
+		return 0;
+
+	FifoCache cache(verticesCount, cacheSize);
+	int missesCount = 0;
+	for(int i = 0; i < indicesCount; ++i)
+		missesCount += cache.Access(indices[i]);
+
+	return (float)missesCount / (indicesCount / 3);
+}
+
+//*** Кэш вершин
+
+/// Размер LRU-кэша, которым оцениваются вершины.
+static const int forsythCacheSize = 32;
+static const float forsythCacheDecayPower = 1.5f;
+static const float forsythLastTriangleScore = 0.75f;
+static const float forsythValenceBoostScale = 2.0f;
+static const float forsythValenceBoostPower = 0.5f;
+
+/// Оценка вершины по позиции в кэше (-1 - не в кэше) и количеству оставшихся треугольников.
+static float GetVertexScore(int cachePosition, int remainingValence)
+{
+	// вершина больше не нужна
+	if(remainingValence <= 0)
+		return -1;
+
+	float score = 0;
+	if(cachePosition >= 0)
+	{
+		// вершины последнего треугольника оцениваются одинаково, чтобы не
+		// зависеть от порядка вершин в нём
+		if(cachePosition < 3)
+			score = forsythLastTriangleScore;
+		else
+			score = pow(1 - (float)(cachePosition - 3) / (forsythCacheSize - 3), forsythCacheDecayPower);
+	}
+
+	// вершины с немногими оставшимися треугольниками стоит закончить поскорее
+	score += forsythValenceBoostScale * pow((float)remainingValence, -forsythValenceBoostPower);
+
+	return score;
+}
+
+void OptimizeVertexCache(uint32_t* indices, int indicesCount, int verticesCount)
+{
+	int trianglesCount = indicesCount / 3;
+	if(trianglesCount <= 1)
+		return;
+
+	// треугольники вершин; у каждой вершины в начале её списка лежат
+	// оставшиеся треугольники, их количество - remainingValences
+	std::vector<int> remainingValences(verticesCount, 0);
+	for(int i = 0; i < trianglesCount * 3; ++i)
+		++remainingValences[indices[i]];
+	std::vector<int> adjacencyStarts(verticesCount + 1);
+	adjacencyStarts[0] = 0;
+	for(int i = 0; i < verticesCount; ++i)
+		adjacencyStarts[i + 1] = adjacencyStarts[i] + remainingValences[i];
+	std::vector<int> adjacency(trianglesCount * 3);
+	{
+		std::vector<int> adjacencyEnds(adjacencyStarts.begin(), adjacencyStarts.end() - 1);
+		for(int i = 0; i < trianglesCount * 3; ++i)
+			adjacency[adjacencyEnds[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cachePositions(verticesCount, -1);
+	std::vector<float> vertexScores(verticesCount);
+	for(int i = 0; i < verticesCount; ++i)
+		vertexScores[i] = GetVertexScore(-1, remainingValences[i]);
+
+	std::vector<float> triangleScores(trianglesCount);
+	int bestTriangle = 0;
+	for(int i = 0; i < trianglesCount; ++i)
+	{
+		triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		if(triangleScores[i] > triangleScores[bestTriangle])
+			bestTriangle = i;
+	}
+
+	std::vector<char> emitted(trianglesCount, 0);
+	std::vector<uint32_t> result(trianglesCount * 3);
+	int emittedCount = 0;
+	// номер, с которого ищется следующий треугольник, когда в кэше не осталось кандидатов
+	int scanCursor = 0;
+
+	// кэш на 3 вершины больше, чтобы учесть вытесняемые вершины
+	uint32_t cache[forsythCacheSize + 3];
+	uint32_t newCache[forsythCacheSize + 3];
+	int cacheCount = 0;
+
+	while(bestTriangle >= 0)
+	{
+		const uint32_t* triangle = indices + bestTriangle * 3;
+		emitted[bestTriangle] = 1;
+		for(int k = 0; k < 3; ++k)
+			result[emittedCount * 3 + k] = triangle[k];
+		++emittedCount;
+
+		// убрать треугольник из оставшихся у его вершин
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t vertex = triangle[k];
+			int* vertexTriangles = &adjacency[adjacencyStarts[vertex]];
+			int& valence = remainingValences[vertex];
+			for(int j = 0; j < valence; ++j)
+				if(vertexTriangles[j] == bestTriangle)
+				{
+					std::swap(vertexTriangles[j], vertexTriangles[valence - 1]);
+					--valence;
+					break;
+				}
+		}
+
+		// вершины треугольника - в начало кэша
+		int newCacheCount = 0;
+		for(int k = 0; k < 3; ++k)
+			newCache[newCacheCount++] = triangle[k];
+		for(int j = 0; j < cacheCount; ++j)
+		{
+			uint32_t vertex = cache[j];
+			if(vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+				newCache[newCacheCount++] = vertex;
+		}
+
+		// переоценить вершины кэша (и вытесненные) и их треугольники
+		for(int j = 0; j < newCacheCount; ++j)
+		{
+			uint32_t vertex = newCache[j];
+			cachePositions[vertex] = j < forsythCacheSize ? j : -1;
+			float score = GetVertexScore(cachePositions[vertex], remainingValences[vertex]);
+			float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+			const int* vertexTriangles = &adjacency[adjacencyStarts[vertex]];
+			for(int i = 0; i < remainingValences[vertex]; ++i)
+				triangleScores[vertexTriangles[i]] += delta;
+		}
+
+		// лучший треугольник ищется среди треугольников вершин кэша
+		bestTriangle = -1;
+		float bestScore = -1;
+		cacheCount = std::min(newCacheCount, forsythCacheSize);
+		for(int j = 0; j < cacheCount; ++j)
+		{
+			uint32_t vertex = newCache[j];
+			cache[j] = vertex;
+			const int* vertexTriangles = &adjacency[adjacencyStarts[vertex]];
+			for(int i = 0; i < remainingValences[vertex]; ++i)
+				if(triangleScores[vertexTriangles[i]] > bestScore)
+				{
+					bestTriangle = vertexTriangles[i];
+					bestScore = triangleScores[bestTriangle];
+				}
+		}
+
+		// кандидатов нет - берём следующий невыданный треугольник
+		if(bestTriangle < 0 && emittedCount < trianglesCount)
+		{
+			while(emitted[scanCursor])
+				++scanCursor;
+			bestTriangle = scanCursor;
+		}
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+//*** Перерисовка
+
+void OptimizeOverdraw(uint32_t* indices, int indicesCount, const void* vertices, int vertexStride, int verticesCount, float threshold)
+{
+	int trianglesCount = indicesCount / 3;
+	if(trianglesCount <= 1)
+		return;
+
+	// жёсткие границы кластеров - там, где кэш начинается заново
+	// (все три вершины треугольника - промахи)
+	std::vector<int> hardStarts;
+	int meshMissesCount = 0;
+	{
+		FifoCache cache(verticesCount, acmrCacheSize);
+		for(int i = 0; i < trianglesCount; ++i)
+		{
+			int missesCount = cache.Access(indices[i * 3]) + cache.Access(indices[i * 3 + 1]) + cache.Access(indices[i * 3 + 2]);
+			if(missesCount == 3 || i == 0)
+				hardStarts.push_back(i);
+			meshMissesCount += missesCount;
+		}
+		hardStarts.push_back(trianglesCount);
+	}
+	float maxAcmr = threshold * meshMissesCount / trianglesCount;
+
+	// мягкие границы: кластер режется, как только его собственный ACMR
+	// (с пустого кэша) укладывается в допустимый
+	std::vector<int> clusterStarts;
+	{
+		FifoCache cache(verticesCount, acmrCacheSize);
+		for(size_t h = 0; h + 1 < hardStarts.size(); ++h)
+		{
+			int end = hardStarts[h + 1];
+			int clusterStart = hardStarts[h];
+			int clusterMissesCount = 0;
+			clusterStarts.push_back(clusterStart);
+			cache.Reset();
+			for(int i = clusterStart; i < end; ++i)
+			{
+				clusterMissesCount += cache.Access(indices[i * 3]) + cache.Access(indices[i * 3 + 1]) + cache.Access(indices[i * 3 + 2]);
+				if(i + 1 < end && clusterMissesCount <= maxAcmr * (i + 1 - clusterStart))
+				{
+					clusterStart = i + 1;
+					clusterMissesCount = 0;
+					clusterStarts.push_back(clusterStart);
+					cache.Reset();
+				}
+			}
+			// хвост, не уложившийся в допустимый ACMR, остаётся с предыдущим
+			// кластером, где кэш уже заполнен
+			if(clusterStart > hardStarts[h] && clusterMissesCount > maxAcmr * (end - clusterStart))
+				clusterStarts.pop_back();
+		}
+	}
+	int clustersCount = (int)clusterStarts.size();
+	clusterStarts.push_back(trianglesCount);
+
+	// центры и нормали кластеров (с весами по площади)
+	const char* data = (const char*)vertices;
+	auto getPosition = [&](uint32_t vertex) -> const vec3&
+	{
+		return *(const vec3*)(data + vertex * vertexStride);
+	};
+	std::vector<vec3> clusterCenters(clustersCount);
+	std::vector<vec3> clusterNormals(clustersCount);
+	vec3 meshCenter(0, 0, 0);
+	float meshArea = 0;
+	for(int c = 0; c < clustersCount; ++c)
+	{
+		vec3 center(0, 0, 0);
+		vec3 normal(0, 0, 0);
+		float area = 0;
+		for(int i = clusterStarts[c]; i < clusterStarts[c + 1]; ++i)
+		{
+			const vec3& a = getPosition(indices[i * 3]);
+			const vec3& b = getPosition(indices[i * 3 + 1]);
+			const vec3& d = getPosition(indices[i * 3 + 2]);
+			// удвоенная площадь, умноженная на нормаль
+			vec3 n = cross(b - a, d - a);
+			float triangleArea = sqrt(dot(n, n));
+			center += (a + b + d) * (triangleArea / 3);
+			normal += n;
+			area += triangleArea;
+		}
+		meshCenter += center;
+		meshArea += area;
+		clusterCenters[c] = area > 0 ? center * (1 / area) : getPosition(indices[clusterStarts[c] * 3]);
+		clusterNormals[c] = normal;
+	}
+	if(meshArea > 0)
+		meshCenter = meshCenter * (1 / meshArea);
+
+	// раньше рисуются кластеры, обращённые от центра наружу: они чаще
+	// закрывают остальные
+	std::vector<float> clusterKeys(clustersCount);
+	std::vector<int> clusterOrder(clustersCount);
+	for(int c = 0; c < clustersCount; ++c)
+	{
+		float normalLength = sqrt(dot(clusterNormals[c], clusterNormals[c]));
+		clusterKeys[c] = normalLength > 0 ? dot(clusterCenters[c] - meshCenter, clusterNormals[c]) / normalLength : 0;
+		clusterOrder[c] = c;
+	}
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](int a, int b)
+	{
+		return clusterKeys[a] > clusterKeys[b];
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(trianglesCount * 3);
+	for(int c = 0; c < clustersCount; ++c)
+	{
+		int cluster = clusterOrder[c];
+		result.insert(result.end(), indices + clusterStarts[cluster] * 3, indices + clusterStarts[cluster + 1] * 3);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+//*** Выборка вершин
+
+void OptimizeVertexFetch(void* vertices, int vertexStride, int verticesCount, uint32_t* indices, int indicesCount, std::vector<uint32_t>& remap)
+{
+	const uint32_t unused = 0xFFFFFFFF;
+	remap.assign(verticesCount, unused);
+	uint32_t nextVertex = 0;
+	for(int i = 0; i < indicesCount; ++i)
+	{
+		uint32_t& newVertex = remap[indices[i]];
+		if(newVertex == unused)
+			newVertex = nextVertex++;
+		indices[i] = newVertex;
+	}
+	for(int i = 0; i < verticesCount; ++i)
+		if(remap[i] == unused)
+			remap[i] = nextVertex++;
+
+	std::vector<char> source((const char*)vertices, (const char*)vertices + verticesCount * vertexStride);
+	for(int i = 0; i < verticesCount; ++i)
+		memcpy((char*)vertices + remap[i] * vertexStride, &source[i * vertexStride], vertexStride);
+}
+
+//*** Файлы
+
+void ReadIndices(ptr<File> file, int verticesCount, std::vector<uint32_t>& indices)
+{
+	int indexSize = Geometry::GetIndexSize(verticesCount);
+	int indicesCount = (int)(file->GetSize() / indexSize);
+	indices.resize(indicesCount);
+	if(indexSize == sizeof(uint32_t))
+		memcpy(indices.data(), file->GetData(), indicesCount * sizeof(uint32_t));
+	else
+	{
+		const uint16_t* data = (const uint16_t*)file->GetData();
+		for(int i = 0; i < indicesCount; ++i)
+			indices[i] = data[i];
+	}
+
+	for(int i = 0; i < indicesCount; ++i)
+		if(indices[i] >= (uint32_t)verticesCount)
+			THROW("Geometry index is out of range");
+}
+
+ptr<File> WriteIndices(const std::vector<uint32_t>& indices, int verticesCount)
+{
+	int indexSize = Geometry::GetIndexSize(verticesCount);
+	ptr<File> file = NEW(MemoryFile(indices.size() * indexSize));
+	if(indexSize == sizeof(uint32_t))
+		memcpy(file->GetData(), indices.data(), indices.size() * sizeof(uint32_t));
+	else
+	{
+		uint16_t* data = (uint16_t*)file->GetData();
+		for(size_t i = 0; i < indices.size(); ++i)
+			data[i] = (uint16_t)indices[i];
+	}
+	return file;
+}
+
+MeshOptimizationStats::MeshOptimizationStats()
+: trianglesCount(0), acmrBefore(0), acmrAfter(0) {}
+
+MeshOptimizationStats OptimizeGeometry(ptr<File>& verticesFile, ptr<File>& indicesFile, int vertexStride, float overdrawThreshold, std::vector<uint32_t>& remap)
+{
+	try
+	{
+		int verticesCount = (int)(verticesFile->GetSize() / vertexStride);
+		std::vector<uint32_t> indices;
+		ReadIndices(indicesFile, verticesCount, indices);
+		int indicesCount = (int)indices.size();
+
+		MeshOptimizationStats stats;
+		stats.trianglesCount = indicesCount / 3;
+		stats.acmrBefore = CalculateAcmr(indices.data(), indicesCount, verticesCount);
+
+		ptr<File> vertices = MemoryFile::CreateViaCopy(verticesFile->GetData(), verticesCount * vertexStride);
+
+		OptimizeVertexCache(indices.data(), indicesCount, verticesCount);
+		if(overdrawThreshold > 0)
+			OptimizeOverdraw(indices.data(), indicesCount, vertices->GetData(), vertexStride, verticesCount, overdrawThreshold);
+		stats.acmrAfter = CalculateAcmr(indices.data(), indicesCount, verticesCount);
+		// перестановка вершин не меняет ACMR
+		OptimizeVertexFetch(vertices->GetData(), vertexStride, verticesCount, indices.data(), indicesCount, remap);
+
+		verticesFile = vertices;
+		indicesFile = WriteIndices(indices, verticesCount);
+
+		return stats;
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't optimize geometry", exception);
+	}
+}
+
+MeshOptimizationStats OptimizeLodIndices(ptr<File>& indicesFile, const std::vector<uint32_t>& remap)
+{
+	try
+	{
+		int verticesCount = (int)remap.size();
+		std::vector<uint32_t> indices;
+		ReadIndices(indicesFile, verticesCount, indices);
+		int indicesCount = (int)indices.size();
+
+		MeshOptimizationStats stats;
+		stats.trianglesCount = indicesCount / 3;
+		for(int i = 0; i < indicesCount; ++i)
+			indices[i] = remap[indices[i]];
+		stats.acmrBefore = CalculateAcmr(indices.data(), indicesCount, verticesCount);
+		OptimizeVertexCache(indices.data(), indicesCount, verticesCount);
+		stats.acmrAfter = CalculateAcmr(indices.data(), indicesCount, verticesCount);
+
+		indicesFile = WriteIndices(indices, verticesCount);
+
+		return stats;
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't optimize geometry LOD indices", exception);
+	}
+}
@@ -0,0 +1,61 @@
+#ifndef ___BANSHEE_MESH_OPTIMIZATION_HPP___
+#define ___BANSHEE_MESH_OPTIMIZATION_HPP___
+
+#include "general.hpp"
+
+/*
+Оптимизация порядка треугольников и вершин геометрии.
+Треугольники упорядочиваются для кэша преобразованных вершин (алгоритм
+Форсайта: жадно выбирается треугольник с наибольшей оценкой вершин по
+положению в модели LRU-кэша и количеству оставшихся треугольников).
+Затем, по желанию, кластеры треугольников переставляются для уменьшения
+перерисовки: обращённые наружу кластеры рисуются раньше; кластеры режутся
+там, где это почти не ухудшает попадания в кэш. Вершины в конце
+переставляются в порядке первого использования, чтобы выборка вершин шла
+подряд по памяти. Порядок обхода вершин в треугольниках сохраняется.
+Качество оценивается ACMR - средним количеством промахов FIFO-кэша вершин
+на треугольник (от 0.5 в идеале до 3).
+*/
+
+/// Размер FIFO-кэша вершин, которым оценивается ACMR.
+const int acmrCacheSize = 16;
+
+/// Получить ACMR индексов.
+float CalculateAcmr(const uint32_t* indices, int indicesCount, int verticesCount, int cacheSize = acmrCacheSize);
+/// Упорядочить треугольники для кэша вершин.
+void OptimizeVertexCache(uint32_t* indices, int indicesCount, int verticesCount);
+/// Переставить кластеры треугольников для уменьшения перерисовки.
+/** Треугольники должны быть уже упорядочены для кэша. threshold - допустимое
+ухудшение ACMR (например, 1.05); позиция - vec3 в начале вершины. */
+void OptimizeOverdraw(uint32_t* indices, int indicesCount, const void* vertices, int vertexStride, int verticesCount, float threshold);
+/// Переставить вершины в порядке первого использования и перенумеровать индексы.
+/** Неиспользуемые вершины идут в конце в прежнем порядке. В remap
+записывается новый номер каждой старой вершины. */
+void OptimizeVertexFetch(void* vertices, int vertexStride, int verticesCount, uint32_t* indices, int indicesCount, std::vector<uint32_t>& remap);
+
+/// Прочитать индексы из файла.
+/** Размер индекса выбирается по количеству вершин, как при загрузке геометрии. */
+void ReadIndices(ptr<File> file, int verticesCount, std::vector<uint32_t>& indices);
+/// Записать индексы в файл.
+ptr<File> WriteIndices(const std::vector<uint32_t>& indices, int verticesCount);
+
+/// Результат оптимизации геометрии.
+struct MeshOptimizationStats
+{
+	int trianglesCount;
+	float acmrBefore;
+	float acmrAfter;
+
+	MeshOptimizationStats();
+};
+
+/// Оптимизировать геометрию в файлах.
+/** Файлы заменяются новыми. overdrawThreshold - допустимое ухудшение ACMR
+при оптимизации перерисовки (0 - не оптимизировать перерисовку). В remap
+записывается перестановка вершин для индексов уровней детализации. */
+MeshOptimizationStats OptimizeGeometry(ptr<File>& verticesFile, ptr<File>& indicesFile, int vertexStride, float overdrawThreshold, std::vector<uint32_t>& remap);
+/// Оптимизировать индексы уровня детализации оптимизированной геометрии.
+/** Индексы переводятся перестановкой remap и упорядочиваются для кэша. */
+MeshOptimizationStats OptimizeLodIndices(ptr<File>& indicesFile, const std::vector<uint32_t>& remap);
+
+#endif
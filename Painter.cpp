@@ -1,6 +1,12 @@
 #include "Painter.hpp"
 #include "BoneAnimation.hpp"
 #include "GeometryFormats.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "Skinning.hpp"
+#include <limits>
+#include <new>
+#include <utility>
 
 const int Painter::shadowMapSize = 1024;
 const int Painter::downsamplingStepForBloom = 1;
@@ -85,12 +91,17 @@ bool operator==(const Painter::PixelShaderKey& a, const Painter::PixelShaderKey&
 
 //*** Painter::Model
 
-Painter::Model::Model(ptr<Material> material, ptr<Geometry> geometry, const mat4x4& worldTransform)
+Painter::Model::Model(MaterialHandle material, GeometryHandle geometry, const mat4x4& worldTransform)
 : material(material), geometry(geometry), worldTransform(worldTransform) {}
 
+//*** Painter::StaticBatch
+
+Painter::StaticBatch::StaticBatch(MaterialHandle material, GeometryHandle geometry, int first)
+: material(material), geometry(geometry), first(first), count(0) {}
+
 //*** Painter::SkinnedModel
 
-Painter::SkinnedModel::SkinnedModel(ptr<Material> material, ptr<Geometry> geometry, ptr<Geometry> shadowGeometry, ptr<BoneAnimationFrame> animationFrame)
+Painter::SkinnedModel::SkinnedModel(MaterialHandle material, GeometryHandle geometry, GeometryHandle shadowGeometry, BoneAnimationFrame* animationFrame)
 : material(material), geometry(geometry), shadowGeometry(shadowGeometry), animationFrame(animationFrame) {}
 
 //*** Painter::Light
@@ -101,9 +112,61 @@ Painter::Light::Light(const vec3& position, const vec3& color)
 Painter::Light::Light(const vec3& position, const vec3& color, const mat4x4& transform)
 : position(position), color(color), transform(transform), shadow(true) {}
 
+//*** Painter::PreSkinnedBuffer
+
+Painter::PreSkinnedBuffer::PreSkinnedBuffer() : capacity(0) {}
+
+//*** Painter::MaterialBinder
+
+Painter::MaterialBinder::MaterialBinder(Painter* painter) :
+	painter(painter), boundMaterial(nullptr),
+	boundDiffuseTexture(nullptr), boundSpecularTexture(nullptr), boundNormalTexture(nullptr) {}
+
+/// Переустановить привязку на месте.
+/** Старая привязка снимается (восстанавливая прежнее состояние контекста)
+до установки новой, так что восстановление идёт в обратном порядке. */
+template <typename Let, typename... Args>
+static void Rebind(Let& let, Args&&... args)
+{
+	let.~Let();
+	new (&let) Let(std::forward<Args>(args)...);
+}
+
+void Painter::MaterialBinder::Bind(Material* material)
+{
+	if(material == boundMaterial)
+		return;
+	// при первой установке привязываются все текстуры
+	bool first = !boundMaterial;
+	boundMaterial = material;
+
+	Context* context = painter->context;
+
+	Rebind(lubMaterial, context, painter->ugMaterial->GetSlot(), painter->GetMaterialUniformBuffer(material));
+
+	if(first || boundDiffuseTexture != material->diffuseTexture)
+	{
+		boundDiffuseTexture = material->diffuseTexture;
+		Rebind(lsDiffuse, context, painter->uDiffuseSampler, boundDiffuseTexture, painter->ssColorTexture);
+		painter->CountSamplerBinds(1);
+	}
+	if(first || boundSpecularTexture != material->specularTexture)
+	{
+		boundSpecularTexture = material->specularTexture;
+		Rebind(lsSpecular, context, painter->uSpecularSampler, boundSpecularTexture, painter->ssColorTexture);
+		painter->CountSamplerBinds(1);
+	}
+	if(first || boundNormalTexture != material->normalTexture)
+	{
+		boundNormalTexture = material->normalTexture;
+		Rebind(lsNormal, context, painter->uNormalSampler, boundNormalTexture, painter->ssColorTexture);
+		painter->CountSamplerBinds(1);
+	}
+}
+
 //*** Painter
 
-Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats) :
+Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats, ptr<JobSystem> jobSystem, ptr<Profiler> profiler) :
 	device(device),
 	context(context),
 	presenter(presenter),
@@ -111,19 +174,29 @@ Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presen
 	screenHeight(-1),
 	shaderCache(shaderCache),
 	geometryFormats(geometryFormats),
+	jobSystem(jobSystem),
+	profiler(profiler),
 
-	ab(device->CreateAttributeBinding(geometryFormats->al)),
-	instancer(NEW(Instancer(device, maxInstancesCount, geometryFormats->al))),
-	abInstanced(device->CreateAttributeBinding(geometryFormats->al)),
+	ab(device ? device->CreateAttributeBinding(geometryFormats->al) : nullptr),
 	aPosition(geometryFormats->alePosition),
 	aNormal(geometryFormats->aleNormal),
 	aTexcoord(geometryFormats->aleTexcoord),
-	abSkinned(device->CreateAttributeBinding(geometryFormats->alSkinned)),
+	abInstanced(device ? device->CreateAttributeBinding(geometryFormats->alInstanced) : nullptr),
+	vbInstances(device ? device->CreateDynamicVertexBuffer(instanceBufferCapacity * GeometryFormats::instanceStride, geometryFormats->vlInstance) : nullptr),
+	aInstancedPosition(geometryFormats->aleInstancedPosition),
+	aInstancedNormal(geometryFormats->aleInstancedNormal),
+	aInstancedTexcoord(geometryFormats->aleInstancedTexcoord),
+	aInstanceWorld0(geometryFormats->aleInstanceWorld0),
+	aInstanceWorld1(geometryFormats->aleInstanceWorld1),
+	aInstanceWorld2(geometryFormats->aleInstanceWorld2),
+	abSkinned(device ? device->CreateAttributeBinding(geometryFormats->alSkinned) : nullptr),
 	aSkinnedPosition(geometryFormats->aleSkinnedPosition),
 	aSkinnedNormal(geometryFormats->aleSkinnedNormal),
 	aSkinnedTexcoord(geometryFormats->aleSkinnedTexcoord),
 	aSkinnedBoneNumbers(geometryFormats->aleSkinnedBoneNumbers),
 	aSkinnedBoneWeights(geometryFormats->aleSkinnedBoneWeights),
+	vbSkinnedInstances(device ? device->CreateDynamicVertexBuffer(instanceBufferCapacity * GeometryFormats::skinnedInstanceStride, geometryFormats->vlSkinnedInstance) : nullptr),
+	aSkinnedPaletteOffset(geometryFormats->aleSkinnedPaletteOffset),
 
 	ugCamera(NEW(UniformGroup(0))),
 	uViewProj(ugCamera->AddUniform<mat4x4>()),
@@ -143,12 +216,8 @@ Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presen
 	ugModel(NEW(UniformGroup(3))),
 	uWorld(ugModel->AddUniform<mat4x4>()),
 
-	ugInstancedModel(NEW(UniformGroup(3))),
-	uWorlds(ugInstancedModel->AddUniformArray<mat4x4>(maxInstancesCount)),
-
-	ugSkinnedModel(NEW(UniformGroup(3))),
-	uBoneOrientations(ugSkinnedModel->AddUniformArray<vec4>(maxBonesCount)),
-	uBoneOffsets(ugSkinnedModel->AddUniformArray<vec4>(maxBonesCount)),
+	ugBonePalette(NEW(UniformGroup(3))),
+	uBonePalette(ugBonePalette->AddUniformArray<vec4>(bonePaletteCapacity)),
 
 	ugShadowBlur(NEW(UniformGroup(0))),
 	uShadowBlurDirection(ugShadowBlur->AddUniform<vec2>()),
@@ -174,15 +243,36 @@ Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presen
 	iNormal(0),
 	iTexcoord(1),
 	iWorldPosition(2),
-	iDepth(3)
+	iDepth(3),
+
+	cameraProjectionScale(0),
+	models(&frameArena),
+	staticBatchesDirty(false),
+	transparentModels(&frameArena),
+	modelHierarchyAge(0),
+	shadowLodBias(1),
+	preSkinning(false),
+	depthPrePass(false),
+	passStats(&stats[RenderStats::passBackground]),
+	lastPixelShader(nullptr),
+	culledObjectsCount(0),
+	drawnObjectsCount(0),
+	skinnedModels(&frameArena)
 
 {
+	identityInstance[0] = vec4(1, 0, 0, 0);
+	identityInstance[1] = vec4(0, 1, 0, 0);
+	identityInstance[2] = vec4(0, 0, 1, 0);
+
+	// без устройства графические ресурсы не нужны
+	if(!device)
+		return;
+
 	// финализировать uniform группы
 	ugCamera->Finalize(device);
 	ugMaterial->Finalize(device);
 	ugModel->Finalize(device);
-	ugInstancedModel->Finalize(device);
-	ugSkinnedModel->Finalize(device);
+	ugBonePalette->Finalize(device);
 	ugShadowBlur->Finalize(device);
 	ugDownsample->Finalize(device);
 	ugBloom->Finalize(device);
@@ -234,6 +324,8 @@ Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presen
 	dssNormal->SetDepthTest(DepthStencilState::testFuncLess, true);
 	dssFull = device->CreateDepthStencilState();
 	dssFull->SetDepthTest(DepthStencilState::testFuncAlways, false);
+	dssEqual = device->CreateDepthStencilState();
+	dssEqual->SetDepthTest(DepthStencilState::testFuncEqual, false);
 
 	// геометрия полноэкранного прохода
 	struct Quad
@@ -288,6 +380,10 @@ Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presen
 	psShadow = shaderCache->GetPixelShader((
 		fragment(0, newvec4(iDepth, 0, 0, 0))
 		));
+	// пиксельный шейдер для предварительного прохода глубины
+	psDepthOnly = shaderCache->GetPixelShader((
+		fragment(0, newvec4(0, 0, 0, 0))
+		));
 
 	//** шейдеры и состояния постпроцессинга и размытия теней
 	abFilter = quad.ab;
@@ -451,6 +547,10 @@ Painter::Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presen
 		// для последнего прохода - специальный blend state
 		bsLastDownsample = device->CreateBlendState();
 		bsLastDownsample->SetColor(BlendState::colorSourceSrcAlpha, BlendState::colorSourceInvSrcAlpha, BlendState::operationAdd);
+		// для прохода глубины - цвет в буферах остаётся прежним
+		bsNoColor = device->CreateBlendState();
+		bsNoColor->SetColor(BlendState::colorSourceZero, BlendState::colorSourceOne, BlendState::operationAdd);
+		bsNoColor->SetAlpha(BlendState::alphaSourceZero, BlendState::alphaSourceOne, BlendState::operationAdd);
 
 		// фреймбуферы для bloom
 		fbBloom1 = device->CreateFrameBuffer();
@@ -469,6 +569,9 @@ void Painter::Resize(int screenWidth, int screenHeight)
 	this->screenWidth = screenWidth;
 	this->screenHeight = screenHeight;
 
+	if(!device)
+		return;
+
 	SamplerSettings pointSamplerSettings;
 	pointSamplerSettings.SetFilter(SamplerSettings::filterPoint);
 	pointSamplerSettings.SetWrap(SamplerSettings::wrapClamp);
@@ -526,12 +629,15 @@ void Painter::GetWorldPositionAndNormal(const VertexShaderKey& key)
 	if(key.skinned)
 	{
 		Value<vec3> position = aSkinnedPosition;
+		// кость i лежит в палитре парой (кватернион, смещение)
+		// начиная с смещения экземпляра
+		Value<uint> paletteOffset = aSkinnedPaletteOffset["x"].Cast<uint>();
 		Value<uint> boneNumbers[] =
 		{
-			aSkinnedBoneNumbers["x"],
-			aSkinnedBoneNumbers["y"],
-			aSkinnedBoneNumbers["z"],
-			aSkinnedBoneNumbers["w"]
+			paletteOffset + aSkinnedBoneNumbers["x"] * Value<uint>(2),
+			paletteOffset + aSkinnedBoneNumbers["y"] * Value<uint>(2),
+			paletteOffset + aSkinnedBoneNumbers["z"] * Value<uint>(2),
+			paletteOffset + aSkinnedBoneNumbers["w"] * Value<uint>(2)
 		};
 		Value<float> boneWeights[] =
 		{
@@ -540,32 +646,51 @@ void Painter::GetWorldPositionAndNormal(const VertexShaderKey& key)
 			aSkinnedBoneWeights["z"],
 			aSkinnedBoneWeights["w"]
 		};
+		Value<vec4> boneOrientations[4] =
+		{
+			uBonePalette[boneNumbers[0]],
+			uBonePalette[boneNumbers[1]],
+			uBonePalette[boneNumbers[2]],
+			uBonePalette[boneNumbers[3]]
+		};
 		Value<vec3> boneOffsets[4] =
 		{
-			uBoneOffsets[boneNumbers[0]]["xyz"],
-			uBoneOffsets[boneNumbers[1]]["xyz"],
-			uBoneOffsets[boneNumbers[2]]["xyz"],
-			uBoneOffsets[boneNumbers[3]]["xyz"]
+			uBonePalette[boneNumbers[0] + Value<uint>(1)]["xyz"],
+			uBonePalette[boneNumbers[1] + Value<uint>(1)]["xyz"],
+			uBonePalette[boneNumbers[2] + Value<uint>(1)]["xyz"],
+			uBonePalette[boneNumbers[3] + Value<uint>(1)]["xyz"]
 		};
 
 		tmpVertexPosition = newvec4(
-			(ApplyQuaternion(uBoneOrientations[boneNumbers[0]], position) + boneOffsets[0]) * boneWeights[0] +
-			(ApplyQuaternion(uBoneOrientations[boneNumbers[1]], position) + boneOffsets[1]) * boneWeights[1] +
-			(ApplyQuaternion(uBoneOrientations[boneNumbers[2]], position) + boneOffsets[2]) * boneWeights[2] +
-			(ApplyQuaternion(uBoneOrientations[boneNumbers[3]], position) + boneOffsets[3]) * boneWeights[3],
+			(ApplyQuaternion(boneOrientations[0], position) + boneOffsets[0]) * boneWeights[0] +
+			(ApplyQuaternion(boneOrientations[1], position) + boneOffsets[1]) * boneWeights[1] +
+			(ApplyQuaternion(boneOrientations[2], position) + boneOffsets[2]) * boneWeights[2] +
+			(ApplyQuaternion(boneOrientations[3], position) + boneOffsets[3]) * boneWeights[3],
 			1.0f);
 		tmpVertexNormal =
-			ApplyQuaternion(uBoneOrientations[boneNumbers[0]], aSkinnedNormal) * boneWeights[0] +
-			ApplyQuaternion(uBoneOrientations[boneNumbers[1]], aSkinnedNormal) * boneWeights[1] +
-			ApplyQuaternion(uBoneOrientations[boneNumbers[2]], aSkinnedNormal) * boneWeights[2] +
-			ApplyQuaternion(uBoneOrientations[boneNumbers[3]], aSkinnedNormal) * boneWeights[3];
+			ApplyQuaternion(boneOrientations[0], aSkinnedNormal) * boneWeights[0] +
+			ApplyQuaternion(boneOrientations[1], aSkinnedNormal) * boneWeights[1] +
+			ApplyQuaternion(boneOrientations[2], aSkinnedNormal) * boneWeights[2] +
+			ApplyQuaternion(boneOrientations[3], aSkinnedNormal) * boneWeights[3];
+	}
+	else if(key.instanced)
+	{
+		// матрица мира приходит построчно из потока экземпляров
+		Value<vec4> position = newvec4(aInstancedPosition, 1.0f);
+		tmpVertexPosition = newvec4(
+			dot(aInstanceWorld0, position),
+			dot(aInstanceWorld1, position),
+			dot(aInstanceWorld2, position),
+			1.0f);
+		tmpVertexNormal = newvec3(
+			dot(aInstanceWorld0["xyz"], aInstancedNormal),
+			dot(aInstanceWorld1["xyz"], aInstancedNormal),
+			dot(aInstanceWorld2["xyz"], aInstancedNormal));
 	}
 	else
 	{
-		Value<mat4x4> tmpWorld = key.instanced ? uWorlds[instancer->GetInstanceID()] : uWorld;
-
-		tmpVertexPosition = mul(tmpWorld, newvec4(aPosition, 1.0f));
-		tmpVertexNormal = mul(tmpWorld.Cast<mat3x3>(), aNormal);
+		tmpVertexPosition = mul(uWorld, newvec4(aPosition, 1.0f));
+		tmpVertexNormal = mul(uWorld.Cast<mat3x3>(), aNormal);
 	}
 }
 
@@ -640,7 +765,7 @@ ptr<VertexShader> Painter::GetVertexShader(const VertexShaderKey& key)
 	Expression e = (
 		setPosition(mul(uViewProj, tmpVertexPosition)),
 		iNormal.Set(tmpVertexNormal),
-		iTexcoord.Set(key.skinned ? aSkinnedTexcoord : aTexcoord),
+		iTexcoord.Set(key.skinned ? aSkinnedTexcoord : key.instanced ? aInstancedTexcoord : aTexcoord),
 		iWorldPosition.Set(tmpVertexPosition["xyz"])
 	);
 
@@ -738,10 +863,14 @@ void Painter::BeginFrame(float frameTime)
 {
 	this->frameTime = frameTime;
 
-	models.clear();
-	transparentModels.clear();
-	skinnedModels.clear();
+	models.Clear();
+	transparentModels.Clear();
+	skinnedModels.Clear();
+	frameArena.Reset();
 	lights.clear();
+
+	culledObjectsCount = 0;
+	drawnObjectsCount = 0;
 }
 
 void Painter::SetCamera(const mat4x4& cameraViewProj, const vec3& cameraPosition)
@@ -749,26 +878,933 @@ void Painter::SetCamera(const mat4x4& cameraViewProj, const vec3& cameraPosition
 	this->cameraViewProj = cameraViewProj;
 	this->cameraInvViewProj = fromEigen(toEigen(cameraViewProj).inverse().eval());
 	this->cameraPosition = cameraPosition;
+	// вторая строка вид-проекции - строка поворота вида, умноженная на масштаб проекции
+	cameraProjectionScale = sqrt(cameraViewProj(1, 0) * cameraViewProj(1, 0) + cameraViewProj(1, 1) * cameraViewProj(1, 1) + cameraViewProj(1, 2) * cameraViewProj(1, 2));
+}
+
+void Painter::AddModel(Material* material, Geometry* geometry, const mat4x4& worldTransform)
+{
+	models.Add(Model(materials.Register(material), geometries.Register(geometry), worldTransform));
+}
+
+void Painter::AddStaticModel(Material* material, Geometry* geometry, const mat4x4& worldTransform)
+{
+	staticModels.push_back(Model(materials.Register(material), geometries.Register(geometry), worldTransform));
+	staticBatchesDirty = true;
+}
+
+void Painter::ClearStaticModels()
+{
+	staticModels.clear();
+	staticBatchesDirty = true;
+}
+
+void Painter::UpdateStaticBatches()
+{
+	if(!staticBatchesDirty)
+		return;
+	staticBatchesDirty = false;
+
+	// отсортировать статические модели по материалу, а затем по геометрии
+	// (по номерам, чтобы порядок не зависел от адресов)
+	struct Sorter
+	{
+		bool operator()(const Model& a, const Model& b) const
+		{
+			return a.material < b.material || (a.material == b.material && a.geometry < b.geometry);
+		}
+	};
+	std::stable_sort(staticModels.begin(), staticModels.end(), Sorter());
+
+	// разбить на батчи, упаковать матрицы и посчитать объёмы
+	staticBatches.clear();
+	staticWorldTransforms.resize(staticModels.size());
+	staticModelBatches.resize(staticModels.size());
+	staticBoundingBoxes.resize(staticModels.size());
+	for(size_t i = 0; i < staticModels.size(); ++i)
+	{
+		const Model& model = staticModels[i];
+		if(staticBatches.empty() || staticBatches.back().material != model.material || staticBatches.back().geometry != model.geometry)
+			staticBatches.push_back(StaticBatch(model.material, model.geometry, (int)i));
+		staticBatches.back().count++;
+		staticWorldTransforms[i] = model.worldTransform;
+		staticModelBatches[i] = (int)staticBatches.size() - 1;
+		staticBoundingBoxes[i] = geometries.Get(model.geometry)->GetBoundingBox().Transform(model.worldTransform);
+	}
+
+	// создать буферы экземпляров для батчей
+	for(size_t i = 0; i < staticBatches.size(); ++i)
+	{
+		if(!device)
+			break;
+		StaticBatch& batch = staticBatches[i];
+		instanceData.resize(batch.count * 3);
+		for(int k = 0; k < batch.count; ++k)
+			PackInstance(&instanceData[k * 3], staticWorldTransforms[batch.first + k]);
+		batch.instanceBuffer = device->CreateStaticVertexBuffer(
+			MemoryFile::CreateViaCopy(&instanceData[0], batch.count * GeometryFormats::instanceStride),
+			geometryFormats->vlInstance);
+	}
+
+	// статическая иерархия строится один раз
+	staticHierarchy.Build(staticBoundingBoxes.data(), (int)staticBoundingBoxes.size());
+}
+
+void Painter::UpdateModelHierarchy()
+{
+	modelBoundingBoxes.resize(models.GetCount());
+	jobSystem->ParallelFor(models.GetCount(), 256, [this](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+			modelBoundingBoxes[i] = geometries.Get(models[i].geometry)->GetBoundingBox().Transform(models[i].worldTransform);
+	});
+
+	// количество кадров, после которого иерархию всё равно стоит перестроить
+	const int maxModelHierarchyAge = 60;
+
+	if(modelHierarchy.GetItemsCount() == models.GetCount() && modelHierarchyAge < maxModelHierarchyAge)
+	{
+		modelHierarchy.Refit(modelBoundingBoxes.data());
+		++modelHierarchyAge;
+	}
+	else
+	{
+		modelHierarchy.Build(modelBoundingBoxes.data(), models.GetCount());
+		modelHierarchyAge = 0;
+	}
+}
+
+void Painter::Cull(View& view)
+{
+	VisibleSet& visibleSet = view.visibleSet;
+	Frustum frustum(view.viewProj);
+
+	// статические модели
+	visibleSet.staticModels.clear();
+	staticHierarchy.Cull(frustum, staticBoundingBoxes.data(), visibleSet.staticModels);
+	// номера должны идти по возрастанию, чтобы модели одного батча шли подряд
+	std::sort(visibleSet.staticModels.begin(), visibleSet.staticModels.end());
+
+	// динамические модели
+	visibleSet.models.clear();
+	modelHierarchy.Cull(frustum, modelBoundingBoxes.data(), visibleSet.models);
+
+	if(view.pass == drawPassShadow)
+	{
+		// выбросить статические модели, не отбрасывающие тень
+		size_t staticCastersCount = 0;
+		for(size_t i = 0; i < visibleSet.staticModels.size(); ++i)
+		{
+			int modelNumber = visibleSet.staticModels[i];
+			if(materials.Get(staticBatches[staticModelBatches[modelNumber]].material)->castsShadow)
+				visibleSet.staticModels[staticCastersCount++] = modelNumber;
+		}
+		visibleSet.staticModels.resize(staticCastersCount);
+
+		// отфильтровать общий список отбрасывающих тень моделей по видимости
+		std::vector<unsigned char>& mask = view.visibleModelsMask;
+		mask.assign(models.GetCount(), 0);
+		for(size_t i = 0; i < visibleSet.models.size(); ++i)
+			mask[visibleSet.models[i]] = 1;
+		visibleSet.models.clear();
+		for(size_t i = 0; i < shadowCasters.size(); ++i)
+			if(mask[shadowCasters[i]])
+				visibleSet.models.push_back(shadowCasters[i]);
+
+		// так же отфильтровать skinned-модели, по сферам теневой геометрии
+		std::vector<unsigned char>& skinnedMask = view.visibleSkinnedModelsMask;
+		skinnedMask.resize(skinnedModels.GetCount());
+		for(int i = 0; i < skinnedModels.GetCount(); ++i)
+			skinnedMask[i] = frustum.IsVisible(skinnedBoundingSpheres[i * 2 + 1]) ? 1 : 0;
+		visibleSet.skinnedModels.clear();
+		for(size_t i = 0; i < skinnedShadowCasters.size(); ++i)
+			if(skinnedMask[skinnedShadowCasters[i]])
+				visibleSet.skinnedModels.push_back(skinnedShadowCasters[i]);
+	}
+	else
+	{
+		visibleSet.skinnedModels.clear();
+		for(int i = 0; i < skinnedModels.GetCount(); ++i)
+			if(frustum.IsVisible(skinnedBoundingSpheres[i * 2]))
+				visibleSet.skinnedModels.push_back(i);
+	}
+
+	int objectsCount = (int)staticModels.size() + models.GetCount() + skinnedModels.GetCount();
+	int visibleObjectsCount = (int)(visibleSet.staticModels.size() + visibleSet.models.size() + visibleSet.skinnedModels.size());
+
+	// полупрозрачных моделей мало, проверяем по одной
+	visibleSet.transparentModels.clear();
+	if(view.pass != drawPassShadow)
+	{
+		for(int i = 0; i < transparentModels.GetCount(); ++i)
+			if(frustum.IsVisible(geometries.Get(transparentModels[i].geometry)->GetBoundingBox().Transform(transparentModels[i].worldTransform)))
+				visibleSet.transparentModels.push_back(i);
+		objectsCount += transparentModels.GetCount();
+		visibleObjectsCount += (int)visibleSet.transparentModels.size();
+	}
+
+	view.drawnObjectsCount = visibleObjectsCount;
+	view.culledObjectsCount = objectsCount - visibleObjectsCount;
+}
+
+void Painter::SortDrawItems(std::vector<DrawItem>& items, std::vector<DrawItem>& temp, std::vector<int>& numbers)
+{
+	int count = (int)items.size();
+	temp.resize(count);
+	RadixSort(items.data(), temp.data(), count);
+	numbers.resize(count);
+	for(int i = 0; i < count; ++i)
+		numbers[i] = items[i].number;
+}
+
+void Painter::SortModelNumbers(View& view, std::vector<int>& modelNumbers, const FrameArray<Model>& models, const std::vector<unsigned char>& lods, DrawPass pass)
+{
+	const mat4x4& viewProj = view.viewProj;
+	view.drawItems.resize(modelNumbers.size());
+	for(size_t i = 0; i < modelNumbers.size(); ++i)
+	{
+		const Model& model = models[modelNumbers[i]];
+		const mat4x4& t = model.worldTransform;
+		// глубина - w центра модели в пространстве отсечения
+		float depth = viewProj(3, 0) * t(0, 3) + viewProj(3, 1) * t(1, 3) + viewProj(3, 2) * t(2, 3) + viewProj(3, 3);
+		DrawItem& item = view.drawItems[i];
+		item.number = modelNumbers[i];
+		int shaderPermutation = (int)Hasher()(materials.Get(model.material)->GetKey());
+		uint32_t geometryId = GetLodDrawId(model.geometry, lods[modelNumbers[i]]);
+		// непрозрачные модели внутри материала грубо упорядочены спереди назад,
+		// полупрозрачные - строго сзади вперёд для правильного смешивания
+		if(pass == drawPassOpaque)
+			item.key = MakeFrontToBackDrawKey(pass, shaderPermutation, model.material, geometryId, depth);
+		else if(pass == drawPassTransparent)
+			item.key = MakeBackToFrontDrawKey(pass, shaderPermutation, model.material, geometryId, depth);
+		else
+			item.key = MakeDrawKey(pass, shaderPermutation, model.material, geometryId, depth);
+	}
+	SortDrawItems(view.drawItems, view.drawItemsTemp, modelNumbers);
+}
+
+void Painter::SortSkinnedModelNumbers(View& view, std::vector<int>& modelNumbers)
+{
+	view.drawItems.resize(modelNumbers.size());
+	for(size_t i = 0; i < modelNumbers.size(); ++i)
+	{
+		const SkinnedModel& skinnedModel = skinnedModels[modelNumbers[i]];
+		DrawItem& item = view.drawItems[i];
+		item.number = modelNumbers[i];
+		item.key = MakeDrawKey(drawPassOpaque, (int)Hasher()(materials.Get(skinnedModel.material)->GetKey()), skinnedModel.material, GetLodDrawId(skinnedModel.geometry, skinnedModelLods[modelNumbers[i] * 2]), 0);
+	}
+	SortDrawItems(view.drawItems, view.drawItemsTemp, modelNumbers);
+}
+
+float Painter::GetScreenSize(const vec3& center, float radius) const
+{
+	// w в пространстве отсечения - расстояние вдоль направления взгляда
+	float w = cameraViewProj(3, 0) * center.x + cameraViewProj(3, 1) * center.y + cameraViewProj(3, 2) * center.z + cameraViewProj(3, 3);
+	// модель, в которой находится камера, считается самой крупной
+	if(w <= radius)
+		return std::numeric_limits<float>::infinity();
+	return radius * cameraProjectionScale / w;
+}
+
+int Painter::SelectModelLod(GeometryHandle geometryHandle, const mat4x4& worldTransform) const
+{
+	Geometry* geometry = geometries.Get(geometryHandle);
+	if(geometry->GetLodsCount() <= 1)
+		return 0;
+	BoundingSphere sphere = geometry->GetBoundingSphere().Transform(worldTransform);
+	return geometry->SelectLod(GetScreenSize(sphere.center, sphere.radius));
+}
+
+int Painter::GetShadowLod(GeometryHandle geometryHandle, int lod) const
+{
+	return std::min(lod + shadowLodBias, geometries.Get(geometryHandle)->GetLodsCount() - 1);
 }
 
-void Painter::AddModel(ptr<Material> material, ptr<Geometry> geometry, const mat4x4& worldTransform)
+uint32_t Painter::GetLodDrawId(GeometryHandle geometryHandle, int lod)
 {
-	models.push_back(Model(material, geometry, worldTransform));
+	return geometryHandle * Geometry::maxLodsCount + lod;
 }
 
-void Painter::AddTransparentModel(ptr<Material> material, ptr<Geometry> geometry, const mat4x4& worldTransform)
+void Painter::SelectLods()
 {
-	transparentModels.push_back(Model(material, geometry, worldTransform));
+	modelLods.resize(models.GetCount());
+	jobSystem->ParallelFor(models.GetCount(), 1024, [this](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+			modelLods[i] = (unsigned char)SelectModelLod(models[i].geometry, models[i].worldTransform);
+	});
+
+	transparentModelLods.resize(transparentModels.GetCount());
+	for(int i = 0; i < transparentModels.GetCount(); ++i)
+		transparentModelLods[i] = (unsigned char)SelectModelLod(transparentModels[i].geometry, transparentModels[i].worldTransform);
+
+	// положение skinned-модели задаётся преобразованием корневой кости;
+	// поза может выходить за объём исходной геометрии, поэтому сфера
+	// для отсечения немного расширяется
+	const float skinnedBoundsPadding = 1.25f;
+	skinnedModelLods.resize(skinnedModels.GetCount() * 2);
+	skinnedBoundingSpheres.resize(skinnedModels.GetCount() * 2);
+	for(int i = 0; i < skinnedModels.GetCount(); ++i)
+	{
+		const SkinnedModel& skinnedModel = skinnedModels[i];
+		const BoneAnimationFrame* animationFrame = skinnedModel.animationFrame;
+		auto selectLod = [&](GeometryHandle geometryHandle, BoundingSphere& boundingSphere) -> int
+		{
+			Geometry* geometry = geometries.Get(geometryHandle);
+			const BoundingSphere& sphere = geometry->GetBoundingSphere();
+			vec3 center = fromEigen((toEigenQuat(animationFrame->orientations[0]) * toEigen(sphere.center)).eval()) + animationFrame->offsets[0];
+			boundingSphere = BoundingSphere(center, sphere.radius * skinnedBoundsPadding);
+			if(geometry->GetLodsCount() <= 1)
+				return 0;
+			return geometry->SelectLod(GetScreenSize(center, sphere.radius));
+		};
+		skinnedModelLods[i * 2] = (unsigned char)selectLod(skinnedModel.geometry, skinnedBoundingSpheres[i * 2]);
+		skinnedModelLods[i * 2 + 1] = (unsigned char)GetShadowLod(skinnedModel.shadowGeometry, selectLod(skinnedModel.shadowGeometry, skinnedBoundingSpheres[i * 2 + 1]));
+	}
+}
+
+void Painter::FillViewLods(View& view)
+{
+	const VisibleSet& visibleSet = view.visibleSet;
+	bool shadow = view.pass == drawPassShadow;
+
+	view.modelLods.resize(visibleSet.models.size());
+	for(size_t i = 0; i < visibleSet.models.size(); ++i)
+	{
+		int modelNumber = visibleSet.models[i];
+		view.modelLods[i] = shadow ? (unsigned char)GetShadowLod(models[modelNumber].geometry, modelLods[modelNumber]) : modelLods[modelNumber];
+	}
+
+	view.transparentLods.resize(visibleSet.transparentModels.size());
+	for(size_t i = 0; i < visibleSet.transparentModels.size(); ++i)
+		view.transparentLods[i] = transparentModelLods[visibleSet.transparentModels[i]];
+
+	view.skinnedLods.resize(visibleSet.skinnedModels.size());
+	for(size_t i = 0; i < visibleSet.skinnedModels.size(); ++i)
+		view.skinnedLods[i] = skinnedModelLods[visibleSet.skinnedModels[i] * 2 + (shadow ? 1 : 0)];
+}
+
+void Painter::BuildShadowCasters()
+{
+	// в теневом проходе ключ зависит только от геометрии и уровня
+	// детализации (выбранного по камере), поэтому порядок один для всех
+	// источников света
+	shadowCasterItems.clear();
+	for(int i = 0; i < models.GetCount(); ++i)
+		if(materials.Get(models[i].material)->castsShadow)
+		{
+			DrawItem item;
+			item.key = MakeDrawKey(drawPassShadow, 0, 0, GetLodDrawId(models[i].geometry, GetShadowLod(models[i].geometry, modelLods[i])), 0);
+			item.number = i;
+			shadowCasterItems.push_back(item);
+		}
+	SortDrawItems(shadowCasterItems, shadowCasterItemsTemp, shadowCasters);
+
+	shadowCasterItems.clear();
+	for(int i = 0; i < skinnedModels.GetCount(); ++i)
+		if(materials.Get(skinnedModels[i].material)->castsShadow)
+		{
+			DrawItem item;
+			item.key = MakeDrawKey(drawPassShadow, 0, 0, GetLodDrawId(skinnedModels[i].shadowGeometry, skinnedModelLods[i * 2 + 1]), 0);
+			item.number = i;
+			shadowCasterItems.push_back(item);
+		}
+	SortDrawItems(shadowCasterItems, shadowCasterItemsTemp, skinnedShadowCasters);
+}
+
+void Painter::PackModelInstances(std::vector<vec4>& instances, const std::vector<int>& modelNumbers, const FrameArray<Model>& models)
+{
+	instances.resize(modelNumbers.size() * 3);
+	jobSystem->ParallelFor((int)modelNumbers.size(), 1024, [&](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+			PackInstance(&instances[i * 3], models[modelNumbers[i]].worldTransform);
+	});
+}
+
+float Painter::GetStaticModelDepth(const View& view, int modelNumber) const
+{
+	// w положения модели в пространстве отсечения
+	const mat4x4& viewProj = view.viewProj;
+	const mat4x4& t = staticWorldTransforms[modelNumber];
+	return viewProj(3, 0) * t(0, 3) + viewProj(3, 1) * t(1, 3) + viewProj(3, 2) * t(2, 3) + viewProj(3, 3);
+}
+
+void Painter::SortStaticBatches(View& view)
+{
+	// ключ батча - как у динамической модели, с глубиной ближайшей видимой модели
+	std::vector<int>& visibleModels = view.visibleSet.staticModels;
+	view.drawItems.clear();
+	for(size_t i = 0; i < visibleModels.size(); )
+	{
+		size_t end = GetStaticBatchEnd(view, i);
+		float nearestDepth = std::numeric_limits<float>::infinity();
+		for(size_t j = i; j < end; ++j)
+			nearestDepth = std::min(nearestDepth, GetStaticModelDepth(view, visibleModels[j]));
+		const StaticBatch& batch = staticBatches[staticModelBatches[visibleModels[i]]];
+		DrawItem item;
+		item.key = MakeFrontToBackDrawKey(view.pass, (int)Hasher()(materials.Get(batch.material)->GetKey()), batch.material, batch.geometry, nearestDepth);
+		item.number = (int)i;
+		view.drawItems.push_back(item);
+		i = end;
+	}
+	SortDrawItems(view.drawItems, view.drawItemsTemp, view.staticBatchStarts);
+
+	// переставить группы моделей батчей в порядке ключей
+	std::vector<int>& temp = view.staticModelsTemp;
+	temp.clear();
+	for(size_t i = 0; i < view.staticBatchStarts.size(); ++i)
+	{
+		size_t begin = view.staticBatchStarts[i];
+		temp.insert(temp.end(), visibleModels.begin() + begin, visibleModels.begin() + GetStaticBatchEnd(view, begin));
+	}
+	visibleModels.swap(temp);
 }
 
-void Painter::AddSkinnedModel(ptr<Material> material, ptr<Geometry> geometry, ptr<BoneAnimationFrame> animationFrame)
+void Painter::PackStaticInstances(View& view)
+{
+	std::vector<int>& visibleModels = view.visibleSet.staticModels;
+	std::vector<unsigned char>& lods = view.staticLods;
+	view.staticInstances.resize(visibleModels.size() * 3);
+	lods.resize(visibleModels.size());
+	for(size_t i = 0; i < visibleModels.size(); )
+	{
+		size_t end = GetStaticBatchEnd(view, i);
+
+		// выбрать уровни детализации
+		GeometryHandle geometryHandle = staticBatches[staticModelBatches[visibleModels[i]]].geometry;
+		int lodsCounts[Geometry::maxLodsCount] = { 0 };
+		for(size_t j = i; j < end; ++j)
+		{
+			int lod = SelectModelLod(geometryHandle, staticWorldTransforms[visibleModels[j]]);
+			if(view.pass == drawPassShadow)
+				lod = GetShadowLod(geometryHandle, lod);
+			lods[j] = (unsigned char)lod;
+			++lodsCounts[lod];
+		}
+
+		// упорядочить модели (устойчиво) по уровням, чтобы уровни шли подряд,
+		// а для камеры внутри уровня ещё и грубо спереди назад; батч, видимый
+		// целиком одним уровнем, рисуется из готового буфера как есть
+		bool singleLod = lodsCounts[lods[i]] == (int)(end - i);
+		bool wholeBatch = (int)(end - i) == staticBatches[staticModelBatches[visibleModels[i]]].count;
+		bool frontToBack = view.pass != drawPassShadow && !(singleLod && wholeBatch);
+		if(!singleLod || frontToBack)
+		{
+			// корзина - уровень и грубая глубина; временно хранится в lods
+			const int depthsCount = 16;
+			int bucketsCounts[Geometry::maxLodsCount * depthsCount] = { 0 };
+			for(size_t j = i; j < end; ++j)
+			{
+				int bucket = lods[j] * depthsCount;
+				if(frontToBack)
+					bucket += (int)QuantizeDepthCoarse(GetStaticModelDepth(view, visibleModels[j]));
+				lods[j] = (unsigned char)bucket;
+				++bucketsCounts[bucket];
+			}
+			int bucketStarts[Geometry::maxLodsCount * depthsCount];
+			bucketStarts[0] = (int)i;
+			for(int bucket = 1; bucket < Geometry::maxLodsCount * depthsCount; ++bucket)
+				bucketStarts[bucket] = bucketStarts[bucket - 1] + bucketsCounts[bucket - 1];
+			std::vector<int>& temp = view.staticModelsTemp;
+			temp.assign(visibleModels.begin() + i, visibleModels.begin() + end);
+			for(size_t j = i; j < end; ++j)
+				visibleModels[bucketStarts[lods[j]]++] = temp[j - i];
+			size_t j = i;
+			for(int bucket = 0; bucket < Geometry::maxLodsCount * depthsCount; ++bucket)
+				for(int k = 0; k < bucketsCounts[bucket]; ++k)
+					lods[j++] = (unsigned char)(bucket / depthsCount);
+		}
+
+		// целиком видимые одним уровнем батчи рисуются из готовых буферов
+		if(!IsStaticBatchPrebuilt(view, i, end))
+			for(size_t j = i; j < end; ++j)
+				PackInstance(&view.staticInstances[j * 3], staticWorldTransforms[visibleModels[j]]);
+		i = end;
+	}
+}
+
+void Painter::PrepareView(View& view)
+{
+	Cull(view);
+
+	// в теневых видах модели уже идут в порядке общего списка
+	VisibleSet& visibleSet = view.visibleSet;
+	if(view.pass != drawPassShadow)
+	{
+		SortModelNumbers(view, visibleSet.models, models, modelLods, view.pass);
+		SortSkinnedModelNumbers(view, visibleSet.skinnedModels);
+		SortModelNumbers(view, visibleSet.transparentModels, transparentModels, transparentModelLods, drawPassTransparent);
+		PackModelInstances(view.transparentInstances, visibleSet.transparentModels, transparentModels);
+	}
+	FillViewLods(view);
+	PackModelInstances(view.modelInstances, visibleSet.models, models);
+	if(view.pass != drawPassShadow)
+		SortStaticBatches(view);
+	PackStaticInstances(view);
+	PackSkinnedInstances(view);
+}
+
+void Painter::Prepare()
+{
+	// статические батчи перестраиваются только при изменении набора моделей
+	// (создаёт буферы, поэтому в этом потоке)
+	UpdateStaticBatches();
+
+	// виды: теневые источники света, затем камера
+	int viewsCount = 0;
+	for(size_t i = 0; i < lights.size(); ++i)
+		if(lights[i].shadow)
+			++viewsCount;
+	views.resize(viewsCount + 1);
+	int viewNumber = 0;
+	for(size_t i = 0; i < lights.size(); ++i)
+		if(lights[i].shadow)
+		{
+			views[viewNumber].viewProj = lights[i].transform;
+			views[viewNumber].pass = drawPassShadow;
+			++viewNumber;
+		}
+	views[viewNumber].viewProj = cameraViewProj;
+	views[viewNumber].pass = drawPassOpaque;
+
+	// иерархия динамических моделей обновляется каждый кадр, уровни
+	// детализации выбираются и списки отбрасывающих тень моделей строятся
+	// один раз, после чего виды готовятся независимо
+	JobSystem::TaskGraph graph;
+	int hierarchyTask = graph.Add([this]() { UpdateModelHierarchy(); });
+	int lodsTask = graph.Add([this]() { SelectLods(); });
+	int shadowCastersTask = graph.Add([this]() { BuildShadowCasters(); });
+	graph.Depend(shadowCastersTask, lodsTask);
+	int bonePaletteTask = graph.Add([this]() { PackBonePalette(); });
+	// CPU-скиннинг нужен только при рисовании, виды от него не зависят
+	if(preSkinning)
+		graph.Add([this]() { PreSkin(); });
+	for(size_t i = 0; i < views.size(); ++i)
+	{
+		View* view = &views[i];
+		int viewTask = graph.Add([this, view]() { PrepareView(*view); });
+		graph.Depend(viewTask, hierarchyTask);
+		graph.Depend(viewTask, lodsTask);
+		graph.Depend(viewTask, bonePaletteTask);
+		if(view->pass == drawPassShadow)
+			graph.Depend(viewTask, shadowCastersTask);
+	}
+	graph.Run(jobSystem);
+
+	// сложить статистику в фиксированном порядке
+	for(size_t i = 0; i < views.size(); ++i)
+	{
+		culledObjectsCount += views[i].culledObjectsCount;
+		drawnObjectsCount += views[i].drawnObjectsCount;
+	}
+}
+
+size_t Painter::GetStaticBatchEnd(const View& view, size_t begin) const
+{
+	const std::vector<int>& visibleModels = view.visibleSet.staticModels;
+	int batchNumber = staticModelBatches[visibleModels[begin]];
+	size_t end;
+	for(end = begin + 1; end < visibleModels.size() && staticModelBatches[visibleModels[end]] == batchNumber; ++end);
+	return end;
+}
+
+bool Painter::IsStaticBatchPrebuilt(const View& view, size_t begin, size_t end) const
+{
+	// модели части батча упорядочены по уровням
+	return (int)(end - begin) == staticBatches[staticModelBatches[view.visibleSet.staticModels[begin]]].count &&
+		view.staticLods[begin] == view.staticLods[end - 1];
+}
+
+void Painter::DrawStaticBatch(const View& view, size_t begin, size_t end)
+{
+	const StaticBatch& batch = staticBatches[staticModelBatches[view.visibleSet.staticModels[begin]]];
+	Geometry* geometry = geometries.Get(batch.geometry);
+
+	// если батч виден целиком одним уровнем, данные экземпляров уже лежат в GPU
+	if(IsStaticBatchPrebuilt(view, begin, end))
+	{
+		IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(view.staticLods[begin]);
+		Context::LetIndexBuffer lib(context, indexBuffer);
+		Context::LetVertexBuffer lvbInstances(context, 1, batch.instanceBuffer);
+		context->DrawInstanced(batch.count);
+		CountDraw(indexBuffer, batch.count);
+		return;
+	}
+
+	// иначе экземпляры упакованы при подготовке вида, уровни идут подряд
+	for(size_t i = begin; i < end; )
+	{
+		int lod = view.staticLods[i];
+		size_t lodEnd;
+		for(lodEnd = i + 1; lodEnd < end && view.staticLods[lodEnd] == lod; ++lodEnd);
+
+		IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(lod);
+		Context::LetIndexBuffer lib(context, indexBuffer);
+		DrawInstanced(indexBuffer, &view.staticInstances[i * 3], (int)(lodEnd - i));
+
+		i = lodEnd;
+	}
+}
+
+void Painter::DrawInstanced(IndexBuffer* indexBuffer, const vec4* instances, int count)
+{
+	for(int i = 0; i < count; i += instanceBufferCapacity)
+	{
+		int batchCount = std::min(count - i, instanceBufferCapacity);
+
+		// залить экземпляры в GPU
+		context->UploadVertexBufferData(vbInstances, instances + i * 3, batchCount * GeometryFormats::instanceStride);
+
+		// нарисовать
+		Context::LetVertexBuffer lvbInstances(context, 1, vbInstances);
+		context->DrawInstanced(batchCount);
+		CountDraw(indexBuffer, batchCount);
+	}
+}
+
+void Painter::PackInstance(vec4* data, const mat4x4& worldTransform)
+{
+	for(int i = 0; i < 3; ++i)
+		data[i] = vec4(worldTransform(i, 0), worldTransform(i, 1), worldTransform(i, 2), worldTransform(i, 3));
+}
+
+void Painter::BeginPassStats(RenderStats::Pass pass)
+{
+	passStats = &stats[pass];
+}
+
+void Painter::CountDraw(IndexBuffer* indexBuffer, int instancesCount)
+{
+	++passStats->drawCalls;
+	passStats->instances += instancesCount;
+	passStats->triangles += indexBuffer->GetIndicesCount() / 3 * instancesCount;
+}
+
+void Painter::CountSamplerBinds(int count)
+{
+	passStats->samplerBinds += count;
+}
+
+void Painter::UploadUniforms(UniformGroup* uniformGroup)
+{
+	uniformGroup->Upload(context);
+	++passStats->uniformUploads;
+}
+
+PixelShader* Painter::SwitchPixelShader(PixelShader* pixelShader)
+{
+	if(pixelShader != lastPixelShader)
+	{
+		lastPixelShader = pixelShader;
+		++passStats->pixelShaderSwitches;
+	}
+	return pixelShader;
+}
+
+UniformBuffer* Painter::GetMaterialUniformBuffer(Material* material)
+{
+	if(!material->uniformBuffer)
+	{
+		material->uniformBuffer = device->CreateUniformBuffer(ugMaterial->GetSize());
+		material->dirty = true;
+	}
+
+	if(material->dirty)
+	{
+		// данные собираются в памяти uniform-группы и заливаются в буфер материала
+		uDiffuse.Set(material->diffuse);
+		uSpecular.Set(material->specular);
+		uNormalCoordTransform.Set(material->normalCoordTransform);
+		context->UploadUniformBufferData(material->uniformBuffer, ugMaterial->GetData(), ugMaterial->GetSize());
+		material->dirty = false;
+		++passStats->uniformUploads;
+	}
+
+	return material->uniformBuffer;
+}
+
+void Painter::PackBonePalette()
+{
+	int skinnedModelsCount = skinnedModels.GetCount();
+	skinnedPaletteOffsets.resize(skinnedModelsCount);
+	int paletteSize = 0;
+	for(int i = 0; i < skinnedModelsCount; ++i)
+	{
+		int size = (int)skinnedModels[i].animationFrame->orientations.size() * 2;
+		if(size > bonePaletteCapacity)
+			THROW("Too many bones");
+		// модель не должна пересекать границу страницы
+		if(paletteSize % bonePaletteCapacity + size > bonePaletteCapacity)
+			paletteSize += bonePaletteCapacity - paletteSize % bonePaletteCapacity;
+		skinnedPaletteOffsets[i] = paletteSize;
+		paletteSize += size;
+	}
+	bonePalette.resize(paletteSize);
+
+	jobSystem->ParallelFor(skinnedModelsCount, 64, [&](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+		{
+			const BoneAnimationFrame* animationFrame = skinnedModels[i].animationFrame;
+			const std::vector<quat>& orientations = animationFrame->orientations;
+			const std::vector<vec3>& offsets = animationFrame->offsets;
+			vec4* palette = &bonePalette[skinnedPaletteOffsets[i]];
+			int bonesCount = (int)orientations.size();
+			for(int k = 0; k < bonesCount; ++k)
+			{
+				const quat& q = orientations[k];
+				palette[k * 2] = vec4(q.x, q.y, q.z, q.w);
+				palette[k * 2 + 1] = vec4(offsets[k].x, offsets[k].y, offsets[k].z, 0);
+			}
+		}
+	});
+}
+
+void Painter::PackSkinnedInstances(View& view)
+{
+	const std::vector<int>& visibleSkinnedModels = view.visibleSet.skinnedModels;
+	view.skinnedInstances.resize(visibleSkinnedModels.size());
+	for(size_t i = 0; i < visibleSkinnedModels.size(); ++i)
+		view.skinnedInstances[i] = vec4((float)(skinnedPaletteOffsets[visibleSkinnedModels[i]] % bonePaletteCapacity), 0, 0, 0);
+}
+
+void Painter::UploadBonePalette()
+{
+	int pagesCount = ((int)bonePalette.size() + bonePaletteCapacity - 1) / bonePaletteCapacity;
+	while((int)bonePaletteBuffers.size() < pagesCount)
+		bonePaletteBuffers.push_back(device->CreateUniformBuffer(ugBonePalette->GetSize()));
+	for(int i = 0; i < pagesCount; ++i)
+	{
+		int size = std::min((int)bonePalette.size() - i * bonePaletteCapacity, bonePaletteCapacity);
+		context->UploadUniformBufferData(bonePaletteBuffers[i], &bonePalette[i * bonePaletteCapacity], size * sizeof(vec4));
+		++passStats->uniformUploads;
+	}
+}
+
+void Painter::DrawSkinnedInstanced(IndexBuffer* indexBuffer, const View& view, size_t begin, size_t end)
+{
+	const std::vector<int>& visibleSkinnedModels = view.visibleSet.skinnedModels;
+	for(size_t i = begin; i < end; )
+	{
+		// вызов ограничен страницей палитры и ёмкостью буфера экземпляров
+		int page = skinnedPaletteOffsets[visibleSkinnedModels[i]] / bonePaletteCapacity;
+		int batchCount;
+		for(batchCount = 1;
+			i + batchCount < end &&
+			batchCount < instanceBufferCapacity &&
+			page == skinnedPaletteOffsets[visibleSkinnedModels[i + batchCount]] / bonePaletteCapacity;
+			++batchCount);
+
+		Context::LetUniformBuffer lubPalette(context, ugBonePalette->GetSlot(), bonePaletteBuffers[page]);
+
+		// залить экземпляры в GPU
+		context->UploadVertexBufferData(vbSkinnedInstances, &view.skinnedInstances[i], batchCount * GeometryFormats::skinnedInstanceStride);
+
+		// нарисовать
+		Context::LetVertexBuffer lvbInstances(context, 1, vbSkinnedInstances);
+		context->DrawInstanced(batchCount);
+		CountDraw(indexBuffer, batchCount);
+
+		i += batchCount;
+	}
+}
+
+void Painter::PreSkin()
+{
+	// разложить геометрии по вершинному буферу кадра
+	int skinnedModelsCount = skinnedModels.GetCount();
+	preSkinnedGeometries.clear();
+	skinnedPreSkinnedGeometries.resize(skinnedModelsCount * 2);
+	int verticesCount = 0;
+	auto add = [&](int modelNumber, GeometryHandle geometryHandle) -> int
+	{
+		ptr<File> vertices = geometries.Get(geometryHandle)->GetSkinnedVertices();
+		if(!vertices)
+			THROW("Skinned geometry has no vertices in memory");
+		PreSkinnedGeometry preSkinnedGeometry;
+		preSkinnedGeometry.modelNumber = modelNumber;
+		preSkinnedGeometry.geometry = geometryHandle;
+		preSkinnedGeometry.sourceVertices = vertices->GetData();
+		preSkinnedGeometry.verticesOffset = verticesCount;
+		preSkinnedGeometry.verticesCount = (int)(vertices->GetSize() / GeometryFormats::skinnedVertexStride);
+		verticesCount += preSkinnedGeometry.verticesCount;
+		preSkinnedGeometries.push_back(preSkinnedGeometry);
+		return (int)preSkinnedGeometries.size() - 1;
+	};
+	for(int i = 0; i < skinnedModelsCount; ++i)
+	{
+		const SkinnedModel& skinnedModel = skinnedModels[i];
+		int geometryNumber = add(i, skinnedModel.geometry);
+		skinnedPreSkinnedGeometries[i * 2] = geometryNumber;
+		// теневая геометрия преобразуется отдельно, только если отличается
+		if(!materials.Get(skinnedModel.material)->castsShadow)
+			skinnedPreSkinnedGeometries[i * 2 + 1] = -1;
+		else if(skinnedModel.shadowGeometry == skinnedModel.geometry)
+			skinnedPreSkinnedGeometries[i * 2 + 1] = geometryNumber;
+		else
+			skinnedPreSkinnedGeometries[i * 2 + 1] = add(i, skinnedModel.shadowGeometry);
+	}
+	preSkinnedVertices.resize(verticesCount * GeometryFormats::vertexStride);
+
+	// преобразовать вершины
+	jobSystem->ParallelFor((int)preSkinnedGeometries.size(), 1, [&](int begin, int end)
+	{
+		std::vector<SkinningMatrix> matrices;
+		for(int i = begin; i < end; ++i)
+		{
+			const PreSkinnedGeometry& preSkinnedGeometry = preSkinnedGeometries[i];
+			GetSkinningMatrices(skinnedModels[preSkinnedGeometry.modelNumber].animationFrame, matrices);
+			SkinVertices(
+				preSkinnedGeometry.sourceVertices,
+				preSkinnedGeometry.verticesCount,
+				&matrices[0],
+				&preSkinnedVertices[preSkinnedGeometry.verticesOffset * GeometryFormats::vertexStride]);
+		}
+	});
+}
+
+void Painter::UploadPreSkinnedVertices()
+{
+	if(preSkinnedBuffers.size() < preSkinnedGeometries.size())
+		preSkinnedBuffers.resize(preSkinnedGeometries.size());
+	for(size_t i = 0; i < preSkinnedGeometries.size(); ++i)
+	{
+		const PreSkinnedGeometry& preSkinnedGeometry = preSkinnedGeometries[i];
+		PreSkinnedBuffer& buffer = preSkinnedBuffers[i];
+		// буферы переиспользуются между кадрами и растут по необходимости
+		if(buffer.capacity < preSkinnedGeometry.verticesCount)
+		{
+			buffer.vertexBuffer = device->CreateDynamicVertexBuffer(preSkinnedGeometry.verticesCount * GeometryFormats::vertexStride, geometryFormats->vl);
+			buffer.capacity = preSkinnedGeometry.verticesCount;
+		}
+		context->UploadVertexBufferData(buffer.vertexBuffer,
+			&preSkinnedVertices[preSkinnedGeometry.verticesOffset * GeometryFormats::vertexStride],
+			preSkinnedGeometry.verticesCount * GeometryFormats::vertexStride);
+	}
+}
+
+void Painter::DrawPreSkinned(int preSkinnedGeometry, int lod)
+{
+	IndexBuffer* indexBuffer = geometries.Get(preSkinnedGeometries[preSkinnedGeometry].geometry)->GetLodIndexBuffer(lod);
+	Context::LetVertexBuffer lvb(context, 0, preSkinnedBuffers[preSkinnedGeometry].vertexBuffer);
+	Context::LetIndexBuffer lib(context, indexBuffer);
+	DrawInstanced(indexBuffer, identityInstance, 1);
+}
+
+void Painter::DrawDepthOnly(const View& view, bool shadow)
+{
+	//** рисуем простые модели
+
+	const std::vector<int>& visibleModels = view.visibleSet.models;
+
+	{
+		// установить привязку атрибутов
+		Context::LetAttributeBinding lab(context, abInstanced);
+		// установить вершинный шейдер
+		Context::LetVertexShader lvs(context, GetVertexShadowShader(VertexShaderKey(true, false)));
+
+		// нарисовать инстансингом с группировкой по геометрии и уровню детализации
+		for(size_t j = 0; j < visibleModels.size(); )
+		{
+			// количество рисуемых объектов
+			GeometryHandle geometryHandle = models[visibleModels[j]].geometry;
+			int lod = view.modelLods[j];
+			int batchCount;
+			for(batchCount = 1;
+				j + batchCount < visibleModels.size() &&
+				geometryHandle == models[visibleModels[j + batchCount]].geometry &&
+				lod == view.modelLods[j + batchCount];
+				++batchCount);
+
+			// установить геометрию
+			Geometry* geometry = geometries.Get(geometryHandle);
+			IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(lod);
+			Context::LetVertexBuffer lvb(context, 0, geometry->GetVertexBuffer());
+			Context::LetIndexBuffer lib(context, indexBuffer);
+
+			// нарисовать
+			DrawInstanced(indexBuffer, &view.modelInstances[j * 3], batchCount);
+
+			j += batchCount;
+		}
+
+		// нарисовать видимые части статических батчей
+		for(size_t j = 0; j < view.visibleSet.staticModels.size(); )
+		{
+			size_t end = GetStaticBatchEnd(view, j);
+			const StaticBatch& batch = staticBatches[staticModelBatches[view.visibleSet.staticModels[j]]];
+			Context::LetVertexBuffer lvb(context, 0, geometries.Get(batch.geometry)->GetVertexBuffer());
+			DrawStaticBatch(view, j, end);
+			j = end;
+		}
+	}
+
+	//** рисуем skinned-модели
+
+	const std::vector<int>& visibleSkinnedModels = view.visibleSet.skinnedModels;
+
+	if(preSkinning)
+	{
+		// вершины уже преобразованы, рисуются как обычные модели
+		Context::LetAttributeBinding lab(context, abInstanced);
+		Context::LetVertexShader lvs(context, GetVertexShadowShader(VertexShaderKey(true, false)));
+		for(size_t j = 0; j < visibleSkinnedModels.size(); ++j)
+			DrawPreSkinned(skinnedPreSkinnedGeometries[visibleSkinnedModels[j] * 2 + (shadow ? 1 : 0)], view.skinnedLods[j]);
+	}
+	else
+	{
+		// установить привязку атрибутов
+		Context::LetAttributeBinding lab(context, abSkinned);
+		// установить вершинный шейдер
+		Context::LetVertexShader lvs(context, GetVertexShadowShader(VertexShaderKey(true, true)));
+
+		// нарисовать инстансингом с группировкой по геометрии; для камеры
+		// нужна та же геометрия, что и при освещении, иначе глубина не совпадёт
+		for(size_t j = 0; j < visibleSkinnedModels.size(); )
+		{
+			const SkinnedModel& skinnedModel = skinnedModels[visibleSkinnedModels[j]];
+			GeometryHandle geometryHandle = shadow ? skinnedModel.shadowGeometry : skinnedModel.geometry;
+			int lod = view.skinnedLods[j];
+			size_t end;
+			for(end = j + 1; end < visibleSkinnedModels.size(); ++end)
+			{
+				const SkinnedModel& nextSkinnedModel = skinnedModels[visibleSkinnedModels[end]];
+				if(geometryHandle != (shadow ? nextSkinnedModel.shadowGeometry : nextSkinnedModel.geometry) || lod != view.skinnedLods[end])
+					break;
+			}
+
+			// установить геометрию
+			Geometry* geometry = geometries.Get(geometryHandle);
+			IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(lod);
+			Context::LetVertexBuffer lvb(context, 0, geometry->GetVertexBuffer());
+			Context::LetIndexBuffer lib(context, indexBuffer);
+
+			// нарисовать
+			DrawSkinnedInstanced(indexBuffer, view, j, end);
+
+			j = end;
+		}
+	}
+}
+
+void Painter::AddTransparentModel(Material* material, Geometry* geometry, const mat4x4& worldTransform)
+{
+	transparentModels.Add(Model(materials.Register(material), geometries.Register(geometry), worldTransform));
+}
+
+void Painter::AddSkinnedModel(Material* material, Geometry* geometry, BoneAnimationFrame* animationFrame)
 {
 	AddSkinnedModel(material, geometry, geometry, animationFrame);
 }
 
-void Painter::AddSkinnedModel(ptr<Material> material, ptr<Geometry> geometry, ptr<Geometry> shadowGeometry, ptr<BoneAnimationFrame> animationFrame)
+void Painter::AddSkinnedModel(Material* material, Geometry* geometry, Geometry* shadowGeometry, BoneAnimationFrame* animationFrame)
 {
-	skinnedModels.push_back(SkinnedModel(material, geometry, shadowGeometry, animationFrame));
+	// номера костей в вершинах индексируют матрицы кадра (при CPU-скиннинге - без проверок)
+	int bonesCount = (int)animationFrame->orientations.size();
+	if(geometry->GetSkinnedBonesCount() > bonesCount || shadowGeometry->GetSkinnedBonesCount() > bonesCount)
+		THROW("Skinned geometry refers to bones missing in animation frame");
+	skinnedModels.Add(SkinnedModel(materials.Register(material), geometries.Register(geometry), geometries.Register(shadowGeometry), animationFrame));
 }
 
 void Painter::SetAmbientColor(const vec3& ambientColor)
@@ -791,6 +1827,23 @@ void Painter::AddShadowLight(const vec3& position, const vec3& color, const mat4
 	lights.push_back(Light(position, color, transform));
 }
 
+void Painter::SetDepthPrePass(bool depthPrePass)
+{
+	this->depthPrePass = depthPrePass;
+}
+
+void Painter::SetPreSkinning(bool preSkinning)
+{
+	this->preSkinning = preSkinning;
+}
+
+void Painter::SetShadowLodBias(int shadowLodBias)
+{
+	if(shadowLodBias < 0)
+		THROW("Shadow LOD bias should be non-negative");
+	this->shadowLodBias = shadowLodBias;
+}
+
 void Painter::SetupPostprocess(float bloomLimit, float toneLuminanceKey, float toneMaxLuminance)
 {
 	this->bloomLimit = bloomLimit;
@@ -799,6 +1852,19 @@ void Painter::SetupPostprocess(float bloomLimit, float toneLuminanceKey, float t
 }
 
 void Painter::Draw()
+{
+	{
+		Profiler::Scope profileScope(profiler, "prepare");
+		Prepare();
+	}
+	if(device)
+	{
+		Profiler::Scope profileScope(profiler, "submit");
+		Submit();
+	}
+}
+
+void Painter::Submit()
 {
 	// получить количество простых и теневых источников света
 	int basicLightsCount = 0;
@@ -806,120 +1872,44 @@ void Painter::Draw()
 	for(size_t i = 0; i < lights.size(); ++i)
 		++(lights[i].shadow ? shadowLightsCount : basicLightsCount);
 
+	// сбросить статистику
+	stats.Reset();
+	lastPixelShader = nullptr;
+
+	// палитра костей или вершины после CPU-скиннинга
+	// заливаются один раз на все проходы
+	BeginPassStats(RenderStats::passSkinned);
+	if(preSkinning)
+		UploadPreSkinnedVertices();
+	else
+		UploadBonePalette();
+
 	// выполнить теневые проходы
 	int shadowPassNumber = 0;
 	for(size_t i = 0; i < lights.size(); ++i)
 		if(lights[i].shadow)
 		{
+			BeginPassStats((RenderStats::Pass)(RenderStats::passShadow + shadowPassNumber));
+			Profiler::Scope profileScope(profiler, RenderStats::GetPassName(RenderStats::passShadow + shadowPassNumber));
+
 			Context::LetViewport lv(context, shadowMapSize, shadowMapSize);
 			Context::LetFrameBuffer lfb(context, fbShadows[shadowPassNumber]);
 			Context::LetUniformBuffer lubCamera(context, ugCamera);
-			Context::LetPixelShader lps(context, psShadow);
+			Context::LetPixelShader lps(context, SwitchPixelShader(psShadow));
 
 			ptr<RenderBuffer> rb = rbShadows[shadowPassNumber];
+			const View& view = views[shadowPassNumber];
 
 			// указать трансформацию
 			uViewProj.Set(lights[i].transform);
-			ugCamera->Upload(context);
+			UploadUniforms(ugCamera);
 
 			// очистить карту теней
 			context->ClearColor(0, vec4(1e8, 1e8, 1e8, 1e8));
 			context->ClearDepth(1.0f);
 
-			// сортировщик моделей по геометрии
-			struct GeometrySorter
-			{
-				bool operator()(const Model& a, const Model& b) const
-				{
-					return a.geometry < b.geometry;
-				}
-				bool operator()(const SkinnedModel& a, const SkinnedModel& b) const
-				{
-					return a.shadowGeometry < b.shadowGeometry;
-				}
-			};
-
-			//** рисуем простые модели
-
-			// отсортировать объекты по геометрии
-			std::sort(models.begin(), models.end(), GeometrySorter());
-
-			{
-				// установить привязку атрибутов
-				Context::LetAttributeBinding lab(context, abInstanced);
-				// установить вершинный шейдер
-				Context::LetVertexShader lvs(context, GetVertexShadowShader(VertexShaderKey(true, false)));
-				// установить константный буфер
-				Context::LetUniformBuffer lubModel(context, ugInstancedModel);
-
-				// нарисовать инстансингом с группировкой по геометрии
-				for(size_t j = 0; j < models.size(); )
-				{
-					// количество рисуемых объектов
-					int batchCount;
-					for(batchCount = 1;
-						batchCount < maxInstancesCount &&
-						j + batchCount < models.size() &&
-						models[j].geometry == models[j + batchCount].geometry;
-						++batchCount);
-
-					// установить геометрию
-					Context::LetVertexBuffer lvb(context, 0, models[j].geometry->GetVertexBuffer());
-					Context::LetIndexBuffer lib(context, models[j].geometry->GetIndexBuffer());
-					// установить uniform'ы
-					for(int k = 0; k < batchCount; ++k)
-						uWorlds.Set(k, models[j + k].worldTransform);
-					// и залить в GPU
-					ugInstancedModel->Upload(context);
-
-					// нарисовать
-					instancer->Draw(context, batchCount);
-
-					j += batchCount;
-				}
-			}
-
-			//** рисуем skinned-модели
-
-			// отсортировать объекты по геометрии
-			std::sort(skinnedModels.begin(), skinnedModels.end(), GeometrySorter());
-
-			{
-				// установить привязку атрибутов
-				Context::LetAttributeBinding lab(context, abSkinned);
-				// установить вершинный шейдер
-				Context::LetVertexShader lvs(context, GetVertexShadowShader(VertexShaderKey(false, true)));
-				// установить константный буфер
-				Context::LetUniformBuffer lubModel(context, ugSkinnedModel);
-
-				// нарисовать с группировкой по геометрии
-				for(size_t j = 0; j < skinnedModels.size(); ++j)
-				{
-					const SkinnedModel& skinnedModel = skinnedModels[j];
-					// установить геометрию
-					Context::LetVertexBuffer lvb(context, 0, skinnedModel.shadowGeometry->GetVertexBuffer());
-					Context::LetIndexBuffer lib(context, skinnedModel.shadowGeometry->GetIndexBuffer());
-					// установить uniform'ы костей
-					ptr<BoneAnimationFrame> animationFrame = skinnedModel.animationFrame;
-					const std::vector<quat>& orientations = animationFrame->orientations;
-					const std::vector<vec3>& offsets = animationFrame->offsets;
-					int bonesCount = (int)orientations.size();
-#ifdef _DEBUG
-					if(bonesCount > maxBonesCount)
-						THROW("Too many bones");
-#endif
-					for(int k = 0; k < bonesCount; ++k)
-					{
-						uBoneOrientations.Set(k, orientations[k]);
-						uBoneOffsets.Set(k, vec4(offsets[k].x, offsets[k].y, offsets[k].z, 0));
-					}
-					// и залить в GPU
-					ugSkinnedModel->Upload(context);
-
-					// нарисовать
-					context->Draw();
-				}
-			}
+			// нарисовать видимые модели
+			DrawDepthOnly(view, true);
 
 			// выполнить размытие тени
 			{
@@ -928,7 +1918,7 @@ void Painter::Draw()
 				Context::LetVertexBuffer lvb(context, 0, vbFilter);
 				Context::LetIndexBuffer lib(context, ibFilter);
 				Context::LetVertexShader lvs(context, vsFilter);
-				Context::LetPixelShader lps(context, psShadowBlur);
+				Context::LetPixelShader lps(context, SwitchPixelShader(psShadowBlur));
 				Context::LetDepthStencilState ldss(context, dssFull);
 
 				// первый проход
@@ -936,26 +1926,30 @@ void Painter::Draw()
 				{
 					Context::LetFrameBuffer lfb(context, fbShadowBlur1);
 					Context::LetSampler ls(context, uShadowBlurSourceSampler, rb->GetTexture(), ssPoint);
+					CountSamplerBinds(1);
 					Context::LetUniformBuffer lub(context, ugShadowBlur);
 
 					uShadowBlurDirection.Set(vec2(1.0f / shadowMapSize, 0));
-					ugShadowBlur->Upload(context);
+					UploadUniforms(ugShadowBlur);
 
 					context->ClearColor(0, vec4(0, 0, 0, 0));
 					context->Draw();
+					CountDraw(ibFilter);
 				}
 
 				// второй проход
 				{
 					Context::LetFrameBuffer lfb(context, fbShadowBlurs[i]);
 					Context::LetSampler ls(context, uShadowBlurSourceSampler, rbShadowBlur->GetTexture(), ssPoint);
+					CountSamplerBinds(1);
 					Context::LetUniformBuffer lub(context, ugShadowBlur);
 
 					uShadowBlurDirection.Set(vec2(0, 1.0f / shadowMapSize));
-					ugShadowBlur->Upload(context);
+					UploadUniforms(ugShadowBlur);
 
 					context->ClearColor(0, vec4(0, 0, 0, 0));
 					context->Draw();
+					CountDraw(ibFilter);
 				}
 			}
 
@@ -964,20 +1958,14 @@ void Painter::Draw()
 
 	// основное рисование
 
-	// сортировщик моделей по материалу, а затем по геометрии
-	struct Sorter
 	{
-		bool operator()(const Model& a, const Model& b) const
-		{
-			return a.material < b.material || (a.material == b.material && a.geometry < b.geometry);
-		}
-		bool operator()(const SkinnedModel& a, const SkinnedModel& b) const
-		{
-			return a.material < b.material || (a.material == b.material && a.geometry < b.geometry);
-		}
-	};
+		const View& view = views.back();
+
+		Profiler::Scope profileScope(profiler, "main");
+
+		// общие настройки камеры и света учитываются в проходе background
+		BeginPassStats(RenderStats::passBackground);
 
-	{
 		Context::LetFrameBuffer lfb(context, fbOpaque);
 		Context::LetViewport lv(context, screenWidth, screenHeight);
 		Context::LetDepthStencilState ldss(context, dssNormal);
@@ -987,7 +1975,7 @@ void Painter::Draw()
 		uViewProj.Set(cameraViewProj);
 		uInvViewProj.Set(cameraInvViewProj);
 		uCameraPosition.Set(cameraPosition);
-		ugCamera->Upload(context);
+		UploadUniforms(ugCamera);
 
 		// установить параметры источников света
 		LightVariant& lightVariant = GetLightVariant(LightVariantKey(basicLightsCount, shadowLightsCount));
@@ -1006,6 +1994,7 @@ void Painter::Draw()
 				shadowLight.uLightTransform.Set(lights[i].transform);
 
 				ls[shadowLightNumber](context, shadowLight.uShadowSampler, rbShadows[shadowLightNumber]->GetTexture(), shadowSamplerState);
+				CountSamplerBinds(1);
 
 				shadowLightNumber++;
 			}
@@ -1015,7 +2004,7 @@ void Painter::Draw()
 				basicLight.uLightPosition.Set(lights[i].position);
 				basicLight.uLightColor.Set(lights[i].color);
 			}
-		lightVariant.ugLight->Upload(context);
+		UploadUniforms(lightVariant.ugLight);
 
 		// очистить рендербуферы
 		context->ClearColor(0, vec4(0, 0, 0, 1)); // color
@@ -1024,6 +2013,7 @@ void Painter::Draw()
 
 		// нарисовать background
 		{
+			Profiler::Scope profileScope(profiler, "background");
 			// общие для фильтров настройки
 			Context::LetAttributeBinding lab(context, abFilter);
 			Context::LetVertexBuffer lvb(context, 0, vbFilter);
@@ -1033,70 +2023,101 @@ void Painter::Draw()
 
 			Context::LetUniformBuffer lubCamera(context, ugCamera);
 			Context::LetSampler lsBackground(context, uBackgroundSampler, backgroundTexture, ssColorTexture);
-			Context::LetPixelShader lps(context, psBackground);
+			CountSamplerBinds(1);
+			Context::LetPixelShader lps(context, SwitchPixelShader(psBackground));
 
 			context->Draw();
+			CountDraw(ibFilter);
+		}
+
+		// предварительный проход глубины: дорогое освещение потом
+		// считается только для видимых пикселей
+		if(depthPrePass)
+		{
+			BeginPassStats(RenderStats::passDepthPrePass);
+			Profiler::Scope profileScope(profiler, "depthPrePass");
+			// пишется только глубина: цвет фона не затирается и не перерисовывается
+			Context::LetBlendState lbs(context, bsNoColor);
+			Context::LetPixelShader lps(context, SwitchPixelShader(psDepthOnly));
+			DrawDepthOnly(view, false);
 		}
 
 		//** нарисовать простые модели
 		{
-			std::sort(models.begin(), models.end(), Sorter());
+			BeginPassStats(RenderStats::passOpaque);
+			Profiler::Scope profileScope(profiler, "opaque");
+			const std::vector<int>& visibleModels = view.visibleSet.models;
+			Context::LetDepthStencilState ldssOpaque(context, depthPrePass ? dssEqual : dssNormal);
 
 			// установить привязку атрибутов
 			Context::LetAttributeBinding lab(context, abInstanced);
 			// установить вершинный шейдер
 			Context::LetVertexShader lvs(context, GetVertexShader(VertexShaderKey(true, false)));
-			// установить константный буфер
-			Context::LetUniformBuffer lubModel(context, ugInstancedModel);
 			// установить материал
-			Context::LetUniformBuffer lubMaterial(context, ugMaterial);
+			MaterialBinder materialBinder(this);
 
-			// нарисовать
-			for(size_t i = 0; i < models.size(); )
+			// нарисовать видимые части статических батчей
+			for(size_t i = 0; i < view.visibleSet.staticModels.size(); )
+			{
+				size_t end = GetStaticBatchEnd(view, i);
+				const StaticBatch& batch = staticBatches[staticModelBatches[view.visibleSet.staticModels[i]]];
+
+				// установить параметры материала
+				Material* material = materials.Get(batch.material);
+				materialBinder.Bind(material);
+
+				// установить пиксельный шейдер
+				Context::LetPixelShader lps(context, SwitchPixelShader(GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey()))));
+
+				// установить геометрию
+				Context::LetVertexBuffer lvb(context, 0, geometries.Get(batch.geometry)->GetVertexBuffer());
+
+				// нарисовать
+				DrawStaticBatch(view, i, end);
+
+				i = end;
+			}
+
+			// нарисовать динамические модели
+			for(size_t i = 0; i < visibleModels.size(); )
 			{
 				// выяснить размер батча по материалу
-				ptr<Material> material = models[i].material;
+				MaterialHandle materialHandle = models[visibleModels[i]].material;
 				int materialBatchCount;
 				for(materialBatchCount = 1;
-					i + materialBatchCount < models.size() &&
-					material == models[i + materialBatchCount].material;
+					i + materialBatchCount < visibleModels.size() &&
+					materialHandle == models[visibleModels[i + materialBatchCount]].material;
 					++materialBatchCount);
 
+				Material* material = materials.Get(materialHandle);
+
 				// установить параметры материала
-				Context::LetSampler lsDiffuse(context, uDiffuseSampler, material->diffuseTexture, ssColorTexture);
-				Context::LetSampler lsSpecular(context, uSpecularSampler, material->specularTexture, ssColorTexture);
-				Context::LetSampler lsNormal(context, uNormalSampler, material->normalTexture, ssColorTexture);
-				uDiffuse.Set(material->diffuse);
-				uSpecular.Set(material->specular);
-				uNormalCoordTransform.Set(material->normalCoordTransform);
-				ugMaterial->Upload(context);
+				materialBinder.Bind(material);
 
 				// рисуем инстансингом обычные модели
 				// установить пиксельный шейдер
-				Context::LetPixelShader lps(context, GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey())));
+				Context::LetPixelShader lps(context, SwitchPixelShader(GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey()))));
 				// цикл по батчам по геометрии
 				for(int j = 0; j < materialBatchCount; )
 				{
 					// выяснить размер батча по геометрии
-					ptr<Geometry> geometry = models[i + j].geometry;
+					GeometryHandle geometryHandle = models[visibleModels[i + j]].geometry;
+					int lod = view.modelLods[i + j];
 					int geometryBatchCount;
 					for(geometryBatchCount = 1;
-						geometryBatchCount < maxInstancesCount &&
 						j + geometryBatchCount < materialBatchCount &&
-						geometry == models[i + j + geometryBatchCount].geometry;
+						geometryHandle == models[visibleModels[i + j + geometryBatchCount]].geometry &&
+						lod == view.modelLods[i + j + geometryBatchCount];
 						++geometryBatchCount);
 
 					// установить геометрию
+					Geometry* geometry = geometries.Get(geometryHandle);
+					IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(lod);
 					Context::LetVertexBuffer lvb(context, 0, geometry->GetVertexBuffer());
-					Context::LetIndexBuffer lib(context, geometry->GetIndexBuffer());
-
-					// установить uniform'ы
-					for(int k = 0; k < geometryBatchCount; ++k)
-						uWorlds.Set(k, models[i + j + k].worldTransform);
-					ugInstancedModel->Upload(context);
+					Context::LetIndexBuffer lib(context, indexBuffer);
 
 					// нарисовать
-					instancer->Draw(context, geometryBatchCount);
+					DrawInstanced(indexBuffer, &view.modelInstances[(i + j) * 3], geometryBatchCount);
 
 					j += geometryBatchCount;
 				}
@@ -1107,122 +2128,122 @@ void Painter::Draw()
 
 		//** нарисовать skinned-модели
 		{
-			std::sort(skinnedModels.begin(), skinnedModels.end(), Sorter());
+			BeginPassStats(RenderStats::passSkinned);
+			Profiler::Scope profileScope(profiler, "skinned");
+			const std::vector<int>& visibleSkinnedModels = view.visibleSet.skinnedModels;
+			Context::LetDepthStencilState ldssOpaque(context, depthPrePass ? dssEqual : dssNormal);
 
-			// установить привязку атрибутов
-			Context::LetAttributeBinding lab(context, abSkinned);
-			// установить вершинный шейдер
-			Context::LetVertexShader lvs(context, GetVertexShader(VertexShaderKey(false, true)));
-			// установить константный буфер
-			Context::LetUniformBuffer lubModel(context, ugSkinnedModel);
-			// установить материал
-			Context::LetUniformBuffer lubMaterial(context, ugMaterial);
-
-			// нарисовать
-			for(size_t i = 0; i < skinnedModels.size(); ++i)
+			if(preSkinning)
 			{
-				const SkinnedModel& skinnedModel = skinnedModels[i];
+				// вершины уже преобразованы, рисуются как обычные модели
+				Context::LetAttributeBinding lab(context, abInstanced);
+				Context::LetVertexShader lvs(context, GetVertexShader(VertexShaderKey(true, false)));
+				MaterialBinder materialBinder(this);
+				for(size_t i = 0; i < visibleSkinnedModels.size(); ++i)
+				{
+					Material* material = materials.Get(skinnedModels[visibleSkinnedModels[i]].material);
+					materialBinder.Bind(material);
+					Context::LetPixelShader lps(context, SwitchPixelShader(GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey()))));
+					DrawPreSkinned(skinnedPreSkinnedGeometries[visibleSkinnedModels[i] * 2], view.skinnedLods[i]);
+				}
+			}
+			else
+			{
+				// установить привязку атрибутов
+				Context::LetAttributeBinding lab(context, abSkinned);
+				// установить вершинный шейдер
+				Context::LetVertexShader lvs(context, GetVertexShader(VertexShaderKey(true, true)));
+				// установить материал
+				MaterialBinder materialBinder(this);
 
-				// установить параметры материала
-				ptr<Material> material = skinnedModel.material;
-				Context::LetSampler lsDiffuse(context, uDiffuseSampler, material->diffuseTexture, ssColorTexture);
-				Context::LetSampler lsSpecular(context, uSpecularSampler, material->specularTexture, ssColorTexture);
-				Context::LetSampler lsNormal(context, uNormalSampler, material->normalTexture, ssColorTexture);
-				uDiffuse.Set(material->diffuse);
-				uSpecular.Set(material->specular);
-				uNormalCoordTransform.Set(material->normalCoordTransform);
-				ugMaterial->Upload(context);
+				// нарисовать инстансингом с группировкой по материалу и геометрии
+				for(size_t i = 0; i < visibleSkinnedModels.size(); )
+				{
+					const SkinnedModel& skinnedModel = skinnedModels[visibleSkinnedModels[i]];
+					size_t end;
+					for(end = i + 1;
+						end < visibleSkinnedModels.size() &&
+						skinnedModel.material == skinnedModels[visibleSkinnedModels[end]].material &&
+						skinnedModel.geometry == skinnedModels[visibleSkinnedModels[end]].geometry &&
+						view.skinnedLods[i] == view.skinnedLods[end];
+						++end);
+
+					// установить параметры материала
+					Material* material = materials.Get(skinnedModel.material);
+					materialBinder.Bind(material);
+
+					// установить пиксельный шейдер
+					Context::LetPixelShader lps(context, SwitchPixelShader(GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey()))));
 
-				// установить пиксельный шейдер
-				Context::LetPixelShader lps(context, GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey())));
+					// установить геометрию
+					Geometry* geometry = geometries.Get(skinnedModel.geometry);
+					IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(view.skinnedLods[i]);
+					Context::LetVertexBuffer lvb(context, 0, geometry->GetVertexBuffer());
+					Context::LetIndexBuffer lib(context, indexBuffer);
 
-				// установить геометрию
-				ptr<Geometry> geometry = skinnedModel.geometry;
-				Context::LetVertexBuffer lvb(context, 0, geometry->GetVertexBuffer());
-				Context::LetIndexBuffer lib(context, geometry->GetIndexBuffer());
-
-				// установить uniform'ы костей
-				ptr<BoneAnimationFrame> animationFrame = skinnedModel.animationFrame;
-				const std::vector<quat>& orientations = animationFrame->orientations;
-				const std::vector<vec3>& offsets = animationFrame->offsets;
-				int bonesCount = (int)orientations.size();
-#ifdef _DEBUG
-				if(bonesCount > maxBonesCount)
-					THROW("Too many bones");
-#endif
-				for(int k = 0; k < bonesCount; ++k)
-				{
-					uBoneOrientations.Set(k, orientations[k]);
-					uBoneOffsets.Set(k, vec4(offsets[k].x, offsets[k].y, offsets[k].z, 0));
-				}
-				ugSkinnedModel->Upload(context);
+					// нарисовать
+					DrawSkinnedInstanced(indexBuffer, view, i, end);
 
-				// нарисовать
-				context->Draw();
+					i = end;
+				}
 			}
 		}
 
 		//** нарисовать простые полупрозрачные модели
 		{
-			std::sort(transparentModels.begin(), transparentModels.end(), Sorter());
+			BeginPassStats(RenderStats::passTransparent);
+			Profiler::Scope profileScope(profiler, "transparent");
+			const std::vector<int>& visibleModels = view.visibleSet.transparentModels;
 
 			// установить привязку атрибутов
 			Context::LetAttributeBinding lab(context, abInstanced);
 			// установить вершинный шейдер
 			Context::LetVertexShader lvs(context, GetVertexShader(VertexShaderKey(true, false)));
-			// установить константный буфер
-			Context::LetUniformBuffer lubModel(context, ugInstancedModel);
 			// установить материал
-			Context::LetUniformBuffer lubMaterial(context, ugMaterial);
+			MaterialBinder materialBinder(this);
 			// установить смешивание
 			Context::LetBlendState lbs(context, bsTransparent);
 
 			// нарисовать
-			for(size_t i = 0; i < transparentModels.size(); )
+			for(size_t i = 0; i < visibleModels.size(); )
 			{
 				// выяснить размер батча по материалу
-				ptr<Material> material = transparentModels[i].material;
+				MaterialHandle materialHandle = transparentModels[visibleModels[i]].material;
 				int materialBatchCount;
 				for(materialBatchCount = 1;
-					i + materialBatchCount < transparentModels.size() &&
-					material == transparentModels[i + materialBatchCount].material;
+					i + materialBatchCount < visibleModels.size() &&
+					materialHandle == transparentModels[visibleModels[i + materialBatchCount]].material;
 					++materialBatchCount);
 
+				Material* material = materials.Get(materialHandle);
+
 				// установить параметры материала
-				Context::LetSampler lsDiffuse(context, uDiffuseSampler, material->diffuseTexture, ssColorTexture);
-				Context::LetSampler lsSpecular(context, uSpecularSampler, material->specularTexture, ssColorTexture);
-				Context::LetSampler lsNormal(context, uNormalSampler, material->normalTexture, ssColorTexture);
-				uDiffuse.Set(material->diffuse);
-				uSpecular.Set(material->specular);
-				uNormalCoordTransform.Set(material->normalCoordTransform);
-				ugMaterial->Upload(context);
+				materialBinder.Bind(material);
 
 				// рисуем инстансингом обычные модели
 				// установить пиксельный шейдер
-				Context::LetPixelShader lps(context, GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey())));
+				Context::LetPixelShader lps(context, SwitchPixelShader(GetPixelShader(PixelShaderKey(basicLightsCount, shadowLightsCount, material->GetKey()))));
 				// цикл по батчам по геометрии
 				for(int j = 0; j < materialBatchCount; )
 				{
 					// выяснить размер батча по геометрии
-					ptr<Geometry> geometry = transparentModels[i + j].geometry;
+					GeometryHandle geometryHandle = transparentModels[visibleModels[i + j]].geometry;
+					int lod = view.transparentLods[i + j];
 					int geometryBatchCount;
 					for(geometryBatchCount = 1;
-						geometryBatchCount < maxInstancesCount &&
 						j + geometryBatchCount < materialBatchCount &&
-						geometry == transparentModels[i + j + geometryBatchCount].geometry;
+						geometryHandle == transparentModels[visibleModels[i + j + geometryBatchCount]].geometry &&
+						lod == view.transparentLods[i + j + geometryBatchCount];
 						++geometryBatchCount);
 
 					// установить геометрию
+					Geometry* geometry = geometries.Get(geometryHandle);
+					IndexBuffer* indexBuffer = geometry->GetLodIndexBuffer(lod);
 					Context::LetVertexBuffer lvb(context, 0, geometry->GetVertexBuffer());
-					Context::LetIndexBuffer lib(context, geometry->GetIndexBuffer());
-
-					// установить uniform'ы
-					for(int k = 0; k < geometryBatchCount; ++k)
-						uWorlds.Set(k, transparentModels[i + j + k].worldTransform);
-					ugInstancedModel->Upload(context);
+					Context::LetIndexBuffer lib(context, indexBuffer);
 
 					// нарисовать
-					instancer->Draw(context, geometryBatchCount);
+					DrawInstanced(indexBuffer, &view.transparentInstances[(i + j) * 3], geometryBatchCount);
 
 					j += geometryBatchCount;
 				}
@@ -1234,6 +2255,8 @@ void Painter::Draw()
 
 	// всё, теперь постпроцессинг
 	{
+		Profiler::Scope profileScope(profiler, "postprocess");
+
 		// общие для фильтров настройки
 		Context::LetAttributeBinding lab(context, abFilter);
 		Context::LetVertexBuffer lvb(context, 0, vbFilter);
@@ -1247,49 +2270,56 @@ void Painter::Draw()
 		за 2 секунды - остаётся K^2
 		за t секунд - pow(K, t) = exp(t * log(K))
 		*/
-		static bool veryFirstDownsampling = true;
-		uDownsampleBlend.Set(1.0f - exp(frameTime * (-0.79f)));
-		for(int i = 0; i < downsamplingPassesCount; ++i)
 		{
-			float halfSourcePixelWidth = 0.5f / (i == 0 ? screenWidth : (1 << (downsamplingPassesCount - i)));
-			float halfSourcePixelHeight = 0.5f / (i == 0 ? screenHeight : (1 << (downsamplingPassesCount - i)));
-			uDownsampleOffsets.Set(vec4(-halfSourcePixelWidth, halfSourcePixelWidth, -halfSourcePixelHeight, halfSourcePixelHeight));
-			ugDownsample->Upload(context);
-
-			Context::LetFrameBuffer lfb(context, fbDownsamples[i]);
-			Context::LetViewport lv(context, 1 << (downsamplingPassesCount - 1 - i), 1 << (downsamplingPassesCount - 1 - i));
-			Context::LetUniformBuffer lub(context, ugDownsample);
-			const SamplerBase* sbSampler;
-			if(i <= downsamplingStepForBloom + 1)
-				sbSampler = &uDownsampleSourceSampler;
-			else
-				sbSampler = &uDownsampleLuminanceSourceSampler;
-			Context::LetSampler ls(context,
-				*sbSampler,
-				i == 0 ? rbScreen->GetTexture() : rbDownsamples[i - 1]->GetTexture(),
-				i == 0 ? ssLinear : ssPoint
-			);
-
-			Context::LetPixelShader lps(context,
-				i <= downsamplingStepForBloom ? psDownsample :
-				i == downsamplingStepForBloom + 1 ? psDownsampleLuminanceFirst :
-				psDownsampleLuminance
-			);
-
-			Context::LetBlendState lbs;
-			if(i == downsamplingPassesCount - 1)
-				lbs(context, bsLastDownsample);
-
-			if(veryFirstDownsampling || i < downsamplingPassesCount - 1)
-				context->ClearColor(0, vec4(0, 0, 0, 0));
-			context->Draw();
+			BeginPassStats(RenderStats::passDownsample);
+			Profiler::Scope profileScope(profiler, "downsample");
+			static bool veryFirstDownsampling = true;
+			uDownsampleBlend.Set(1.0f - exp(frameTime * (-0.79f)));
+			for(int i = 0; i < downsamplingPassesCount; ++i)
+			{
+				float halfSourcePixelWidth = 0.5f / (i == 0 ? screenWidth : (1 << (downsamplingPassesCount - i)));
+				float halfSourcePixelHeight = 0.5f / (i == 0 ? screenHeight : (1 << (downsamplingPassesCount - i)));
+				uDownsampleOffsets.Set(vec4(-halfSourcePixelWidth, halfSourcePixelWidth, -halfSourcePixelHeight, halfSourcePixelHeight));
+				UploadUniforms(ugDownsample);
+
+				Context::LetFrameBuffer lfb(context, fbDownsamples[i]);
+				Context::LetViewport lv(context, 1 << (downsamplingPassesCount - 1 - i), 1 << (downsamplingPassesCount - 1 - i));
+				Context::LetUniformBuffer lub(context, ugDownsample);
+				const SamplerBase* sbSampler;
+				if(i <= downsamplingStepForBloom + 1)
+					sbSampler = &uDownsampleSourceSampler;
+				else
+					sbSampler = &uDownsampleLuminanceSourceSampler;
+				Context::LetSampler ls(context,
+					*sbSampler,
+					i == 0 ? rbScreen->GetTexture() : rbDownsamples[i - 1]->GetTexture(),
+					i == 0 ? ssLinear : ssPoint
+				);
+				CountSamplerBinds(1);
+
+				Context::LetPixelShader lps(context, SwitchPixelShader(
+					i <= downsamplingStepForBloom ? psDownsample :
+					i == downsamplingStepForBloom + 1 ? psDownsampleLuminanceFirst :
+					psDownsampleLuminance));
+
+				Context::LetBlendState lbs;
+				if(i == downsamplingPassesCount - 1)
+					lbs(context, bsLastDownsample);
+
+				if(veryFirstDownsampling || i < downsamplingPassesCount - 1)
+					context->ClearColor(0, vec4(0, 0, 0, 0));
+				context->Draw();
+				CountDraw(ibFilter);
+			}
+			veryFirstDownsampling = false;
 		}
-		veryFirstDownsampling = false;
 
 		// bloom
 		{
+			BeginPassStats(RenderStats::passBloom);
+			Profiler::Scope profileScope(profiler, "bloom");
 			uBloomLimit.Set(bloomLimit);
-			ugBloom->Upload(context);
+			UploadUniforms(ugBloom);
 
 			const int bloomPassesCount = 5;
 
@@ -1302,32 +2332,40 @@ void Painter::Draw()
 				{
 					Context::LetFrameBuffer lfb(context, fbBloom2);
 					Context::LetSampler ls(context, uBloomSourceSampler, rbDownsamples[downsamplingStepForBloom]->GetTexture(), ssLinear);
-					Context::LetPixelShader lps(context, psBloomLimit);
+					CountSamplerBinds(1);
+					Context::LetPixelShader lps(context, SwitchPixelShader(psBloomLimit));
 					context->ClearColor(0, vec4(0, 0, 0, 0));
 					context->Draw();
+					CountDraw(ibFilter);
 				}
 				{
 					Context::LetFrameBuffer lfb(context, fbBloom1);
 					Context::LetSampler ls(context, uBloomSourceSampler, rbBloom2->GetTexture(), ssLinear);
-					Context::LetPixelShader lps(context, psBloom2);
+					CountSamplerBinds(1);
+					Context::LetPixelShader lps(context, SwitchPixelShader(psBloom2));
 					context->ClearColor(0, vec4(0, 0, 0, 0));
 					context->Draw();
+					CountDraw(ibFilter);
 				}
 				for(int i = 1; i < bloomPassesCount; ++i)
 				{
 					{
 						Context::LetFrameBuffer lfb(context, fbBloom2);
 						Context::LetSampler ls(context, uBloomSourceSampler, rbBloom1->GetTexture(), ssLinear);
-						Context::LetPixelShader lps(context, psBloom1);
+						CountSamplerBinds(1);
+						Context::LetPixelShader lps(context, SwitchPixelShader(psBloom1));
 						context->ClearColor(0, vec4(0, 0, 0, 0));
 						context->Draw();
+						CountDraw(ibFilter);
 					}
 					{
 						Context::LetFrameBuffer lfb(context, fbBloom1);
 						Context::LetSampler ls(context, uBloomSourceSampler, rbBloom2->GetTexture(), ssLinear);
-						Context::LetPixelShader lps(context, psBloom2);
+						CountSamplerBinds(1);
+						Context::LetPixelShader lps(context, SwitchPixelShader(psBloom2));
 						context->ClearColor(0, vec4(0, 0, 0, 0));
 						context->Draw();
+						CountDraw(ibFilter);
 					}
 				}
 			}
@@ -1335,28 +2373,48 @@ void Painter::Draw()
 			{
 				Context::LetFrameBuffer lfb(context, fbBloom1);
 				Context::LetSampler ls(context, uBloomSourceSampler, rbBloom2->GetTexture(), ssLinear);
-				Context::LetPixelShader lps(context, psBloom2);
+				CountSamplerBinds(1);
+				Context::LetPixelShader lps(context, SwitchPixelShader(psBloom2));
 				context->ClearColor(0, vec4(0, 0, 0, 0));
 			}
 		}
 
 		// tone mapping
 		{
+			BeginPassStats(RenderStats::passTone);
+			Profiler::Scope profileScope(profiler, "tone");
 			Context::LetFrameBuffer lfb(context, presenter->GetFrameBuffer());
 			Context::LetViewport lv(context, screenWidth, screenHeight);
 			Context::LetSampler lsBloom(context, uToneBloomSampler, rbBloom1->GetTexture(), ssLinear);
 			Context::LetSampler lsScreen(context, uToneScreenSampler, rbScreen->GetTexture(), ssPoint);
 			Context::LetSampler lsAverage(context, uToneAverageSampler, rbDownsamples[downsamplingPassesCount - 1]->GetTexture(), ssPoint);
+			CountSamplerBinds(3);
 
 			uToneLuminanceKey.Set(toneLuminanceKey);
 			uToneMaxLuminance.Set(toneMaxLuminance);
-			ugTone->Upload(context);
+			UploadUniforms(ugTone);
 			Context::LetUniformBuffer lub(context, ugTone);
 
-			Context::LetPixelShader lps(context, psTone);
+			Context::LetPixelShader lps(context, SwitchPixelShader(psTone));
 
 			context->ClearColor(0, vec4(0, 0, 0, 0));
 			context->Draw();
+			CountDraw(ibFilter);
 		}
 	} // postprocessing
 }
+
+int Painter::GetCulledObjectsCount() const
+{
+	return culledObjectsCount;
+}
+
+int Painter::GetDrawnObjectsCount() const
+{
+	return drawnObjectsCount;
+}
+
+const RenderStats& Painter::GetStats() const
+{
+	return stats;
+}
@@ -4,10 +4,17 @@
 #include "general.hpp"
 #include "Geometry.hpp"
 #include "Material.hpp"
+#include "Culling.hpp"
+#include "DrawKeys.hpp"
+#include "Registry.hpp"
+#include "FrameArena.hpp"
+#include "RenderStats.hpp"
 #include <unordered_map>
 
 class BoneAnimationFrame;
 class GeometryFormats;
+class JobSystem;
+class Profiler;
 
 /// Класс, занимающийся рисованием моделей.
 class Painter : public Object
@@ -65,7 +72,8 @@ private:
 		/// Instanced?
 		bool instanced;
 		/// Скиннинг?
-		/** Только при instanced=false. */
+		/** Только при instanced=true: кости берутся из палитры
+		по смещению экземпляра. */
 		bool skinned;
 
 		VertexShaderKey(bool instanced, bool skinned);
@@ -106,6 +114,10 @@ private:
 	ptr<ShaderCache> shaderCache;
 	/// Форматы геометрии.
 	ptr<GeometryFormats> geometryFormats;
+	/// Планировщик задач для подготовки кадра.
+	ptr<JobSystem> jobSystem;
+	/// Профайлер кадра.
+	ptr<Profiler> profiler;
 
 	/// Текстура background.
 	ptr<Texture> backgroundTexture;
@@ -114,24 +126,39 @@ private:
 	static const int maxBasicLightsCount = 4;
 	/// Максимальное количество источников света с тенями.
 	static const int maxShadowLightsCount = 4;
-	/// Количество для instancing'а.
-	static const int maxInstancesCount = 32;
-	/// Количество костей для skinning.
-	static const int maxBonesCount = 64;
+	static_assert(maxShadowLightsCount <= RenderStats::shadowPassesCount, "Not enough shadow passes in render stats");
+	/// Ёмкость буфера экземпляров (в экземплярах).
+	/** Столько экземпляров рисуется за один вызов. */
+	static const int instanceBufferCapacity = 16384;
+	/// Размер страницы палитры костей (в vec4, по два на кость).
+	/** Страница - один uniform-буфер (64 Кб, предел константного буфера D3D11);
+	экземпляры одной страницы рисуются одним вызовом. */
+	static const int bonePaletteCapacity = 4096;
 
 	//*** Атрибуты.
 	ptr<AttributeBinding> ab;
-	ptr<Instancer> instancer;
-	ptr<AttributeBinding> abInstanced;
 	Value<vec3> aPosition;
 	Value<vec3> aNormal;
 	Value<vec2> aTexcoord;
+	ptr<AttributeBinding> abInstanced;
+	/// Динамический буфер данных экземпляров (слот 1).
+	ptr<VertexBuffer> vbInstances;
+	Value<vec3> aInstancedPosition;
+	Value<vec3> aInstancedNormal;
+	Value<vec2> aInstancedTexcoord;
+	/// Строки матрицы мира экземпляра.
+	Value<vec4> aInstanceWorld0;
+	Value<vec4> aInstanceWorld1;
+	Value<vec4> aInstanceWorld2;
 	ptr<AttributeBinding> abSkinned;
 	Value<vec3> aSkinnedPosition;
 	Value<vec3> aSkinnedNormal;
 	Value<vec2> aSkinnedTexcoord;
 	Value<uvec4> aSkinnedBoneNumbers;
 	Value<vec4> aSkinnedBoneWeights;
+	/// Динамический буфер данных skinned-экземпляров (слот 1).
+	ptr<VertexBuffer> vbSkinnedInstances;
+	Value<vec4> aSkinnedPaletteOffset;
 
 	///*** Uniform-группа камеры.
 	ptr<UniformGroup> ugCamera;
@@ -167,22 +194,47 @@ private:
 	/// Семплер текстуры background.
 	Sampler<vec3, 2> uBackgroundSampler;
 
+	/// Получить uniform-буфер материала, залив его при необходимости.
+	UniformBuffer* GetMaterialUniformBuffer(Material* material);
+
+	/// Установщик материалов в цикле рисования.
+	/** Держит привязки буфера материала и текстур, пока жив.
+	Буфер материала не перезаливается, если материал не менялся,
+	а текстуры не перепривязываются, если совпадают с предыдущими.
+	Привязки хранятся по значению и переустанавливаются на месте,
+	без выделения памяти. */
+	class MaterialBinder
+	{
+	private:
+		Painter* painter;
+		Context::LetUniformBuffer lubMaterial;
+		Context::LetSampler lsDiffuse;
+		Context::LetSampler lsSpecular;
+		Context::LetSampler lsNormal;
+		Material* boundMaterial;
+		Texture* boundDiffuseTexture;
+		Texture* boundSpecularTexture;
+		Texture* boundNormalTexture;
+
+	public:
+		MaterialBinder(Painter* painter);
+		MaterialBinder(const MaterialBinder&) = delete;
+		MaterialBinder& operator=(const MaterialBinder&) = delete;
+
+		/// Установить материал.
+		void Bind(Material* material);
+	};
+
 	///*** Uniform-группа модели.
 	ptr<UniformGroup> ugModel;
 	/// Матрица мира.
 	Uniform<mat4x4> uWorld;
 
-	///*** Uniform-группа instanced-модели.
-	ptr<UniformGroup> ugInstancedModel;
-	/// Матрицы мира.
-	UniformArray<mat4x4> uWorlds;
-
-	///*** Uniform-группа skinned-модели.
-	ptr<UniformGroup> ugSkinnedModel;
-	/// Кватернионы костей.
-	UniformArray<vec4> uBoneOrientations;
-	/// Смещения костей.
-	UniformArray<vec4> uBoneOffsets;
+	///*** Uniform-группа палитры костей.
+	/** Задаёт только раскладку; данные заливаются в буферы страниц. */
+	ptr<UniformGroup> ugBonePalette;
+	/// Кватернион и смещение каждой кости подряд.
+	UniformArray<vec4> uBonePalette;
 
 	///*** Uniform-группа размытия тени.
 	ptr<UniformGroup> ugShadowBlur;
@@ -247,8 +299,13 @@ private:
 
 	ptr<BlendState> bsTransparent;
 	ptr<BlendState> bsLastDownsample;
+	/// Blend state, оставляющий цвет без изменений (для прохода глубины).
+	ptr<BlendState> bsNoColor;
 
 	ptr<PixelShader> psShadow;
+	/// Пиксельный шейдер предварительного прохода глубины.
+	/** Цвет отбрасывается bsNoColor, шейдер только даёт конвейеру выход. */
+	ptr<PixelShader> psDepthOnly;
 
 	/// Размер карты теней.
 	static const int shadowMapSize;
@@ -282,6 +339,8 @@ private:
 	ptr<DepthStencilState> dssNormal;
 	/// Depth-stencil для полноэкранных эффектов.
 	ptr<DepthStencilState> dssFull;
+	/// Depth-stencil для освещения после предварительного прохода глубины.
+	ptr<DepthStencilState> dssEqual;
 	/// Карты теней.
 	ptr<RenderBuffer> rbShadows[maxShadowLightsCount];
 	/// Фреймбуферы для карт теней.
@@ -344,33 +403,315 @@ private:
 	mat4x4 cameraViewProj;
 	mat4x4 cameraInvViewProj;
 	vec3 cameraPosition;
+	/// Масштаб проекции камеры по вертикали (для размера на экране).
+	float cameraProjectionScale;
+
+	/// Номер материала в реестре.
+	typedef uint32_t MaterialHandle;
+	/// Номер геометрии в реестре.
+	typedef uint32_t GeometryHandle;
+	/// Зарегистрированные материалы и геометрии.
+	/** Элементы рисования ссылаются на них по номерам, поэтому
+	регистрация моделей не трогает счётчики ссылок. Всё, что хоть раз
+	передано в Painter, живёт, пока жив Painter (материалы и геометрия -
+	ресурсы игры и живут столько же). */
+	Registry<Material, drawKeyMaterialsCount> materials;
+	// в ключе рисования номер геометрии делит поле с уровнем детализации
+	Registry<Geometry, drawKeyGeometriesCount / Geometry::maxLodsCount> geometries;
+
+	/// Память кадра для элементов рисования, сбрасывается в BeginFrame.
+	FrameArena frameArena;
 
 	/// Модель для рисования.
 	struct Model
 	{
-		ptr<Material> material;
-		ptr<Geometry> geometry;
+		MaterialHandle material;
+		GeometryHandle geometry;
 		mat4x4 worldTransform;
 
-		Model(ptr<Material> material, ptr<Geometry> geometry, const mat4x4& worldTransform);
+		Model(MaterialHandle material, GeometryHandle geometry, const mat4x4& worldTransform);
 	};
-	std::vector<Model> models;
+	FrameArray<Model> models;
+
+	/// Статические модели.
+	/** Регистрируются один раз и не очищаются в BeginFrame. */
+	std::vector<Model> staticModels;
+	/// Батч статических моделей с одинаковыми материалом и геометрией.
+	struct StaticBatch
+	{
+		MaterialHandle material;
+		GeometryHandle geometry;
+		/// Диапазон моделей батча в staticModels.
+		int first;
+		int count;
+		/// Статический буфер экземпляров со всеми моделями батча.
+		ptr<VertexBuffer> instanceBuffer;
+
+		StaticBatch(MaterialHandle material, GeometryHandle geometry, int first);
+	};
+	/// Батчи статических моделей, отсортированные по материалу и геометрии.
+	std::vector<StaticBatch> staticBatches;
+	/// Упакованные матрицы мира статических моделей (в порядке staticModels).
+	std::vector<mat4x4> staticWorldTransforms;
+	/// Номера батчей статических моделей.
+	std::vector<int> staticModelBatches;
+	/// Ограничивающие объёмы статических моделей в мире.
+	std::vector<BoundingBox> staticBoundingBoxes;
+	/// Иерархия объёмов статических моделей.
+	BoundingVolumeHierarchy staticHierarchy;
+	/// Нужно ли перестроить батчи статических моделей.
+	bool staticBatchesDirty;
+	/// Перестроить батчи статических моделей, если нужно.
+	void UpdateStaticBatches();
 
 	/// Полупрозрачные модели для рисования.
-	std::vector<Model> transparentModels;
+	FrameArray<Model> transparentModels;
+
+	/// Ограничивающие объёмы динамических моделей в мире.
+	std::vector<BoundingBox> modelBoundingBoxes;
+	/// Иерархия объёмов динамических моделей.
+	/** Перестраивается при изменении количества моделей, а в остальных
+	кадрах только пересчитывается (Refit), так как порядок регистрации
+	динамических моделей от кадра к кадру обычно не меняется. */
+	BoundingVolumeHierarchy modelHierarchy;
+	/// Количество кадров с последнего перестроения иерархии.
+	int modelHierarchyAge;
+	/// Обновить иерархию динамических моделей.
+	void UpdateModelHierarchy();
+
+	/// Видимые в проходе объекты.
+	struct VisibleSet
+	{
+		/// Номера видимых статических моделей, сгруппированные по батчам.
+		/** После отсечения идут по возрастанию; в виде камеры батчи затем
+		упорядочиваются по ключам рисования, а модели внутри батча - по уровням
+		детализации и грубо спереди назад. */
+		std::vector<int> staticModels;
+		/// Номера видимых динамических моделей.
+		std::vector<int> models;
+		/// Номера видимых полупрозрачных моделей.
+		std::vector<int> transparentModels;
+		/// Номера видимых skinned-моделей.
+		std::vector<int> skinnedModels;
+	};
+	/// Вид, для которого готовится очередь рисования.
+	/** Камера или источник света с тенью. Виды готовятся параллельно
+	(отсечение, ключи, сортировка, упаковка экземпляров), а рисуются
+	потом однопоточно в фиксированном порядке. */
+	struct View
+	{
+		mat4x4 viewProj;
+		/// drawPassShadow для источника света, drawPassOpaque для камеры.
+		DrawPass pass;
+		VisibleSet visibleSet;
+		/// Упакованные экземпляры видимых моделей, в порядке visibleSet.
+		std::vector<vec4> modelInstances;
+		std::vector<vec4> transparentInstances;
+		/// Смещения видимых skinned-моделей в страницах палитры, в порядке visibleSet.
+		std::vector<vec4> skinnedInstances;
+		/// Уровни детализации геометрии видимых моделей, в порядке visibleSet.
+		/** Модели с одной геометрией идут подряд по уровням, так что
+		каждый уровень рисуется своим вызовом. */
+		std::vector<unsigned char> modelLods;
+		std::vector<unsigned char> transparentLods;
+		std::vector<unsigned char> skinnedLods;
+		std::vector<unsigned char> staticLods;
+		/// Временный массив для упорядочивания статических моделей.
+		std::vector<int> staticModelsTemp;
+		/// Начала групп видимых моделей батчей в порядке рисования.
+		std::vector<int> staticBatchStarts;
+		/// Упакованные экземпляры видимых статических моделей.
+		/** Заполняются только для батчей, видимых не целиком. */
+		std::vector<vec4> staticInstances;
+		/// Элементы очереди для сортировки по ключам.
+		std::vector<DrawItem> drawItems, drawItemsTemp;
+		/// Флаги видимости динамических моделей (для теневых видов).
+		std::vector<unsigned char> visibleModelsMask;
+		/// Флаги видимости skinned-моделей (для теневых видов).
+		std::vector<unsigned char> visibleSkinnedModelsMask;
+		int culledObjectsCount;
+		int drawnObjectsCount;
+	};
+	/// Виды кадра: сначала теневые источники света по порядку, затем камера.
+	std::vector<View> views;
+
+	/// Подготовить кадр: обновить иерархии и подготовить все виды.
+	void Prepare();
+	/// Подготовить вид. Может выполняться в любом потоке.
+	void PrepareView(View& view);
+	/// Выполнить отсечение по пирамиде видимости вида.
+	/** Полупрозрачные модели проверяются только для камеры. В теневых
+	видах остаются только отбрасывающие тень модели. */
+	void Cull(View& view);
+	/// Отсортировать элементы очереди по ключам и записать номера.
+	static void SortDrawItems(std::vector<DrawItem>& items, std::vector<DrawItem>& temp, std::vector<int>& numbers);
+	/// Отсортировать номера моделей по ключам рисования для прохода камеры.
+	/** Глубина считается по положению модели в пространстве вида. */
+	void SortModelNumbers(View& view, std::vector<int>& modelNumbers, const FrameArray<Model>& models, const std::vector<unsigned char>& lods, DrawPass pass);
+	/// Отсортировать номера skinned-моделей по ключам рисования для прохода камеры.
+	void SortSkinnedModelNumbers(View& view, std::vector<int>& modelNumbers);
+
+	/// На сколько уровней детализации геометрии грубее рисуются тени.
+	int shadowLodBias;
+	/// Уровни детализации геометрии моделей кадра для камеры.
+	/** Выбираются один раз за кадр по размеру на экране камеры; теневые
+	виды берут уровень грубее на shadowLodBias. */
+	std::vector<unsigned char> modelLods;
+	std::vector<unsigned char> transparentModelLods;
+	/// Уровни skinned-моделей, по два на модель: основной и теневой геометрии.
+	std::vector<unsigned char> skinnedModelLods;
+	/// Ограничивающие сферы skinned-моделей в мире для отсечения.
+	/** По две на модель, как уровни; считаются вместе с уровнями по корневой кости. */
+	std::vector<BoundingSphere> skinnedBoundingSpheres;
+	/// Получить размер ограничивающей сферы на экране камеры.
+	float GetScreenSize(const vec3& center, float radius) const;
+	/// Выбрать уровень детализации геометрии модели для камеры.
+	int SelectModelLod(GeometryHandle geometryHandle, const mat4x4& worldTransform) const;
+	/// Получить уровень детализации геометрии для теневых видов.
+	int GetShadowLod(GeometryHandle geometryHandle, int lod) const;
+	/// Получить номер геометрии с уровнем детализации для ключа рисования.
+	static uint32_t GetLodDrawId(GeometryHandle geometryHandle, int lod);
+	/// Выбрать уровни детализации моделей кадра.
+	void SelectLods();
+	/// Записать уровни детализации видимых моделей вида.
+	void FillViewLods(View& view);
+
+	/// Отбрасывающие тень динамические модели, отсортированные по геометрии.
+	/** Строится один раз за кадр; теневые виды только фильтруют его
+	по видимости, сохраняя порядок. */
+	std::vector<int> shadowCasters;
+	/// Отбрасывающие тень skinned-модели, отсортированные по геометрии.
+	std::vector<int> skinnedShadowCasters;
+	/// Элементы для сортировки списков отбрасывающих тень моделей.
+	std::vector<DrawItem> shadowCasterItems, shadowCasterItemsTemp;
+	/// Построить списки отбрасывающих тень моделей.
+	void BuildShadowCasters();
+	/// Упаковать экземпляры моделей по номерам.
+	void PackModelInstances(std::vector<vec4>& instances, const std::vector<int>& modelNumbers, const FrameArray<Model>& models);
+	/// Получить глубину статической модели в виде.
+	float GetStaticModelDepth(const View& view, int modelNumber) const;
+	/// Упорядочить видимые статические батчи вида по ключам рисования.
+	/** Внутри материала батчи идут грубо спереди назад по ближайшей видимой модели. */
+	void SortStaticBatches(View& view);
+	/// Упаковать экземпляры видимых статических моделей из не целиком видимых батчей.
+	void PackStaticInstances(View& view);
+	/// Получить конец группы видимых статических моделей одного батча.
+	size_t GetStaticBatchEnd(const View& view, size_t begin) const;
+	/// Рисуется ли видимая часть статического батча из готового буфера экземпляров.
+	/** Да, если батч виден целиком одним уровнем детализации. */
+	bool IsStaticBatchPrebuilt(const View& view, size_t begin, size_t end) const;
+	/// Нарисовать видимую часть статического батча.
+	/** Вершинный буфер геометрии должен быть уже установлен. */
+	void DrawStaticBatch(const View& view, size_t begin, size_t end);
+	/// Отправить подготовленные виды на рисование.
+	void Submit();
+	/// Палитра костей кадра: позы всех skinned-моделей, постранично.
+	std::vector<vec4> bonePalette;
+	/// Смещения skinned-моделей в палитре.
+	/** Модель целиком лежит в одной странице. */
+	std::vector<int> skinnedPaletteOffsets;
+	/// Uniform-буферы страниц палитры.
+	std::vector<ptr<UniformBuffer> > bonePaletteBuffers;
+	/// Упаковать позы skinned-моделей в палитру.
+	void PackBonePalette();
+	/// Упаковать смещения видимых skinned-моделей вида.
+	void PackSkinnedInstances(View& view);
+	/// Залить страницы палитры в GPU.
+	void UploadBonePalette();
+	/// Нарисовать инстансингом видимые skinned-модели вида с одной геометрией.
+	/** Разбивается на вызовы по страницам палитры. Геометрия и шейдеры
+	должны быть уже установлены; indexBuffer нужен для статистики. */
+	void DrawSkinnedInstanced(IndexBuffer* indexBuffer, const View& view, size_t begin, size_t end);
+
+	/// Включён ли CPU-скиннинг.
+	/** Вершины skinned-моделей преобразуются один раз за кадр и рисуются
+	во всех проходах шейдерами instanced-моделей с единичной матрицей мира. */
+	bool preSkinning;
+	/// Геометрия skinned-модели после CPU-скиннинга.
+	struct PreSkinnedGeometry
+	{
+		/// Номер skinned-модели.
+		int modelNumber;
+		GeometryHandle geometry;
+		/// Исходные вершины skinned-формата.
+		/** Берутся из файла геометрии заранее, чтобы задачи скиннинга
+		не копировали ptr<File> (счётчик ссылок не атомарный). */
+		const void* sourceVertices;
+		/// Смещение вершин в preSkinnedVertices.
+		int verticesOffset;
+		int verticesCount;
+	};
+	/// Геометрии кадра после CPU-скиннинга.
+	std::vector<PreSkinnedGeometry> preSkinnedGeometries;
+	/// Номера геометрий после CPU-скиннинга по skinned-моделям.
+	/** По два на модель: основная и теневая (-1, если модель не отбрасывает тень). */
+	std::vector<int> skinnedPreSkinnedGeometries;
+	/// Вершины после CPU-скиннинга, в обычном формате.
+	std::vector<char> preSkinnedVertices;
+	/// Динамический вершинный буфер для геометрии после CPU-скиннинга.
+	struct PreSkinnedBuffer
+	{
+		ptr<VertexBuffer> vertexBuffer;
+		/// Ёмкость в вершинах.
+		int capacity;
+
+		PreSkinnedBuffer();
+	};
+	std::vector<PreSkinnedBuffer> preSkinnedBuffers;
+	/// Данные экземпляра с единичной матрицей мира.
+	vec4 identityInstance[3];
+	/// Выполнить CPU-скиннинг skinned-моделей кадра.
+	void PreSkin();
+	/// Залить вершины после CPU-скиннинга в GPU.
+	void UploadPreSkinnedVertices();
+	/// Нарисовать геометрию после CPU-скиннинга.
+	/** Привязка атрибутов и вершинный шейдер instanced-моделей должны быть
+	уже установлены. */
+	void DrawPreSkinned(int preSkinnedGeometry, int lod);
+	/// Нарисовать видимые модели вида теневыми вершинными шейдерами.
+	/** Для карт теней (shadow) и предварительного прохода глубины.
+	Пиксельный шейдер должен быть уже установлен. */
+	void DrawDepthOnly(const View& view, bool shadow);
+
+	/// Включён ли предварительный проход глубины.
+	bool depthPrePass;
+
+	/// Статистика рисования последнего кадра.
+	RenderStats stats;
+	/// Счётчики текущего прохода.
+	PassStats* passStats;
+	/// Последний установленный пиксельный шейдер, для подсчёта смен.
+	PixelShader* lastPixelShader;
+	/// Начать учёт статистики прохода.
+	void BeginPassStats(RenderStats::Pass pass);
+	/// Учесть вызов рисования геометрии с данным индексным буфером.
+	void CountDraw(IndexBuffer* indexBuffer, int instancesCount = 1);
+	/// Учесть привязки текстур.
+	void CountSamplerBinds(int count);
+	/// Залить uniform-группу с учётом в статистике.
+	void UploadUniforms(UniformGroup* uniformGroup);
+	/// Учесть смену пиксельного шейдера.
+	/** Возвращает тот же шейдер, для использования в Context::LetPixelShader. */
+	PixelShader* SwitchPixelShader(PixelShader* pixelShader);
+
+	/// Количество отсечённых объектов за кадр (по всем проходам).
+	int culledObjectsCount;
+	/// Количество нарисованных объектов за кадр (по всем проходам).
+	int drawnObjectsCount;
 
 	/// Skinned модель для рисования.
 	struct SkinnedModel
 	{
-		ptr<Material> material;
-		ptr<Geometry> geometry;
-		ptr<Geometry> shadowGeometry;
+		MaterialHandle material;
+		GeometryHandle geometry;
+		GeometryHandle shadowGeometry;
 		/// Настроенный кадр анимации.
-		ptr<BoneAnimationFrame> animationFrame;
+		/** Ссылка не держится, кадр должен жить до конца рисования. */
+		BoneAnimationFrame* animationFrame;
 
-		SkinnedModel(ptr<Material> material, ptr<Geometry> geometry, ptr<Geometry> shadowGeometry, ptr<BoneAnimationFrame> animationFrame);
+		SkinnedModel(MaterialHandle material, GeometryHandle geometry, GeometryHandle shadowGeometry, BoneAnimationFrame* animationFrame);
 	};
-	std::vector<SkinnedModel> skinnedModels;
+	FrameArray<SkinnedModel> skinnedModels;
 
 	// Источники света.
 	/// Рассеянный свет.
@@ -391,13 +732,25 @@ private:
 	// Параметры постпроцессинга.
 	float bloomLimit, toneLuminanceKey, toneMaxLuminance;
 
+	/// Нарисовать инстансингом упакованные экземпляры.
+	/** Данные заливаются в буфер экземпляров. Геометрия и шейдеры должны
+	быть уже установлены; indexBuffer нужен для статистики. */
+	void DrawInstanced(IndexBuffer* indexBuffer, const vec4* instances, int count);
+	/// Упаковать матрицу мира в данные экземпляра (три строки).
+	static void PackInstance(vec4* data, const mat4x4& worldTransform);
+	/// Временный буфер данных экземпляров.
+	std::vector<vec4> instanceData;
+
 	/// Сгенерировать вершинный шейдер.
 	ptr<VertexShader> GenerateVS(Expression expression);
 	/// Сгенерировать пиксельный шейдер.
 	ptr<PixelShader> GeneratePS(Expression expression);
 
 public:
-	Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats);
+	/// Создать рисователь.
+	/** Без устройства (device = nullptr, для бенчмарков) графические ресурсы
+	не создаются, и Draw только готовит кадр: отсечение, сортировку и упаковку. */
+	Painter(ptr<Device> device, ptr<Context> context, ptr<Presenter> presenter, ptr<ShaderCache> shaderCache, ptr<GeometryFormats> geometryFormats, ptr<JobSystem> jobSystem, ptr<Profiler> profiler);
 
 	void Resize(int screenWidth, int screenHeight);
 
@@ -407,12 +760,20 @@ public:
 	/// Установить камеру.
 	void SetCamera(const mat4x4& cameraViewProj, const vec3& cameraPosition);
 	/// Зарегистрировать модель.
-	void AddModel(ptr<Material> material, ptr<Geometry> geometry, const mat4x4& worldTransform);
+	/** Материал и геометрия запоминаются в реестрах при первом использовании. */
+	void AddModel(Material* material, Geometry* geometry, const mat4x4& worldTransform);
+	/// Зарегистрировать статическую модель.
+	/** В отличие от AddModel, модель остаётся зарегистрированной между кадрами. */
+	void AddStaticModel(Material* material, Geometry* geometry, const mat4x4& worldTransform);
+	/// Удалить все статические модели.
+	void ClearStaticModels();
 	/// Зарегистрировать полупрозрачную модель.
-	void AddTransparentModel(ptr<Material> material, ptr<Geometry> geometry, const mat4x4& worldTransform);
+	void AddTransparentModel(Material* material, Geometry* geometry, const mat4x4& worldTransform);
 	/// Зарегистрировать skinned-модель.
-	void AddSkinnedModel(ptr<Material> material, ptr<Geometry> geometry, ptr<BoneAnimationFrame> animationFrame);
-	void AddSkinnedModel(ptr<Material> material, ptr<Geometry> geometry, ptr<Geometry> shadowGeometry, ptr<BoneAnimationFrame> animationFrame);
+	/** Кадр анимации должен жить до конца Draw. Все номера костей в вершинах
+	геометрий должны быть меньше количества костей кадра, иначе бросается исключение. */
+	void AddSkinnedModel(Material* material, Geometry* geometry, BoneAnimationFrame* animationFrame);
+	void AddSkinnedModel(Material* material, Geometry* geometry, Geometry* shadowGeometry, BoneAnimationFrame* animationFrame);
 	/// Установить рассеянный свет.
 	void SetAmbientColor(const vec3& ambientColor);
 	/// Установить текстуру background.
@@ -422,11 +783,30 @@ public:
 	/// Зарегистрировать источник света с тенью.
 	void AddShadowLight(const vec3& position, const vec3& color, const mat4x4& transform);
 
+	/// Включить или выключить предварительный проход глубины.
+	/** Непрозрачные модели сначала рисуются только в буфер глубины,
+	а затем освещаются с проверкой на равенство глубины. */
+	void SetDepthPrePass(bool depthPrePass);
+	/// Включить или выключить CPU-скиннинг.
+	void SetPreSkinning(bool preSkinning);
+	/// Задать, на сколько уровней детализации геометрии грубее рисуются тени.
+	/** Уровень выбирается по размеру модели на экране камеры. */
+	void SetShadowLodBias(int shadowLodBias);
+
 	/// Установить параметры постпроцессинга.
 	void SetupPostprocess(float bloomLimit, float toneLuminanceKey, float toneMaxLuminance);
 
 	/// Выполнить рисование.
+	/** Подготовка кадра выполняется параллельно в планировщике задач,
+	а работа с контекстом - в вызывающем потоке. */
 	void Draw();
+
+	/// Получить количество отсечённых объектов за последний кадр.
+	int GetCulledObjectsCount() const;
+	/// Получить количество нарисованных объектов за последний кадр.
+	int GetDrawnObjectsCount() const;
+	/// Получить статистику рисования за последний кадр.
+	const RenderStats& GetStats() const;
 };
 
 #endif
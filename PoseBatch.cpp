@@ -0,0 +1,82 @@
+#include "PoseBatch.hpp"
+#include "BoneAnimation.hpp"
+#include "PoseCache.hpp"
+#include "AnimationLod.hpp"
+#include "JobSystem.hpp"
+
+void PoseBatch::Add(BoneAnimationFrame* frame, const vec3& originOffset, const quat& originOrientation, float time, bool looped)
+{
+	Add(frame, originOffset, originOrientation, time, looped, vec3(0, 0, 0), 0);
+}
+
+void PoseBatch::Add(BoneAnimationFrame* frame, const vec3& originOffset, const quat& originOrientation, float time, bool looped, const vec3& center, float radius)
+{
+	Request request;
+	request.frame = frame;
+	request.originOffset = originOffset;
+	request.originOrientation = originOrientation;
+	request.time = time;
+	request.looped = looped;
+	request.center = center;
+	request.radius = radius;
+	requests.push_back(request);
+}
+
+int PoseBatch::GetRequestsCount() const
+{
+	return (int)requests.size();
+}
+
+void PoseBatch::Run(JobSystem* jobSystem, PoseCache* poseCache, AnimationLod* animationLod)
+{
+	int requestsCount = (int)requests.size();
+
+	// однопоточно: детализация, запросы к кэшу поз и разбиение на куски
+	setups.resize(requestsCount);
+	chunkStarts.clear();
+	int chunkBones = 0;
+	for(int i = 0; i < requestsCount; ++i)
+	{
+		const Request& request = requests[i];
+		Setup& setup = setups[i];
+		setup.cachedPose = nullptr;
+		setup.updateInterval = 0;
+		setup.boneLevelsCount = -1;
+
+		if(animationLod && request.radius > 0)
+			animationLod->SelectSetupParameters(request.center, request.radius, setup.updateInterval, setup.boneLevelsCount);
+		// кэш поз хранит только позы полной детализации
+		if(poseCache && setup.updateInterval <= 0 && setup.boneLevelsCount < 0)
+		{
+			BoneAnimation* animation = request.frame->animation;
+			setup.cachedPose = poseCache->RequestPose(animation, request.looped ? animation->WrapTime(request.time) : request.time);
+		}
+
+		if(!chunkBones)
+			chunkStarts.push_back(i);
+		chunkBones += (int)request.frame->orientations.size();
+		if(chunkBones >= chunkBonesCount)
+			chunkBones = 0;
+	}
+	chunkStarts.push_back(requestsCount);
+
+	// новые позы кэша нужны до применения начал координат
+	if(poseCache)
+		poseCache->ComputePendingPoses(jobSystem);
+
+	// кадры независимы, куски берутся потоками по одному
+	jobSystem->ParallelFor((int)chunkStarts.size() - 1, 1, [this](int begin, int end)
+	{
+		for(int i = chunkStarts[begin]; i < chunkStarts[end]; ++i)
+		{
+			const Request& request = requests[i];
+			const Setup& setup = setups[i];
+			if(setup.cachedPose)
+				request.frame->ApplyOrigin(request.originOffset, request.originOrientation, setup.cachedPose);
+			else
+				request.frame->SetupLod(request.originOffset, request.originOrientation, request.time, request.looped, setup.updateInterval, setup.boneLevelsCount);
+		}
+	});
+
+	requests.clear();
+}
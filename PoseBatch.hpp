@@ -0,0 +1,66 @@
+#ifndef ___BANSHEE_POSE_BATCH_HPP___
+#define ___BANSHEE_POSE_BATCH_HPP___
+
+#include "general.hpp"
+
+class BoneAnimationFrame;
+class JobSystem;
+class PoseCache;
+class AnimationLod;
+
+/// Пакетный расчёт кадров анимации.
+/** Запросы копятся за кадр однопоточно и рассчитываются все вместе в Run.
+Однопоточно выбираются уровни детализации и запрашиваются позы из кэша;
+затем новые позы кэша и сами кадры рассчитываются параллельно. Запросы
+делятся на куски примерно равной стоимости (по количеству костей), так что
+скелеты разных размеров распределяются по потокам равномерно. Разбиение
+не зависит от количества потоков. Кадр должен встречаться в пакете один раз. */
+class PoseBatch : public Object
+{
+public:
+	/// Запрос на расчёт кадра.
+	struct Request
+	{
+		BoneAnimationFrame* frame;
+		vec3 originOffset;
+		quat originOrientation;
+		float time;
+		bool looped;
+		/// Ограничивающая сфера для выбора детализации; радиус 0 - полная детализация.
+		vec3 center;
+		float radius;
+	};
+
+private:
+	/// Примерная стоимость куска, в костях.
+	static const int chunkBonesCount = 2048;
+
+	std::vector<Request> requests;
+
+	/// Параметры расчёта запросов, выбранные однопоточно.
+	struct Setup
+	{
+		/// Поза в системе модели из кэша (или nullptr).
+		const BoneAnimationFrame* cachedPose;
+		float updateInterval;
+		int boneLevelsCount;
+	};
+	std::vector<Setup> setups;
+	/// Начала кусков в запросах, последний элемент - количество запросов.
+	std::vector<int> chunkStarts;
+
+public:
+	/// Добавить запрос.
+	/** Кадр не удерживается и должен жить до Run. */
+	void Add(BoneAnimationFrame* frame, const vec3& originOffset, const quat& originOrientation, float time, bool looped);
+	/// Добавить запрос с выбором детализации по ограничивающей сфере.
+	void Add(BoneAnimationFrame* frame, const vec3& originOffset, const quat& originOrientation, float time, bool looped, const vec3& center, float radius);
+	int GetRequestsCount() const;
+
+	/// Рассчитать все запросы и очистить пакет.
+	/** Кэш поз используется для запросов полной детализации; уровни детализации -
+	для запросов с ограничивающей сферой. Оба могут быть nullptr. */
+	void Run(JobSystem* jobSystem, PoseCache* poseCache, AnimationLod* animationLod);
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "PoseCache.hpp"
+#include "BoneAnimation.hpp"
+#include "JobSystem.hpp"
+
+//*** PoseCache::Key
+
+bool PoseCache::Key::operator==(const Key& other) const
+{
+	return animation == other.animation && timeIndex == other.timeIndex;
+}
+
+size_t PoseCache::KeyHash::operator()(const Key& key) const
+{
+	return std::hash<BoneAnimation*>()(key.animation) ^ (std::hash<int>()(key.timeIndex) * 0x9E3779B9u);
+}
+
+//*** PoseCache::FramePool
+
+PoseCache::FramePool::FramePool() : usedCount(0) {}
+
+//*** PoseCache
+
+PoseCache::PoseCache(float timeStep) : timeStep(timeStep), hitsCount(0), missesCount(0) {}
+
+void PoseCache::SetTimeStep(float timeStep)
+{
+	this->timeStep = timeStep;
+	poses.clear();
+}
+
+float PoseCache::GetTimeStep() const
+{
+	return timeStep;
+}
+
+void PoseCache::BeginFrame()
+{
+	poses.clear();
+	pendingPoses.clear();
+	for(std::unordered_map<BoneAnimation*, FramePool>::iterator i = framePools.begin(); i != framePools.end(); ++i)
+		i->second.usedCount = 0;
+	hitsCount = 0;
+	missesCount = 0;
+}
+
+void PoseCache::Clear()
+{
+	poses.clear();
+	framePools.clear();
+	pendingPoses.clear();
+}
+
+BoneAnimationFrame* PoseCache::FindOrAdd(BoneAnimation* animation, float time, bool& added, float& poseTime)
+{
+	Key key;
+	key.animation = animation;
+	key.timeIndex = (int)floor(time / timeStep + 0.5f);
+
+	std::unordered_map<Key, BoneAnimationFrame*, KeyHash>::const_iterator i = poses.find(key);
+	if(i != poses.end())
+	{
+		++hitsCount;
+		added = false;
+		return i->second;
+	}
+
+	// взять свободный кадр анимации; кадры сохраняют курсоры ключей,
+	// поэтому при монотонном времени поиск ключей остаётся дешёвым
+	FramePool& pool = framePools[animation];
+	if(pool.usedCount >= (int)pool.frames.size())
+		pool.frames.push_back(NEW(BoneAnimationFrame(animation)));
+	BoneAnimationFrame* frame = pool.frames[pool.usedCount++];
+
+	poses[key] = frame;
+	++missesCount;
+	added = true;
+	poseTime = key.timeIndex * timeStep;
+	return frame;
+}
+
+const BoneAnimationFrame* PoseCache::GetPose(BoneAnimation* animation, float time)
+{
+	bool added;
+	float poseTime;
+	BoneAnimationFrame* frame = FindOrAdd(animation, time, added, poseTime);
+	if(added)
+		frame->SetupLocal(poseTime);
+	return frame;
+}
+
+const BoneAnimationFrame* PoseCache::RequestPose(BoneAnimation* animation, float time)
+{
+	bool added;
+	float poseTime;
+	BoneAnimationFrame* frame = FindOrAdd(animation, time, added, poseTime);
+	if(added)
+		pendingPoses.push_back(std::make_pair(frame, poseTime));
+	return frame;
+}
+
+void PoseCache::ComputePendingPoses(JobSystem* jobSystem)
+{
+	// позы независимы: у каждой свой кадр анимации
+	jobSystem->ParallelFor((int)pendingPoses.size(), 1, [this](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+			pendingPoses[i].first->SetupLocal(pendingPoses[i].second);
+	});
+	pendingPoses.clear();
+}
+
+int PoseCache::GetHitsCount() const
+{
+	return hitsCount;
+}
+
+int PoseCache::GetMissesCount() const
+{
+	return missesCount;
+}
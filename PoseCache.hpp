@@ -0,0 +1,82 @@
+#ifndef ___BANSHEE_POSE_CACHE_HPP___
+#define ___BANSHEE_POSE_CACHE_HPP___
+
+#include "general.hpp"
+#include <unordered_map>
+
+class BoneAnimation;
+class BoneAnimationFrame;
+class JobSystem;
+
+/// Кэш поз скелета на кадр.
+/** Экземпляры, проигрывающие одну анимацию почти в одно и то же время,
+получают одну позу в системе модели: время квантуется с шагом timeStep,
+и поза вычисляется один раз на пару (анимация, квантованное время).
+К экземпляру остаётся применить только его начало координат.
+Позы действительны до следующего BeginFrame. Кэш не потокобезопасен. */
+class PoseCache : public Object
+{
+private:
+	/// Шаг квантования времени.
+	float timeStep;
+
+	struct Key
+	{
+		BoneAnimation* animation;
+		int timeIndex;
+
+		bool operator==(const Key& other) const;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+	/// Позы, вычисленные в текущем кадре.
+	std::unordered_map<Key, BoneAnimationFrame*, KeyHash> poses;
+
+	/// Кадры анимации для вычисления поз, переиспользуемые от кадра к кадру.
+	struct FramePool
+	{
+		std::vector<ptr<BoneAnimationFrame> > frames;
+		/// Количество кадров, занятых в текущем кадре.
+		int usedCount;
+
+		FramePool();
+	};
+	std::unordered_map<BoneAnimation*, FramePool> framePools;
+
+	/// Запрошенные, но ещё не вычисленные позы и их время.
+	std::vector<std::pair<BoneAnimationFrame*, float> > pendingPoses;
+
+	/// Найти позу или выделить для неё кадр (поза ещё не вычислена).
+	BoneAnimationFrame* FindOrAdd(BoneAnimation* animation, float time, bool& added, float& poseTime);
+
+	/// Статистика текущего кадра.
+	int hitsCount, missesCount;
+
+public:
+	PoseCache(float timeStep = 1.0f / 120);
+
+	void SetTimeStep(float timeStep);
+	float GetTimeStep() const;
+
+	/// Начать кадр: забыть вычисленные позы.
+	void BeginFrame();
+	/// Освободить все кадры анимации (и удерживаемые ими анимации).
+	void Clear();
+
+	/// Получить позу анимации в системе модели.
+	const BoneAnimationFrame* GetPose(BoneAnimation* animation, float time);
+	/// Запросить позу анимации, не вычисляя её.
+	/** Поза становится действительной после ComputePendingPoses. */
+	const BoneAnimationFrame* RequestPose(BoneAnimation* animation, float time);
+	/// Вычислить запрошенные позы параллельно.
+	void ComputePendingPoses(JobSystem* jobSystem);
+
+	/// Получить количество запросов в текущем кадре, обслуженных из кэша.
+	int GetHitsCount() const;
+	/// Получить количество поз, вычисленных в текущем кадре.
+	int GetMissesCount() const;
+};
+
+#endif
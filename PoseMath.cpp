@@ -0,0 +1,245 @@
+#include "PoseMath.hpp"
+#ifdef BANSHEE_POSE_SSE
+#include <emmintrin.h>
+#endif
+
+//*** QuatArrays
+
+void QuatArrays::Resize(int count)
+{
+	int paddedCount = PadPoseCount(count);
+	x.assign(paddedCount, 0);
+	y.assign(paddedCount, 0);
+	z.assign(paddedCount, 0);
+	w.assign(paddedCount, 1);
+}
+
+void QuatArrays::Set(int i, const quat& q)
+{
+	x[i] = q.x;
+	y[i] = q.y;
+	z[i] = q.z;
+	w[i] = q.w;
+}
+
+quat QuatArrays::Get(int i) const
+{
+	return quat(x[i], y[i], z[i], w[i]);
+}
+
+//*** Vec3Arrays
+
+void Vec3Arrays::Resize(int count)
+{
+	int paddedCount = PadPoseCount(count);
+	x.assign(paddedCount, 0);
+	y.assign(paddedCount, 0);
+	z.assign(paddedCount, 0);
+}
+
+void Vec3Arrays::Set(int i, const vec3& v)
+{
+	x[i] = v.x;
+	y[i] = v.y;
+	z[i] = v.z;
+}
+
+vec3 Vec3Arrays::Get(int i) const
+{
+	return vec3(x[i], y[i], z[i]);
+}
+
+//*** ядра
+
+/*
+Коэффициенты приближения slerp (D. Eberly, "A Fast and Accurate Algorithm
+for Computing SLERP"). Для угла между кватернионами theta, x = cos(theta) >= 0:
+	slerp(a, b, t) = a * c(1 - t) + b * c(t),
+	c(t) = sin(t * theta) / sin(theta) ~ t * (1 + b1 * (1 + b2 * (... (1 + bn)))),
+	bi = (u[i] * t^2 - v[i]) * (x - 1), u[i] = 1 / (i * (2i + 1)), v[i] = i / (2i + 1).
+Последний член домножен на slerpMu для минимизации максимальной ошибки;
+при 12 членах ошибка c(t) не превышает 1e-6.
+*/
+static const int slerpTermsCount = 12;
+static const float slerpMu = 1.894f;
+static float slerpU[slerpTermsCount];
+static float slerpV[slerpTermsCount];
+
+static bool InitSlerpCoefficients()
+{
+	for(int i = 0; i < slerpTermsCount; ++i)
+	{
+		float n = (float)(i + 1);
+		float mu = i == slerpTermsCount - 1 ? slerpMu : 1;
+		slerpU[i] = mu / (n * (2 * n + 1));
+		slerpV[i] = mu * n / (2 * n + 1);
+	}
+	return true;
+}
+static bool slerpCoefficientsInitialized = InitSlerpCoefficients();
+
+#ifdef BANSHEE_POSE_SSE
+
+/// Сферическая интерполяция по массивам компонент.
+/** tStride - шаг по массиву параметров: 1 - свой параметр для каждой кости, 0 - общий. */
+static void SlerpLanes(const float* const a[4], const float* const b[4], const float* t, int tStride, float* const result[4], int count)
+{
+	const __m128 one = _mm_set1_ps(1);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for(int i = 0; i < count; i += poseLanes)
+	{
+		__m128 ax = _mm_loadu_ps(a[0] + i), ay = _mm_loadu_ps(a[1] + i), az = _mm_loadu_ps(a[2] + i), aw = _mm_loadu_ps(a[3] + i);
+		__m128 bx = _mm_loadu_ps(b[0] + i), by = _mm_loadu_ps(b[1] + i), bz = _mm_loadu_ps(b[2] + i), bw = _mm_loadu_ps(b[3] + i);
+		__m128 tt = tStride ? _mm_loadu_ps(t + i) : _mm_set1_ps(*t);
+
+		// косинус угла; при отрицательном идём по кратчайшему пути
+		__m128 cosTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 sign = _mm_and_ps(cosTheta, signMask);
+		__m128 xm1 = _mm_sub_ps(_mm_andnot_ps(signMask, cosTheta), one);
+
+		__m128 d = _mm_sub_ps(one, tt);
+		__m128 sqrT = _mm_mul_ps(tt, tt);
+		__m128 sqrD = _mm_mul_ps(d, d);
+		__m128 cT = one, cD = one;
+		for(int j = slerpTermsCount - 1; j >= 0; --j)
+		{
+			__m128 u = _mm_set1_ps(slerpU[j]), v = _mm_set1_ps(slerpV[j]);
+			cT = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrT), v), xm1), cT));
+			cD = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrD), v), xm1), cD));
+		}
+		cT = _mm_xor_ps(_mm_mul_ps(tt, cT), sign);
+		cD = _mm_mul_ps(d, cD);
+
+		_mm_storeu_ps(result[0] + i, _mm_add_ps(_mm_mul_ps(ax, cD), _mm_mul_ps(bx, cT)));
+		_mm_storeu_ps(result[1] + i, _mm_add_ps(_mm_mul_ps(ay, cD), _mm_mul_ps(by, cT)));
+		_mm_storeu_ps(result[2] + i, _mm_add_ps(_mm_mul_ps(az, cD), _mm_mul_ps(bz, cT)));
+		_mm_storeu_ps(result[3] + i, _mm_add_ps(_mm_mul_ps(aw, cD), _mm_mul_ps(bw, cT)));
+	}
+}
+
+void PoseMul(const QuatArrays& a, const QuatArrays& b, QuatArrays& result, int count)
+{
+	for(int i = 0; i < count; i += poseLanes)
+	{
+		__m128 ax = _mm_loadu_ps(&a.x[i]), ay = _mm_loadu_ps(&a.y[i]), az = _mm_loadu_ps(&a.z[i]), aw = _mm_loadu_ps(&a.w[i]);
+		__m128 bx = _mm_loadu_ps(&b.x[i]), by = _mm_loadu_ps(&b.y[i]), bz = _mm_loadu_ps(&b.z[i]), bw = _mm_loadu_ps(&b.w[i]);
+
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bx), _mm_mul_ps(ax, bw)), _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by)));
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, by), _mm_mul_ps(ay, bw)), _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz)));
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(aw, bz), _mm_mul_ps(az, bw)), _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx)));
+		__m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(aw, bw), _mm_mul_ps(ax, bx)), _mm_add_ps(_mm_mul_ps(ay, by), _mm_mul_ps(az, bz)));
+
+		_mm_storeu_ps(&result.x[i], rx);
+		_mm_storeu_ps(&result.y[i], ry);
+		_mm_storeu_ps(&result.z[i], rz);
+		_mm_storeu_ps(&result.w[i], rw);
+	}
+}
+
+void PoseTransform(const QuatArrays& q, const Vec3Arrays& v, const Vec3Arrays& origin, Vec3Arrays& result, int count)
+{
+	const __m128 two = _mm_set1_ps(2);
+	for(int i = 0; i < count; i += poseLanes)
+	{
+		__m128 qx = _mm_loadu_ps(&q.x[i]), qy = _mm_loadu_ps(&q.y[i]), qz = _mm_loadu_ps(&q.z[i]), qw = _mm_loadu_ps(&q.w[i]);
+		__m128 vx = _mm_loadu_ps(&v.x[i]), vy = _mm_loadu_ps(&v.y[i]), vz = _mm_loadu_ps(&v.z[i]);
+
+		// t = 2 * cross(q.xyz, v); v' = v + q.w * t + cross(q.xyz, t)
+		__m128 tx = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qy, vz), _mm_mul_ps(qz, vy)));
+		__m128 ty = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qz, vx), _mm_mul_ps(qx, vz)));
+		__m128 tz = _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(qx, vy), _mm_mul_ps(qy, vx)));
+		__m128 rx = _mm_add_ps(_mm_add_ps(vx, _mm_mul_ps(qw, tx)), _mm_sub_ps(_mm_mul_ps(qy, tz), _mm_mul_ps(qz, ty)));
+		__m128 ry = _mm_add_ps(_mm_add_ps(vy, _mm_mul_ps(qw, ty)), _mm_sub_ps(_mm_mul_ps(qz, tx), _mm_mul_ps(qx, tz)));
+		__m128 rz = _mm_add_ps(_mm_add_ps(vz, _mm_mul_ps(qw, tz)), _mm_sub_ps(_mm_mul_ps(qx, ty), _mm_mul_ps(qy, tx)));
+
+		_mm_storeu_ps(&result.x[i], _mm_add_ps(_mm_loadu_ps(&origin.x[i]), rx));
+		_mm_storeu_ps(&result.y[i], _mm_add_ps(_mm_loadu_ps(&origin.y[i]), ry));
+		_mm_storeu_ps(&result.z[i], _mm_add_ps(_mm_loadu_ps(&origin.z[i]), rz));
+	}
+}
+
+#else
+
+/// Сферическая интерполяция по массивам компонент.
+/** tStride - шаг по массиву параметров: 1 - свой параметр для каждой кости, 0 - общий. */
+static void SlerpLanes(const float* const a[4], const float* const b[4], const float* t, int tStride, float* const result[4], int count)
+{
+	for(int i = 0; i < count; ++i)
+	{
+		float ax = a[0][i], ay = a[1][i], az = a[2][i], aw = a[3][i];
+		float bx = b[0][i], by = b[1][i], bz = b[2][i], bw = b[3][i];
+		float tt = t[i * tStride];
+
+		// косинус угла; при отрицательном идём по кратчайшему пути
+		float cosTheta = (ax * bx + ay * by) + (az * bz + aw * bw);
+		float sign = cosTheta < 0 ? -1.0f : 1.0f;
+		float xm1 = fabs(cosTheta) - 1;
+
+		float d = 1 - tt;
+		float sqrT = tt * tt;
+		float sqrD = d * d;
+		float cT = 1, cD = 1;
+		for(int j = slerpTermsCount - 1; j >= 0; --j)
+		{
+			cT = 1 + (slerpU[j] * sqrT - slerpV[j]) * xm1 * cT;
+			cD = 1 + (slerpU[j] * sqrD - slerpV[j]) * xm1 * cD;
+		}
+		cT = tt * cT * sign;
+		cD = d * cD;
+
+		result[0][i] = ax * cD + bx * cT;
+		result[1][i] = ay * cD + by * cT;
+		result[2][i] = az * cD + bz * cT;
+		result[3][i] = aw * cD + bw * cT;
+	}
+}
+
+void PoseMul(const QuatArrays& a, const QuatArrays& b, QuatArrays& result, int count)
+{
+	for(int i = 0; i < count; ++i)
+	{
+		float ax = a.x[i], ay = a.y[i], az = a.z[i], aw = a.w[i];
+		float bx = b.x[i], by = b.y[i], bz = b.z[i], bw = b.w[i];
+
+		result.x[i] = (aw * bx + ax * bw) + (ay * bz - az * by);
+		result.y[i] = (aw * by + ay * bw) + (az * bx - ax * bz);
+		result.z[i] = (aw * bz + az * bw) + (ax * by - ay * bx);
+		result.w[i] = (aw * bw - ax * bx) - (ay * by + az * bz);
+	}
+}
+
+void PoseTransform(const QuatArrays& q, const Vec3Arrays& v, const Vec3Arrays& origin, Vec3Arrays& result, int count)
+{
+	for(int i = 0; i < count; ++i)
+	{
+		float qx = q.x[i], qy = q.y[i], qz = q.z[i], qw = q.w[i];
+		float vx = v.x[i], vy = v.y[i], vz = v.z[i];
+
+		// t = 2 * cross(q.xyz, v); v' = v + q.w * t + cross(q.xyz, t)
+		float tx = 2 * (qy * vz - qz * vy);
+		float ty = 2 * (qz * vx - qx * vz);
+		float tz = 2 * (qx * vy - qy * vx);
+
+		result.x[i] = origin.x[i] + ((vx + qw * tx) + (qy * tz - qz * ty));
+		result.y[i] = origin.y[i] + ((vy + qw * ty) + (qz * tx - qx * tz));
+		result.z[i] = origin.z[i] + ((vz + qw * tz) + (qx * ty - qy * tx));
+	}
+}
+
+#endif
+
+void PoseSlerp(const QuatArrays& a, const QuatArrays& b, const float* t, QuatArrays& result, int count)
+{
+	const float* aLanes[4] = { &a.x[0], &a.y[0], &a.z[0], &a.w[0] };
+	const float* bLanes[4] = { &b.x[0], &b.y[0], &b.z[0], &b.w[0] };
+	float* resultLanes[4] = { &result.x[0], &result.y[0], &result.z[0], &result.w[0] };
+	SlerpLanes(aLanes, bLanes, t, 1, resultLanes, count);
+}
+
+void PoseSlerpBlocks(const float* a, const float* b, int stride, float t, QuatArrays& result, int count)
+{
+	const float* aLanes[4] = { a, a + stride, a + stride * 2, a + stride * 3 };
+	const float* bLanes[4] = { b, b + stride, b + stride * 2, b + stride * 3 };
+	float* resultLanes[4] = { &result.x[0], &result.y[0], &result.z[0], &result.w[0] };
+	SlerpLanes(aLanes, bLanes, &t, 0, resultLanes, count);
+}
@@ -0,0 +1,63 @@
+#ifndef ___BANSHEE_POSE_MATH_HPP___
+#define ___BANSHEE_POSE_MATH_HPP___
+
+#include "general.hpp"
+
+/*
+Вычисления позы скелета над структурой массивов (SoA).
+Компоненты кватернионов и векторов лежат в отдельных массивах, так что одна
+SSE-инструкция обрабатывает poseLanes костей. Массивы дополняются до кратного
+poseLanes размера, ядра обрабатывают хвост целой группой.
+Если SSE недоступно (например, при сборке в asm.js), используются скалярные
+версии с той же арифметикой.
+*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BANSHEE_POSE_SSE
+#endif
+
+/// Количество костей, обрабатываемых одной инструкцией.
+static const int poseLanes = 4;
+
+/// Дополнить количество до кратного poseLanes.
+inline int PadPoseCount(int count)
+{
+	return (count + poseLanes - 1) & ~(poseLanes - 1);
+}
+
+/// Кватернионы в виде структуры массивов.
+struct QuatArrays
+{
+	std::vector<float> x, y, z, w;
+
+	/// Задать количество (дополняется до кратного poseLanes единичными кватернионами).
+	void Resize(int count);
+	void Set(int i, const quat& q);
+	quat Get(int i) const;
+};
+
+/// Векторы в виде структуры массивов.
+struct Vec3Arrays
+{
+	std::vector<float> x, y, z;
+
+	/// Задать количество (дополняется до кратного poseLanes нулями).
+	void Resize(int count);
+	void Set(int i, const vec3& v);
+	vec3 Get(int i) const;
+};
+
+/// Сферическая интерполяция: result[i] = slerp(a[i], b[i], t[i]).
+/** Используется полиномиальное приближение Эберли (без acos и sin),
+погрешность порядка 1e-6. Как и в Eigen, интерполяция идёт по кратчайшему пути. */
+void PoseSlerp(const QuatArrays& a, const QuatArrays& b, const float* t, QuatArrays& result, int count);
+/// Сферическая интерполяция двух поз с общим параметром t.
+/** a и b - блоки из четырёх массивов компонент (x, y, z, w) по stride элементов
+(stride не меньше PadPoseCount(count)). */
+void PoseSlerpBlocks(const float* a, const float* b, int stride, float t, QuatArrays& result, int count);
+/// Произведение кватернионов: result[i] = a[i] * b[i].
+void PoseMul(const QuatArrays& a, const QuatArrays& b, QuatArrays& result, int count);
+/// Преобразование точек: result[i] = origin[i] + q[i] * v[i].
+void PoseTransform(const QuatArrays& q, const Vec3Arrays& v, const Vec3Arrays& origin, Vec3Arrays& result, int count);
+
+#endif
@@ -0,0 +1,165 @@
+#include "Profiler.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+//*** Profiler::Scope
+
+Profiler::Scope::Scope(Profiler* profiler, const char* name) :
+	profiler(profiler), eventNumber(profiler->BeginEvent(name)) {}
+
+Profiler::Scope::~Scope()
+{
+	profiler->EndEvent(eventNumber);
+}
+
+//*** Profiler
+
+Profiler::Profiler(int framesCount) :
+	frames(std::max(framesCount, 1)),
+	currentFrameNumber(0),
+	recordedFramesCount(0),
+	frameStarted(false),
+	startTime(0),
+	threadId(std::this_thread::get_id())
+{
+	startTime = GetTime();
+}
+
+long long Profiler::GetTime() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() - startTime;
+}
+
+void Profiler::BeginFrame()
+{
+	Frame& frame = frames[currentFrameNumber];
+	frame.events.clear();
+	frame.beginTime = GetTime();
+	frame.endTime = frame.beginTime;
+	openEvents.clear();
+	frameStarted = true;
+}
+
+void Profiler::EndFrame()
+{
+	if(!frameStarted)
+		return;
+
+	// закрыть незакрытые участки до отметки конца кадра, чтобы они не выходили за кадр
+	while(!openEvents.empty())
+		EndEvent(openEvents.back());
+
+	Frame& frame = frames[currentFrameNumber];
+	frame.endTime = GetTime();
+
+	frameStarted = false;
+	currentFrameNumber = (currentFrameNumber + 1) % (int)frames.size();
+	if(recordedFramesCount < (int)frames.size())
+		++recordedFramesCount;
+}
+
+int Profiler::BeginEvent(const char* name)
+{
+	if(!frameStarted || std::this_thread::get_id() != threadId)
+		return -1;
+
+	std::vector<Event>& events = frames[currentFrameNumber].events;
+	Event event;
+	event.name = name;
+	event.depth = (int)openEvents.size();
+	event.beginTime = GetTime();
+	event.endTime = event.beginTime;
+	events.push_back(event);
+
+	int eventNumber = (int)events.size() - 1;
+	openEvents.push_back(eventNumber);
+	return eventNumber;
+}
+
+void Profiler::EndEvent(int eventNumber)
+{
+	// участок мог быть открыт вне кадра или в другом потоке
+	if(eventNumber < 0 || openEvents.empty() || openEvents.back() != eventNumber)
+		return;
+
+	frames[currentFrameNumber].events[eventNumber].endTime = GetTime();
+	openEvents.pop_back();
+}
+
+const Profiler::Frame* Profiler::GetFrame(int frameAgo) const
+{
+	if(frameAgo < 0 || frameAgo >= recordedFramesCount)
+		return nullptr;
+	int framesCount = (int)frames.size();
+	return &frames[((currentFrameNumber - 1 - frameAgo) % framesCount + framesCount) % framesCount];
+}
+
+int Profiler::GetRecordedFramesCount() const
+{
+	return recordedFramesCount;
+}
+
+float Profiler::GetFrameTime(int frameAgo) const
+{
+	const Frame* frame = GetFrame(frameAgo);
+	if(!frame)
+		return 0;
+	return (float)(frame->endTime - frame->beginTime) * 1e-9f;
+}
+
+float Profiler::GetScopeTime(const char* name, int frameAgo) const
+{
+	const Frame* frame = GetFrame(frameAgo);
+	if(!frame)
+		return 0;
+
+	long long time = 0;
+	for(size_t i = 0; i < frame->events.size(); ++i)
+	{
+		const Event& event = frame->events[i];
+		if(event.name == name || strcmp(event.name, name) == 0)
+			time += event.endTime - event.beginTime;
+	}
+	return (float)time * 1e-9f;
+}
+
+float Profiler::GetAverageScopeTime(const char* name) const
+{
+	if(!recordedFramesCount)
+		return 0;
+
+	float time = 0;
+	for(int i = 0; i < recordedFramesCount; ++i)
+		time += GetScopeTime(name, i);
+	return time / recordedFramesCount;
+}
+
+void Profiler::ExportChromeTrace(std::ostream& stream) const
+{
+	// времена в микросекундах, кадры от старых к новым
+	stream << "{\"traceEvents\":[\n";
+	bool first = true;
+	char buffer[256];
+	for(int i = recordedFramesCount - 1; i >= 0; --i)
+	{
+		const Frame* frame = GetFrame(i);
+
+		sprintf(buffer, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f}",
+			first ? "" : ",\n", frame->beginTime * 1e-3, (frame->endTime - frame->beginTime) * 1e-3);
+		stream << buffer;
+		first = false;
+
+		for(size_t j = 0; j < frame->events.size(); ++j)
+		{
+			const Event& event = frame->events[j];
+			// имена - строковые константы из кода, экранирование не нужно
+			sprintf(buffer, ",\n{\"name\":\"%.64s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%d}}",
+				event.name, event.beginTime * 1e-3, (event.endTime - event.beginTime) * 1e-3, event.depth + 1);
+			stream << buffer;
+		}
+	}
+	stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
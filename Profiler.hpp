@@ -0,0 +1,97 @@
+#ifndef ___BANSHEE_PROFILER_HPP___
+#define ___BANSHEE_PROFILER_HPP___
+
+#include "general.hpp"
+#include <ostream>
+#include <thread>
+
+/// Иерархический профайлер кадра.
+/** Замеряет процессорное время вложенных участков кода и хранит
+последние кадры в кольцевом буфере. Участки отмечаются объектами Scope.
+Замеры ведутся только в потоке, создавшем профайлер; участки, открытые
+в других потоках (например, в задачах JobSystem), игнорируются.
+Имена участков должны быть строковыми константами: хранится только указатель. */
+class Profiler : public Object
+{
+public:
+	/// Замеряемый участок кода.
+	class Scope
+	{
+	private:
+		Profiler* profiler;
+		int eventNumber;
+
+	public:
+		Scope(Profiler* profiler, const char* name);
+		~Scope();
+	};
+
+private:
+	/// Замер участка.
+	struct Event
+	{
+		const char* name;
+		/// Глубина вложенности.
+		int depth;
+		/// Время начала и конца в наносекундах от создания профайлера.
+		long long beginTime;
+		long long endTime;
+	};
+	/// Замеры одного кадра.
+	struct Frame
+	{
+		long long beginTime;
+		long long endTime;
+		/// Замеры в порядке открытия участков.
+		std::vector<Event> events;
+	};
+
+	/// Кольцевой буфер кадров.
+	std::vector<Frame> frames;
+	/// Номер текущего кадра в буфере.
+	int currentFrameNumber;
+	/// Количество завершённых кадров в буфере.
+	int recordedFramesCount;
+	/// Идёт ли кадр.
+	bool frameStarted;
+	/// Стек открытых участков (номера замеров).
+	std::vector<int> openEvents;
+
+	/// Точка отсчёта времени.
+	long long startTime;
+	/// Идентификатор потока, в котором ведутся замеры.
+	std::thread::id threadId;
+
+	long long GetTime() const;
+	int BeginEvent(const char* name);
+	void EndEvent(int eventNumber);
+	/// Получить завершённый кадр по давности (0 - последний).
+	const Frame* GetFrame(int frameAgo) const;
+
+public:
+	/// Создать профайлер.
+	/** \param framesCount Количество хранимых кадров. */
+	Profiler(int framesCount = 120);
+
+	/// Начать кадр.
+	/** Незавершённый предыдущий кадр отбрасывается. */
+	void BeginFrame();
+	/// Завершить кадр.
+	void EndFrame();
+
+	/// Получить количество сохранённых кадров.
+	int GetRecordedFramesCount() const;
+	/// Получить длительность кадра в секундах.
+	/** \param frameAgo Давность кадра: 0 - последний завершённый. */
+	float GetFrameTime(int frameAgo) const;
+	/// Получить суммарное время участков с данным именем в кадре, в секундах.
+	float GetScopeTime(const char* name, int frameAgo) const;
+	/// Получить среднее по сохранённым кадрам время участков с данным именем.
+	float GetAverageScopeTime(const char* name) const;
+
+	/// Записать сохранённые кадры в формате Chrome trace (JSON).
+	/** Результат открывается в chrome://tracing. */
+	void ExportChromeTrace(std::ostream& stream) const;
+};
+
+#endif
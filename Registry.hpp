@@ -0,0 +1,75 @@
+#ifndef ___BANSHEE_REGISTRY_HPP___
+#define ___BANSHEE_REGISTRY_HPP___
+
+#include "general.hpp"
+#include <algorithm>
+#include <functional>
+
+/// Выдача номеров объектов.
+/** Номера выдаются по порядку; номера удалённых объектов выдаются повторно,
+начиная с меньших. Так номера остаются плотными, сколько бы объектов ни
+создавалось за время работы (например, при пересоздании игры), и одинаковыми
+от запуска к запуску. Используется только из основного потока. */
+class IdPool
+{
+private:
+	/// Освобождённые номера (куча с наименьшим наверху).
+	std::vector<uint32_t> freeIds;
+	uint32_t nextId;
+
+public:
+	IdPool() : nextId(0) {}
+
+	uint32_t Allocate()
+	{
+		if(freeIds.empty())
+			return nextId++;
+		std::pop_heap(freeIds.begin(), freeIds.end(), std::greater<uint32_t>());
+		uint32_t id = freeIds.back();
+		freeIds.pop_back();
+		return id;
+	}
+
+	void Free(uint32_t id)
+	{
+		freeIds.push_back(id);
+		std::push_heap(freeIds.begin(), freeIds.end(), std::greater<uint32_t>());
+	}
+};
+
+/// Реестр объектов, адресуемых 32-битными номерами.
+/** Номер объекта - его поле id из IdPool, поэтому реестр плотный и поиск -
+это просто индексация. Реестр держит ссылки на зарегистрированные объекты
+до своего уничтожения: по номеру можно обращаться без подсчёта ссылок,
+а номер не может перейти к другому объекту, пока жив реестр. Объекты
+освобождаются (и их номера возвращаются) вместе с владельцем реестра.
+Номера не меньше maxHandlesCount не принимаются (номер должен помещаться
+в поле ключа рисования). */
+template <typename T, uint32_t maxHandlesCount>
+class Registry
+{
+private:
+	std::vector<ptr<T> > objects;
+
+public:
+	/// Зарегистрировать объект (повторно - ничего не делает) и получить номер.
+	uint32_t Register(T* object)
+	{
+		uint32_t handle = object->id;
+		if(handle >= maxHandlesCount)
+			THROW("Too many objects for registry");
+		if(handle >= objects.size())
+			objects.resize(handle + 1);
+		if(!objects[handle])
+			objects[handle] = object;
+		return handle;
+	}
+
+	/// Получить объект по номеру.
+	T* Get(uint32_t handle) const
+	{
+		return objects[handle];
+	}
+};
+
+#endif
@@ -0,0 +1,90 @@
+#include "RenderStats.hpp"
+
+//*** PassStats
+
+PassStats::PassStats()
+{
+	Reset();
+}
+
+void PassStats::Reset()
+{
+	drawCalls = 0;
+	instances = 0;
+	triangles = 0;
+	uniformUploads = 0;
+	samplerBinds = 0;
+	pixelShaderSwitches = 0;
+}
+
+void PassStats::Add(const PassStats& stats)
+{
+	drawCalls += stats.drawCalls;
+	instances += stats.instances;
+	triangles += stats.triangles;
+	uniformUploads += stats.uniformUploads;
+	samplerBinds += stats.samplerBinds;
+	pixelShaderSwitches += stats.pixelShaderSwitches;
+}
+
+int PassStats::Get(const String& counterName) const
+{
+	if(counterName == "drawCalls")
+		return drawCalls;
+	if(counterName == "instances")
+		return instances;
+	if(counterName == "triangles")
+		return triangles;
+	if(counterName == "uniformUploads")
+		return uniformUploads;
+	if(counterName == "samplerBinds")
+		return samplerBinds;
+	if(counterName == "pixelShaderSwitches")
+		return pixelShaderSwitches;
+	THROW("Unknown render stats counter: " + counterName);
+}
+
+//*** RenderStats
+
+void RenderStats::Reset()
+{
+	for(int i = 0; i < passesCount; ++i)
+		passes[i].Reset();
+}
+
+PassStats& RenderStats::operator[](int pass)
+{
+	return passes[pass];
+}
+
+const PassStats& RenderStats::operator[](int pass) const
+{
+	return passes[pass];
+}
+
+PassStats RenderStats::GetTotal() const
+{
+	PassStats total;
+	for(int i = 0; i < passesCount; ++i)
+		total.Add(passes[i]);
+	return total;
+}
+
+const char* RenderStats::GetPassName(int pass)
+{
+	static const char* const shadowNames[shadowPassesCount] = { "shadow0", "shadow1", "shadow2", "shadow3" };
+	if(pass >= passShadow && pass < passShadow + shadowPassesCount)
+		return shadowNames[pass - passShadow];
+	switch(pass)
+	{
+	case passBackground: return "background";
+	case passDepthPrePass: return "depthPrePass";
+	case passOpaque: return "opaque";
+	case passSkinned: return "skinned";
+	case passTransparent: return "transparent";
+	case passDownsample: return "downsample";
+	case passBloom: return "bloom";
+	case passTone: return "tone";
+	default: return "unknown";
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef ___BANSHEE_RENDER_STATS_HPP___
+#define ___BANSHEE_RENDER_STATS_HPP___
+
+#include "general.hpp"
+
+/// Счётчики одного прохода рисования.
+struct PassStats
+{
+	/// Вызовы рисования.
+	int drawCalls;
+	/// Нарисованные экземпляры (1 для обычного вызова).
+	int instances;
+	/// Нарисованные треугольники с учётом экземпляров.
+	int triangles;
+	/// Заливки uniform-буферов.
+	int uniformUploads;
+	/// Привязки текстур к семплерам.
+	int samplerBinds;
+	/// Смены пиксельного шейдера.
+	int pixelShaderSwitches;
+
+	PassStats();
+
+	void Reset();
+	/// Прибавить счётчики другого прохода.
+	void Add(const PassStats& stats);
+	/// Получить счётчик по имени.
+	/** Имена совпадают с именами полей. */
+	int Get(const String& counterName) const;
+};
+
+/// Статистика рисования кадра по проходам.
+class RenderStats
+{
+public:
+	/// Максимальное количество теневых проходов.
+	static const int shadowPassesCount = 4;
+
+	/// Проходы, по которым ведётся статистика.
+	enum Pass
+	{
+		passShadow,
+		passBackground = passShadow + shadowPassesCount,
+		passDepthPrePass,
+		passOpaque,
+		passSkinned,
+		passTransparent,
+		passDownsample,
+		passBloom,
+		passTone,
+		passesCount
+	};
+
+private:
+	PassStats passes[passesCount];
+
+public:
+	void Reset();
+
+	PassStats& operator[](int pass);
+	const PassStats& operator[](int pass) const;
+
+	/// Получить сумму по всем проходам.
+	PassStats GetTotal() const;
+
+	/// Получить имя прохода.
+	static const char* GetPassName(int pass);
+};
+
+#endif
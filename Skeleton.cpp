@@ -1,11 +1,12 @@
 #include "Skeleton.hpp"
-#include <stack>
+#include "GeometryFormats.hpp"
 
 /*
 Формат файла скелета:
 
 Трансформация - это кватернион (xyzw) плюс смещение.
-0 кость - корневая.
+0 кость - корневая. Кости в файле могут идти в любом порядке,
+при загрузке они переставляются (см. Skeleton).
 
 Количество костей.
 Кость
@@ -15,29 +16,74 @@
 }
 */
 
-Skeleton::Skeleton(const std::vector<Bone>& bones) : bones(bones)
+Skeleton::Skeleton(const std::vector<Bone>& sourceBones)
 {
-	// отсортировать кости топологически
-	sortedBones.reserve(bones.size());
-	std::vector<bool> f(bones.size());
+	int bonesCount = (int)sourceBones.size();
+	if(!bonesCount)
+		THROW("Skeleton has no bones");
 
-	// DFS без рекурсии
-	std::stack<int> s;
-	int bonesCount = (int)bones.size();
+	// дети каждой кости в исходном порядке
+	std::vector<int> childStarts(bonesCount + 1, 0);
+	for(int i = 1; i < bonesCount; ++i)
+	{
+		int parent = sourceBones[i].parent;
+		if(parent < 0 || parent >= bonesCount || parent == i)
+			THROW("Invalid bone parent");
+		++childStarts[parent + 1];
+	}
 	for(int i = 0; i < bonesCount; ++i)
+		childStarts[i + 1] += childStarts[i];
+	std::vector<int> children(bonesCount);
 	{
-		while(i >= 0 && !f[i])
-		{
-			f[i] = true;
-			s.push(i);
-			i = bones[i].parent;
-		}
+		std::vector<int> childEnds(childStarts.begin(), childStarts.end() - 1);
+		for(int i = 1; i < bonesCount; ++i)
+			children[childEnds[sourceBones[i].parent]++] = i;
+	}
 
-		while(!s.empty())
-		{
-			sortedBones.push_back(s.top());
-			s.pop();
-		}
+	// обход в ширину от корня; очередь и есть новый порядок
+	std::vector<int> order;
+	order.reserve(bonesCount);
+	order.push_back(0);
+	for(size_t k = 0; k < order.size(); ++k)
+	{
+		int i = order[k];
+		for(int j = childStarts[i]; j < childStarts[i + 1]; ++j)
+			order.push_back(children[j]);
+	}
+	if((int)order.size() != bonesCount)
+		THROW("Bones hierarchy is not a tree");
+
+	boneRemap.resize(bonesCount);
+	for(int k = 0; k < bonesCount; ++k)
+		boneRemap[order[k]] = k;
+
+	// переставить кости и разметить уровни: глубина в порядке обхода не убывает
+	bones.resize(bonesCount);
+	parents.resize(bonesCount);
+	std::vector<int> depths(bonesCount);
+	for(int k = 0; k < bonesCount; ++k)
+	{
+		bones[k] = sourceBones[order[k]];
+		int parent = k ? boneRemap[bones[k].parent] : 0;
+		bones[k].parent = parent;
+		parents[k] = parent;
+		depths[k] = k ? depths[parent] + 1 : 0;
+		if(!k || depths[k] != depths[k - 1])
+			levelStarts.push_back(k);
+	}
+	levelStarts.push_back(bonesCount);
+
+	// оригинальная поза в виде, удобном для её вычитания
+	originalRelativePositions.Resize(bonesCount);
+	inverseOriginalWorldOrientations.Resize(bonesCount);
+	negativeOriginalWorldPositions.Resize(bonesCount);
+	for(int i = 0; i < bonesCount; ++i)
+	{
+		originalRelativePositions.Set(i, bones[i].originalRelativePosition);
+		const quat& q = bones[i].originalWorldOrientation;
+		inverseOriginalWorldOrientations.Set(i, quat(-q.x, -q.y, -q.z, q.w));
+		const vec3& p = bones[i].originalWorldPosition;
+		negativeOriginalWorldPositions.Set(i, vec3(-p.x, -p.y, -p.z));
 	}
 }
 
@@ -46,9 +92,56 @@ const std::vector<Skeleton::Bone>& Skeleton::GetBones() const
 	return bones;
 }
 
-const std::vector<int>& Skeleton::GetSortedBones() const
+const std::vector<int>& Skeleton::GetBoneRemap() const
+{
+	return boneRemap;
+}
+
+const std::vector<int>& Skeleton::GetParents() const
 {
-	return sortedBones;
+	return parents;
+}
+
+const std::vector<int>& Skeleton::GetLevelStarts() const
+{
+	return levelStarts;
+}
+
+const Vec3Arrays& Skeleton::GetOriginalRelativePositions() const
+{
+	return originalRelativePositions;
+}
+
+const QuatArrays& Skeleton::GetInverseOriginalWorldOrientations() const
+{
+	return inverseOriginalWorldOrientations;
+}
+
+const Vec3Arrays& Skeleton::GetNegativeOriginalWorldPositions() const
+{
+	return negativeOriginalWorldPositions;
+}
+
+ptr<File> Skeleton::RemapSkinnedVertices(ptr<File> vertices) const
+{
+	ptr<File> result = MemoryFile::CreateViaCopy(vertices->GetData(), vertices->GetSize());
+	int verticesCount = (int)(result->GetSize() / GeometryFormats::skinnedVertexStride);
+	int bonesCount = (int)boneRemap.size();
+	unsigned char* data = (unsigned char*)result->GetData();
+	for(int i = 0; i < verticesCount; ++i)
+	{
+		unsigned char* boneNumbers = data + i * GeometryFormats::skinnedVertexStride + GeometryFormats::skinnedBoneNumbersOffset;
+		for(int j = 0; j < 4; ++j)
+		{
+			if(boneNumbers[j] >= bonesCount)
+				THROW("Invalid vertex bone number");
+			int boneNumber = boneRemap[boneNumbers[j]];
+			if(boneNumber > 255)
+				THROW("Remapped bone number doesn't fit into vertex");
+			boneNumbers[j] = (unsigned char)boneNumber;
+		}
+	}
+	return result;
 }
 
 ptr<Skeleton> Skeleton::Deserialize(ptr<InputStream> inputStream)
@@ -64,6 +157,8 @@ ptr<Skeleton> Skeleton::Deserialize(ptr<InputStream> inputStream)
 		for(size_t i = 0; i < bonesCount; ++i)
 		{
 			bones[i].parent = (int)reader.ReadShortly();
+			if(i && (size_t)bones[i].parent >= bonesCount)
+				THROW("Invalid bone parent");
 			bones[i].originalWorldOrientation = reader.Read<quat>();
 			bones[i].originalWorldPosition = reader.Read<vec3>();
 		}
@@ -2,9 +2,14 @@
 #define ___BANSHEE_SKELETON_HPP___
 
 #include "general.hpp"
+#include "PoseMath.hpp"
 
 /// Класс скелета.
-/** Содержит иерархию костей. */
+/** Содержит иерархию костей. Кости хранятся в порядке обхода в ширину от корня:
+родитель всегда раньше ребёнка, кости одного уровня иерархии идут подряд,
+а номера родителей не убывают. Так поза вычисляется одним проходом вперёд
+без косвенной адресации. Номера костей в файлах (анимаций, вершин) переводятся
+в этот порядок таблицей GetBoneRemap. */
 class Skeleton : public Object
 {
 public:
@@ -22,16 +27,39 @@ public:
 	};
 
 public:
-	/// Кости.
+	/// Кости в порядке обхода в ширину.
 	std::vector<Bone> bones;
-	/// Порядок топологической сортировки для костей.
-	std::vector<int> sortedBones;
+	/// Номера костей в этом порядке по исходным номерам.
+	std::vector<int> boneRemap;
+
+	//*** Плоские массивы для вычисления позы.
+	/// Номера родительских костей (у корня - 0).
+	std::vector<int> parents;
+	/// Начала уровней иерархии в костях, последний элемент - количество костей.
+	std::vector<int> levelStarts;
+	/// Оригинальные относительные позиции.
+	Vec3Arrays originalRelativePositions;
+	/// Сопряжённые оригинальные мировые ориентации.
+	QuatArrays inverseOriginalWorldOrientations;
+	/// Оригинальные мировые позиции с обратным знаком.
+	Vec3Arrays negativeOriginalWorldPositions;
 
 public:
-	Skeleton(const std::vector<Bone>& bones);
+	/// Создать скелет.
+	/** Кости могут идти в любом порядке, 0 кость - корневая. */
+	Skeleton(const std::vector<Bone>& sourceBones);
 
 	const std::vector<Bone>& GetBones() const;
-	const std::vector<int>& GetSortedBones() const;
+	const std::vector<int>& GetBoneRemap() const;
+	const std::vector<int>& GetParents() const;
+	const std::vector<int>& GetLevelStarts() const;
+	const Vec3Arrays& GetOriginalRelativePositions() const;
+	const QuatArrays& GetInverseOriginalWorldOrientations() const;
+	const Vec3Arrays& GetNegativeOriginalWorldPositions() const;
+
+	/// Перевести номера костей в вершинах skinned-формата в порядок скелета.
+	/** Возвращает новый файл вершин. */
+	ptr<File> RemapSkinnedVertices(ptr<File> vertices) const;
 
 	static ptr<Skeleton> Deserialize(ptr<InputStream> inputStream);
 
@@ -0,0 +1,101 @@
+#include "Skinning.hpp"
+#include "BoneAnimation.hpp"
+#include "GeometryFormats.hpp"
+#include "PoseMath.hpp"
+#ifdef BANSHEE_POSE_SSE
+#include <emmintrin.h>
+#endif
+
+void GetSkinningMatrices(const BoneAnimationFrame* animationFrame, std::vector<SkinningMatrix>& matrices)
+{
+	const std::vector<quat>& orientations = animationFrame->orientations;
+	const std::vector<vec3>& offsets = animationFrame->offsets;
+	int bonesCount = (int)orientations.size();
+	matrices.resize(bonesCount);
+	for(int i = 0; i < bonesCount; ++i)
+	{
+		const quat& q = orientations[i];
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+		float (*columns)[4] = matrices[i].columns;
+		columns[0][0] = 1 - 2 * (yy + zz);
+		columns[0][1] = 2 * (xy + wz);
+		columns[0][2] = 2 * (xz - wy);
+		columns[0][3] = 0;
+		columns[1][0] = 2 * (xy - wz);
+		columns[1][1] = 1 - 2 * (xx + zz);
+		columns[1][2] = 2 * (yz + wx);
+		columns[1][3] = 0;
+		columns[2][0] = 2 * (xz + wy);
+		columns[2][1] = 2 * (yz - wx);
+		columns[2][2] = 1 - 2 * (xx + yy);
+		columns[2][3] = 0;
+		columns[3][0] = offsets[i].x;
+		columns[3][1] = offsets[i].y;
+		columns[3][2] = offsets[i].z;
+		columns[3][3] = 0;
+	}
+}
+
+void SkinVertices(const void* source, int verticesCount, const SkinningMatrix* matrices, void* result)
+{
+	for(int i = 0; i < verticesCount; ++i)
+	{
+		// вершина skinned-формата: позиция, нормаль, текстурные координаты,
+		// номера костей (байты) и веса
+		const char* vertex = (const char*)source + i * GeometryFormats::skinnedVertexStride;
+		const float* position = (const float*)vertex;
+		const float* normal = position + 3;
+		const float* texcoord = position + 6;
+		const unsigned char* boneNumbers = (const unsigned char*)(vertex + GeometryFormats::skinnedBoneNumbersOffset);
+		const float* boneWeights = (const float*)(vertex + GeometryFormats::skinnedBoneWeightsOffset);
+		float* resultVertex = (float*)((char*)result + i * GeometryFormats::vertexStride);
+
+#ifdef BANSHEE_POSE_SSE
+		// взвешенная сумма матриц костей
+		__m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+		for(int k = 0; k < 4; ++k)
+		{
+			const float (*columns)[4] = matrices[boneNumbers[k]].columns;
+			__m128 weight = _mm_set1_ps(boneWeights[k]);
+			c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(columns[0]), weight));
+			c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(columns[1]), weight));
+			c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(columns[2]), weight));
+			c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(columns[3]), weight));
+		}
+		__m128 p = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(c0, _mm_set1_ps(position[0])),
+			_mm_mul_ps(c1, _mm_set1_ps(position[1]))), _mm_add_ps(
+			_mm_mul_ps(c2, _mm_set1_ps(position[2])),
+			c3));
+		__m128 n = _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(c0, _mm_set1_ps(normal[0])),
+			_mm_mul_ps(c1, _mm_set1_ps(normal[1]))),
+			_mm_mul_ps(c2, _mm_set1_ps(normal[2])));
+		// четвёртые компоненты затираются следующей записью
+		float tx = texcoord[0], ty = texcoord[1];
+		_mm_storeu_ps(resultVertex, p);
+		_mm_storeu_ps(resultVertex + 3, n);
+		resultVertex[6] = tx;
+		resultVertex[7] = ty;
+#else
+		float m[4][3] = { { 0 } };
+		for(int k = 0; k < 4; ++k)
+		{
+			const float (*columns)[4] = matrices[boneNumbers[k]].columns;
+			float weight = boneWeights[k];
+			for(int c = 0; c < 4; ++c)
+				for(int r = 0; r < 3; ++r)
+					m[c][r] += columns[c][r] * weight;
+		}
+		for(int r = 0; r < 3; ++r)
+		{
+			resultVertex[r] = m[0][r] * position[0] + m[1][r] * position[1] + m[2][r] * position[2] + m[3][r];
+			resultVertex[3 + r] = m[0][r] * normal[0] + m[1][r] * normal[1] + m[2][r] * normal[2];
+		}
+		resultVertex[6] = texcoord[0];
+		resultVertex[7] = texcoord[1];
+#endif
+	}
+}
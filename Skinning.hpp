@@ -0,0 +1,30 @@
+#ifndef ___BANSHEE_SKINNING_HPP___
+#define ___BANSHEE_SKINNING_HPP___
+
+#include "general.hpp"
+
+class BoneAnimationFrame;
+
+/*
+CPU-скиннинг: вершины skinned-формата преобразуются позой в вершины обычного
+формата, которые затем рисуются статическими шейдерами во всех проходах.
+Кватернион и смещение кости переводятся в матрицу, а вершина преобразуется
+взвешенной суммой матриц четырёх костей - это то же линейное смешивание,
+что и в вершинном шейдере. С SSE столбец матрицы обрабатывается одной
+инструкцией.
+*/
+
+/// Матрица кости: три столбца поворота и смещение (компонента w не используется).
+struct SkinningMatrix
+{
+	float columns[4][4];
+};
+
+/// Перевести позу в матрицы костей.
+void GetSkinningMatrices(const BoneAnimationFrame* animationFrame, std::vector<SkinningMatrix>& matrices);
+/// Выполнить скиннинг вершин.
+/** source - вершины skinned-формата (GeometryFormats::skinnedVertexStride),
+result - вершины обычного формата (GeometryFormats::vertexStride). */
+void SkinVertices(const void* source, int verticesCount, const SkinningMatrix* matrices, void* result);
+
+#endif
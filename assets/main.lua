@@ -42,6 +42,8 @@ end
 
 local matFloor = Banshee.Material()
 matFloor:SetDiffuseTexture(game:LoadTexture("/floor.png"))
+-- пол только принимает тени
+matFloor:SetCastsShadow(false)
 
 -- floor
 game:AddStaticRigidBody(game:CreatePhysicsRigidBody(game:CreatePhysicsBoxShape({ 10000, 10000, 1 }), 0, { 0, 0, -1}))
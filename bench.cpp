@@ -0,0 +1,33 @@
+#include "general.hpp"
+#include "Game.hpp"
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+
+/*
+Бенчмарк кадра без окна и графического устройства.
+Запуск: bench [сцена [количество кадров [время кадра]]]
+Сцена - скрипт в каталоге assets, по умолчанию /main.lua.
+Результат (JSON) пишется в стандартный вывод, ошибки - в стандартный поток ошибок.
+*/
+
+int main(int argc, char** argv)
+{
+	String sceneFileName = argc > 1 ? argv[1] : "/main.lua";
+	int ticksCount = argc > 2 ? atoi(argv[2]) : 1000;
+	float frameTime = argc > 3 ? (float)atof(argv[3]) : 1.0f / 60;
+
+	try
+	{
+		MakePointer(NEW(Game()))->RunBenchmark(sceneFileName, ticksCount, frameTime, std::cout);
+	}
+	catch(Exception* exception)
+	{
+		std::ostringstream s;
+		MakePointer(exception)->PrintStack(s);
+		std::cerr << s.str() << '\n';
+		return 1;
+	}
+
+	return 0;
+}
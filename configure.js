@@ -67,14 +67,36 @@ exports.configureLinker = function(executableFile, linker) {
 	var a = /^(([^\/]+)\/)[^\/]+$/.exec(executableFile);
 	linker.configuration = a[2];
 
+	// точка входа выбирается по имени исполняемого файла:
+	// bench - бенчмарк кадра без окна, microbench - микробенчмарки,
+	// geoopt - оптимизация геометрии в assets, иначе - игра
+	var entryPoints = {
+		bench: 'bench',
+		microbench: 'microbench',
+		geoopt: 'geoopt'
+	};
+	var executableName = /([^\/]+)$/.exec(executableFile)[1];
+
 	var objects = [
-		'main',
+		entryPoints[executableName] || 'main',
 		'meta',
 		'Geometry',
 		'GeometryFormats',
+		'MeshOptimization',
+		'Culling',
+		'DrawKeys',
+		'FrameArena',
+		'JobSystem',
 		'Material',
+		'Profiler',
+		'RenderStats',
 		'Painter',
 		'Game',
+		'PoseMath',
+		'PoseCache',
+		'AnimationLod',
+		'PoseBatch',
+		'Skinning',
 		'BoneAnimation',
 		'Skeleton',
 		'Camera',
@@ -0,0 +1,80 @@
+#include "general.hpp"
+#include "GeometryFormats.hpp"
+#include "MeshOptimization.hpp"
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+/*
+Оптимизация геометрии в каталоге assets: порядок треугольников для кэша вершин,
+порядок вершин для выборки и, по желанию, порядок кластеров против перерисовки.
+Запуск: geoopt [-skinned] [-overdraw порог] геометрия [уровни детализации...]
+Геометрия задаётся как в скрипте (/box.geo); файлы .vertices и .indices
+перезаписываются. Индексы уровней детализации (.indices) переводятся в новый
+порядок вершин и тоже оптимизируются. Для каждого файла индексов выводится строка:
+	имя	количество треугольников	ACMR до	ACMR после
+*/
+
+static void PrintStats(const String& fileName, const MeshOptimizationStats& stats)
+{
+	std::cout << fileName << '\t' << stats.trianglesCount << '\t' << stats.acmrBefore << '\t' << stats.acmrAfter << '\n';
+}
+
+int main(int argc, char** argv)
+{
+	int vertexStride = GeometryFormats::vertexStride;
+	float overdrawThreshold = 0;
+	int argi;
+	for(argi = 1; argi < argc && argv[argi][0] == '-'; ++argi)
+	{
+		if(strcmp(argv[argi], "-skinned") == 0)
+			vertexStride = GeometryFormats::skinnedVertexStride;
+		else if(strcmp(argv[argi], "-overdraw") == 0 && argi + 1 < argc)
+			overdrawThreshold = (float)atof(argv[++argi]);
+		else
+		{
+			argi = argc;
+			break;
+		}
+	}
+	if(argi >= argc)
+	{
+		std::cerr << "Usage: geoopt [-skinned] [-overdraw threshold] geometry [lods...]\n";
+		return 1;
+	}
+
+	try
+	{
+		ptr<FileSystem> fileSystem = NEW(Platform::FileSystem("assets"));
+
+		String fileName = argv[argi];
+		ptr<File> verticesFile = fileSystem->LoadFile(fileName + ".vertices");
+		ptr<File> indicesFile = fileSystem->LoadFile(fileName + ".indices");
+		std::vector<uint32_t> vertexRemap;
+		PrintStats(fileName, OptimizeGeometry(verticesFile, indicesFile, vertexStride, overdrawThreshold, vertexRemap));
+
+		// уровни детализации читаются до записи геометрии, чтобы ошибка не оставила файлы рассогласованными
+		std::vector<ptr<File> > lodIndicesFiles;
+		for(int i = argi + 1; i < argc; ++i)
+		{
+			ptr<File> lodIndicesFile = fileSystem->LoadFile(String(argv[i]) + ".indices");
+			PrintStats(argv[i], OptimizeLodIndices(lodIndicesFile, vertexRemap));
+			lodIndicesFiles.push_back(lodIndicesFile);
+		}
+
+		fileSystem->SaveFile(verticesFile, fileName + ".vertices");
+		fileSystem->SaveFile(indicesFile, fileName + ".indices");
+		for(int i = argi + 1; i < argc; ++i)
+			fileSystem->SaveFile(lodIndicesFiles[i - argi - 1], String(argv[i]) + ".indices");
+	}
+	catch(Exception* exception)
+	{
+		std::ostringstream s;
+		MakePointer(exception)->PrintStack(s);
+		std::cerr << s.str() << '\n';
+		return 1;
+	}
+
+	return 0;
+}
@@ -11,6 +11,10 @@
 #include "Geometry.hpp"
 
 META_CLASS(BoneAnimation, Banshee.BoneAnimation);
+	META_METHOD(GetDuration);
+	META_METHOD(GetKeysCount);
+	META_METHOD(Resample);
+	META_METHOD(IsResampled);
 META_CLASS_END();
 
 META_CLASS(Game, Banshee.Game);
@@ -18,6 +22,7 @@ META_CLASS(Game, Banshee.Game);
 	META_METHOD(LoadTexture);
 	META_METHOD(LoadGeometry);
 	META_METHOD(LoadSkinnedGeometry);
+	META_METHOD(AddGeometryLod);
 	META_METHOD(LoadSkeleton);
 	META_METHOD(LoadBoneAnimation);
 	META_METHOD(CreatePhysicsBoxShape);
@@ -27,10 +32,32 @@ META_CLASS(Game, Banshee.Game);
 	META_METHOD(AddStaticModel);
 	META_METHOD(AddStaticModelWithScale);
 	META_METHOD(AddRigidModel);
+	META_METHOD(AddSkinnedModel);
 	META_METHOD(AddStaticRigidBody);
 	META_METHOD(AddStaticLight);
 	META_METHOD(SetAmbient);
 	META_METHOD(SetBackgroundTexture);
+	META_METHOD(SetDepthPrePass);
+	META_METHOD(SetPreSkinning);
+	META_METHOD(SetShadowLodBias);
+	META_METHOD(SetStatsOverlay);
+	META_METHOD(GetRenderPassesCount);
+	META_METHOD(GetRenderPassName);
+	META_METHOD(GetRenderStat);
+	META_METHOD(GetProfileFramesCount);
+	META_METHOD(GetProfileFrameTime);
+	META_METHOD(GetProfileScopeTime);
+	META_METHOD(GetProfileAverageScopeTime);
+	META_METHOD(ExportProfile);
+	META_METHOD(SetAnimationMaxError);
+	META_METHOD(SetAnimationResampleRate);
+	META_METHOD(SetGeometryOptimization);
+	META_METHOD(GetGeometryAcmr);
+	META_METHOD(SetPoseCacheTimeStep);
+	META_METHOD(SetAnimationLodLevelsCount);
+	META_METHOD(SetAnimationLodLevel);
+	META_METHOD(GetAnimationLodInstancesCount);
+	META_METHOD(SetBenchmarkCamera);
 	META_METHOD(SetBansheeParams);
 	META_METHOD(PlaceHero);
 	META_METHOD(PlaceCamera);
@@ -55,6 +82,7 @@ META_CLASS(Material, Banshee.Material);
 	META_METHOD(SetSpecular);
 	META_METHOD(SetNormalCoordTransform);
 	META_METHOD(SetEnvironmentCoef);
+	META_METHOD(SetCastsShadow);
 META_CLASS_END();
 
 META_CLASS(Skeleton, Banshee.Skeleton);
@@ -0,0 +1,391 @@
+#include "general.hpp"
+#include "Skeleton.hpp"
+#include "BoneAnimation.hpp"
+#include "Camera.hpp"
+#include "Painter.hpp"
+#include "Geometry.hpp"
+#include "GeometryFormats.hpp"
+#include "Material.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "PoseCache.hpp"
+#include "AnimationLod.hpp"
+#include "PoseBatch.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+/*
+Микробенчмарки горячих циклов процессора.
+Запуск: microbench [подстрока имени]
+Для каждого бенчмарка выводится строка:
+	имя	количество операций	нс/операцию	выделений памяти/операцию
+Выделения считаются глобальными operator new во всех потоках.
+*/
+
+//*** подсчёт выделений памяти
+
+static std::atomic<long long> allocationsCount(0);
+
+void* operator new(size_t size)
+{
+	++allocationsCount;
+	void* data = malloc(size ? size : 1);
+	if(!data)
+		throw std::bad_alloc();
+	return data;
+}
+
+void* operator new[](size_t size)
+{
+	++allocationsCount;
+	void* data = malloc(size ? size : 1);
+	if(!data)
+		throw std::bad_alloc();
+	return data;
+}
+
+void operator delete(void* data) noexcept
+{
+	free(data);
+}
+
+void operator delete[](void* data) noexcept
+{
+	free(data);
+}
+
+//*** запуск бенчмарков
+
+/// Фильтр имён бенчмарков.
+static const char* benchmarkFilter = nullptr;
+
+/// Выполнить операцию столько раз, чтобы набрать минимальное время, и вывести результат.
+static void RunBenchmark(const char* name, const std::function<void()>& operation)
+{
+	if(benchmarkFilter && !strstr(name, benchmarkFilter))
+		return;
+
+	// прогрев: кэши, ленивые выделения
+	operation();
+
+	const double minTime = 0.5;
+	long long operationsCount = 0;
+	long long allocations = 0;
+	double time = 0;
+	for(long long batchSize = 1; time < minTime; batchSize *= 2)
+	{
+		long long allocationsBefore = allocationsCount;
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for(long long i = 0; i < batchSize; ++i)
+			operation();
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		allocations += allocationsCount - allocationsBefore;
+		time += std::chrono::duration<double>(end - begin).count();
+		operationsCount += batchSize;
+	}
+
+	printf("%-48s\t%10lld\t%14.1f ns/op\t%10.2f allocs/op\n", name, operationsCount,
+		time * 1e9 / operationsCount, (double)allocations / operationsCount);
+	fflush(stdout);
+}
+
+/// Детерминированный генератор случайных чисел.
+class Random
+{
+private:
+	unsigned int state;
+
+public:
+	Random(unsigned int seed) : state(seed) {}
+
+	float Next()
+	{
+		state = state * 1664525u + 1013904223u;
+		return (float)(state >> 8) / (float)(1 << 24);
+	}
+	float Next(float min, float max)
+	{
+		return min + (max - min) * Next();
+	}
+	int NextInt(int count)
+	{
+		return std::min((int)(Next() * count), count - 1);
+	}
+	quat NextOrientation()
+	{
+		return fromEigen(toEigenQuat(quat(Next(-1, 1), Next(-1, 1), Next(-1, 1), Next(-1, 1))).normalized());
+	}
+};
+
+/// Создать кости синтетического скелета.
+/** Родитель каждой кости - одна из предыдущих, кости перемешаны,
+чтобы перестановка костей в скелете не была тривиальной. */
+static std::vector<Skeleton::Bone> CreateBones(int bonesCount, Random& random)
+{
+	std::vector<int> order(bonesCount);
+	for(int i = 0; i < bonesCount; ++i)
+		order[i] = i;
+	for(int i = bonesCount - 1; i > 1; --i)
+		std::swap(order[i], order[1 + random.NextInt(i)]);
+
+	std::vector<Skeleton::Bone> bones(bonesCount);
+	for(int i = 0; i < bonesCount; ++i)
+	{
+		Skeleton::Bone& bone = bones[order[i]];
+		bone.parent = i ? order[random.NextInt(i)] : -1;
+		bone.originalWorldOrientation = random.NextOrientation();
+		bone.originalWorldPosition = vec3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1));
+		bone.originalRelativePosition = vec3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1));
+	}
+	return bones;
+}
+
+/// Записать синтетическую анимацию в формате файла.
+static ptr<File> CreateAnimationFile(int bonesCount, int keysPerBone, Random& random)
+{
+	ptr<MemoryStream> stream = NEW(MemoryStream());
+	StreamWriter writer(stream);
+	writer.WriteShortly(bonesCount);
+	writer.WriteShortly(bonesCount * keysPerBone);
+	// ключи идут вперемешку по костям, как в экспортированных файлах
+	for(int k = 0; k < keysPerBone; ++k)
+		for(int i = 0; i < bonesCount; ++i)
+		{
+			writer.Write<float>((float)k / 30);
+			writer.WriteShortly(i);
+			writer.Write<quat>(random.NextOrientation());
+			if(!i)
+				writer.Write<vec3>(vec3(random.Next(-1, 1), random.Next(-1, 1), random.Next(-1, 1)));
+		}
+	return stream->ToFile();
+}
+
+//*** бенчмарки
+
+static void BenchmarkSkeletons()
+{
+	static const int bonesCounts[] = { 64, 128, 256 };
+	const int keysPerBone = 600;
+	for(size_t b = 0; b < sizeof(bonesCounts) / sizeof(bonesCounts[0]); ++b)
+	{
+		int bonesCount = bonesCounts[b];
+		Random random(bonesCount);
+		std::vector<Skeleton::Bone> bones = CreateBones(bonesCount, random);
+		char name[128];
+
+		sprintf(name, "Skeleton/%d bones", bonesCount);
+		RunBenchmark(name, [&]()
+		{
+			ptr<Skeleton> skeleton = NEW(Skeleton(bones));
+		});
+
+		ptr<Skeleton> skeleton = NEW(Skeleton(bones));
+		ptr<File> animationFile = CreateAnimationFile(bonesCount, keysPerBone, random);
+
+		sprintf(name, "BoneAnimation::Deserialize/%d bones x %d keys", bonesCount, keysPerBone);
+		RunBenchmark(name, [&]()
+		{
+			ptr<BoneAnimation> animation = BoneAnimation::Deserialize(NEW(FileInputStream(animationFile)), skeleton);
+		});
+
+		ptr<BoneAnimation> animation = BoneAnimation::Deserialize(NEW(FileInputStream(animationFile)), skeleton);
+		ptr<BoneAnimationFrame> animationFrame = NEW(BoneAnimationFrame(animation));
+		const float clipLength = (float)(keysPerBone - 1) / 30;
+
+		sprintf(name, "BoneAnimationFrame::SetupLooped/%d bones", bonesCount);
+		float time = 0;
+		RunBenchmark(name, [&]()
+		{
+			animationFrame->SetupLooped(vec3(0, 0, 0), quat(0, 0, 0, 1), time);
+			time += 1.0f / 60;
+		});
+
+		// произвольная перемотка: курсоры ключей не помогают
+		sprintf(name, "BoneAnimationFrame::Setup seek/%d bones", bonesCount);
+		RunBenchmark(name, [&]()
+		{
+			animationFrame->Setup(vec3(0, 0, 0), quat(0, 0, 0, 1), random.Next(0, clipLength));
+		});
+
+		ptr<BoneAnimation> resampledAnimation = BoneAnimation::Deserialize(NEW(FileInputStream(animationFile)), skeleton);
+		resampledAnimation->Resample(30);
+		ptr<BoneAnimationFrame> resampledAnimationFrame = NEW(BoneAnimationFrame(resampledAnimation));
+
+		sprintf(name, "BoneAnimationFrame::SetupLooped resampled/%d bones", bonesCount);
+		RunBenchmark(name, [&]()
+		{
+			resampledAnimationFrame->SetupLooped(vec3(0, 0, 0), quat(0, 0, 0, 1), time);
+			time += 1.0f / 60;
+		});
+	}
+}
+
+static void BenchmarkCrowd()
+{
+	const int bonesCount = 64;
+	const int keysPerBone = 600;
+	const int clipsCount = 8;
+	const int phasesCount = 4;
+	const int instancesCount = 1000;
+
+	Random random(2);
+	ptr<Skeleton> skeleton = NEW(Skeleton(CreateBones(bonesCount, random)));
+	std::vector<ptr<BoneAnimation> > animations(clipsCount);
+	for(int i = 0; i < clipsCount; ++i)
+		animations[i] = BoneAnimation::Deserialize(NEW(FileInputStream(CreateAnimationFile(bonesCount, keysPerBone, random))), skeleton);
+
+	// каждый экземпляр проигрывает одну из анимаций в одной из нескольких фаз
+	std::vector<ptr<BoneAnimationFrame> > frames(instancesCount);
+	std::vector<float> phases(instancesCount);
+	std::vector<vec3> positions(instancesCount);
+	for(int i = 0; i < instancesCount; ++i)
+	{
+		frames[i] = NEW(BoneAnimationFrame(animations[random.NextInt(clipsCount)]));
+		phases[i] = random.NextInt(phasesCount) * 0.5f;
+		positions[i] = vec3(random.Next(-100, 100), random.Next(-100, 100), 0);
+	}
+
+	ptr<PoseCache> poseCache = NEW(PoseCache());
+	char name[128];
+	for(int cached = 0; cached < 2; ++cached)
+	{
+		sprintf(name, "Crowd SetupLooped %s/%d instances", cached ? "cached" : "uncached", instancesCount);
+		float time = 0;
+		RunBenchmark(name, [&]()
+		{
+			poseCache->BeginFrame();
+			for(int i = 0; i < instancesCount; ++i)
+				frames[i]->SetupLooped(positions[i], quat(0, 0, 0, 1), time + phases[i], cached ? (PoseCache*)poseCache : nullptr);
+			time += 1.0f / 60;
+		});
+	}
+
+	// детализация по размеру на экране: камера над краем толпы
+	ptr<AnimationLod> animationLod = NEW(AnimationLod());
+	animationLod->BeginFrame(
+		CreateProjectionPerspectiveFovMatrix(3.1415926535897932f / 4, 4.0f / 3, 0.1f, 10000.0f) *
+		CreateLookAtMatrix(vec3(-110, 0, 2), vec3(0, 0, 0), vec3(0, 0, 1)), 1.0f / 60);
+	{
+		sprintf(name, "Crowd SetupLod/%d instances", instancesCount);
+		float time = 0;
+		RunBenchmark(name, [&]()
+		{
+			for(int i = 0; i < instancesCount; ++i)
+				animationLod->Setup(frames[i], positions[i], quat(0, 0, 0, 1), time + phases[i], true, positions[i], 1.0f);
+			time += 1.0f / 60;
+		});
+	}
+
+	// пакетный расчёт во всех потоках
+	ptr<JobSystem> jobSystem = NEW(JobSystem());
+	ptr<PoseBatch> poseBatch = NEW(PoseBatch());
+	for(int cached = 0; cached < 2; ++cached)
+	{
+		sprintf(name, "Crowd PoseBatch %s/%d instances/%d threads", cached ? "cached" : "uncached", instancesCount, jobSystem->GetThreadsCount());
+		float time = 0;
+		RunBenchmark(name, [&]()
+		{
+			poseCache->BeginFrame();
+			for(int i = 0; i < instancesCount; ++i)
+				poseBatch->Add(frames[i], positions[i], quat(0, 0, 0, 1), time + phases[i], true);
+			poseBatch->Run(jobSystem, cached ? (PoseCache*)poseCache : nullptr, nullptr);
+			time += 1.0f / 60;
+		});
+	}
+}
+
+static void BenchmarkCamera()
+{
+	ptr<Camera> camera = NEW(Camera(CreateTranslationMatrix(vec3(0, 0, 0)), 0.1f, 8.0f));
+	float time = 0;
+	RunBenchmark("Camera::newTick", [&]()
+	{
+		time += 1.0f / 60;
+		camera->newTick(CreateTranslationMatrix(vec3(sin(time) * 10, cos(time) * 10, 0)), 1.0f / 60, sin(time) * 0.5f, 0.1f);
+	});
+}
+
+static void BenchmarkPainter()
+{
+	static const int modelsCounts[] = { 10000, 30000, 100000 };
+	const int materialsCount = 32;
+	const int geometriesCount = 64;
+
+	ptr<GeometryFormats> geometryFormats = NEW(GeometryFormats());
+	ptr<JobSystem> jobSystem = NEW(JobSystem());
+	ptr<Profiler> profiler = NEW(Profiler());
+	// без устройства Painter выполняет только подготовку кадра
+	ptr<Painter> painter = NEW(Painter(nullptr, nullptr, nullptr, nullptr, geometryFormats, jobSystem, profiler));
+	painter->Resize(800, 600);
+
+	Random random(1);
+	std::vector<ptr<Material> > materials(materialsCount);
+	for(int i = 0; i < materialsCount; ++i)
+		materials[i] = NEW(Material());
+	std::vector<ptr<Geometry> > geometries(geometriesCount);
+	for(int i = 0; i < geometriesCount; ++i)
+	{
+		BoundingBox boundingBox;
+		boundingBox.Add(vec3(-1, -1, -1));
+		boundingBox.Add(vec3(1, 1, 1));
+		geometries[i] = NEW(Geometry(nullptr, nullptr, boundingBox, BoundingSphere(vec3(0, 0, 0), sqrt(3.0f))));
+	}
+
+	mat4x4 viewProj =
+		CreateProjectionPerspectiveFovMatrix(3.1415926535897932f / 4, 4.0f / 3, 0.1f, 10000.0f) *
+		CreateLookAtMatrix(vec3(-200, 0, 50), vec3(0, 0, 0), vec3(0, 0, 1));
+
+	for(size_t m = 0; m < sizeof(modelsCounts) / sizeof(modelsCounts[0]); ++m)
+	{
+		int modelsCount = modelsCounts[m];
+		std::vector<mat4x4> transforms(modelsCount);
+		std::vector<int> modelMaterials(modelsCount);
+		std::vector<int> modelGeometries(modelsCount);
+		for(int i = 0; i < modelsCount; ++i)
+		{
+			transforms[i] = CreateTranslationMatrix(vec3(random.Next(-200, 200), random.Next(-200, 200), random.Next(-20, 20)));
+			modelMaterials[i] = random.NextInt(materialsCount);
+			modelGeometries[i] = random.NextInt(geometriesCount);
+		}
+
+		char name[128];
+		sprintf(name, "Painter::Draw prepare/%d models", modelsCount);
+		RunBenchmark(name, [&]()
+		{
+			painter->BeginFrame(1.0f / 60);
+			painter->SetCamera(viewProj, vec3(-200, 0, 50));
+			for(int i = 0; i < modelsCount; ++i)
+				painter->AddModel(materials[modelMaterials[i]], geometries[modelGeometries[i]], transforms[i]);
+			painter->Draw();
+		});
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc > 1)
+		benchmarkFilter = argv[1];
+
+	try
+	{
+		BenchmarkSkeletons();
+		BenchmarkCrowd();
+		BenchmarkCamera();
+		BenchmarkPainter();
+	}
+	catch(Exception* exception)
+	{
+		std::ostringstream s;
+		MakePointer(exception)->PrintStack(s);
+		fprintf(stderr, "%s\n", s.str().c_str());
+		return 1;
+	}
+
+	return 0;
+}